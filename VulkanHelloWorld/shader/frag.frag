@@ -14,19 +14,24 @@ layout(binding = 0) uniform UniformBufferObject
 {
 	mat4 view;
 	mat4 proj;
-	vec4 lightDir;
-    vec4 lightColor;
-    mat4 lightMat;
 	float intime;
 } ubo;
 
 layout(binding = 1)uniform sampler2D texSampler;
 layout(binding = 2) uniform sampler2D shadowMap;
 
+// 光源只在调节时才变，和每帧都变的相机分开放
+layout(binding = 3) uniform LightUniformBufferObject
+{
+	vec4 lightDir;
+	vec4 lightColor;
+	mat4 lightMat;
+} light;
+
 
 float calculatePCFShadow(vec3 worldPos) {
 
-    vec4 shadowCoord = ubo.lightMat * vec4(worldPos, 1.0);
+    vec4 shadowCoord = light.lightMat * vec4(worldPos, 1.0);
     
 
     vec3 projCoords = shadowCoord.xyz / shadowCoord.w;
@@ -44,7 +49,7 @@ float calculatePCFShadow(vec3 worldPos) {
     float currentDepth = projCoords.z;
 
     // 计算自适应偏移量，防止阴影失真(Shadow Acne)
-    float bias = max(0.005 * (1.0 - dot(normalize(inNormal), normalize(ubo.lightDir.xyz))), 0.0005);
+    float bias = max(0.005 * (1.0 - dot(normalize(inNormal), normalize(light.lightDir.xyz))), 0.0005);
     
     // --- PCF 核心逻辑 ---
     float shadow = 0.0;
@@ -78,7 +83,7 @@ void main()
 
 
     vec3 norm = normalize(inNormal);
-    vec3 lightDir = normalize(ubo.lightDir.xyz); 
+    vec3 lightDir = normalize(light.lightDir.xyz); 
     float NdotL = dot(norm, lightDir);
 
     float shadowMask = smoothstep(0.49, 0.51, NdotL);
@@ -87,7 +92,7 @@ void main()
 
     float shadow = calculatePCFShadow(inPos);
 
-    vec3 diffuse = diffIntensity * baseColor.rgb * ubo.lightColor.xyz * shadow;
+    vec3 diffuse = diffIntensity * baseColor.rgb * light.lightColor.xyz * shadow;
 
     vec3 result = diffuse; 
     
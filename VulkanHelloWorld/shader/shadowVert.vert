@@ -1,29 +1,18 @@
-#version 450
+﻿#version 450
 #extension GL_ARB_separate_shader_objects : enable
 
 
+// 阴影 pass 没有片元着色器，只读位置流，也不输出别的
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNormal;
 
-layout(location = 0) out vec3 fragColor;
-layout(location = 1) out float outTime;
-layout(location = 2) out vec2 fragTexCoord;
-layout(location = 3) out vec3 fragNormal;
-layout(location = 4) out vec3 fragPos;
 
-
-
-layout(binding = 0) uniform UniformBufferObject
+// 阴影 pass 只用到光源矩阵
+layout(binding = 0) uniform LightUniformBufferObject
 {
-	mat4 view;
-	mat4 proj;
 	vec4 lightDir;
-    vec4 lightColor;
+	vec4 lightColor;
 	mat4 lightMat;
-	float intime;
-} ubo;
+} light;
 
 layout(push_constant) uniform Push {
     mat4 model;
@@ -35,6 +24,6 @@ out gl_PerVertex {
 
 void main() {
 	vec4 worldPos = entity.model * vec4(inPosition, 1.0);
-	gl_Position = ubo.lightMat * worldPos;
+	gl_Position = light.lightMat * worldPos;
 
 }
\ No newline at end of file
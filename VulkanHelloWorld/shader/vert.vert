@@ -19,9 +19,6 @@ layout(binding = 0) uniform UniformBufferObject
 {
 	mat4 view;
 	mat4 proj;
-	vec4 lightDir;
-    vec4 lightColor;
-	mat4 lightMat;
 	float intime;
 } ubo;
 
@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// 各个 --bench-* 共用的设置：重复次数、默认测试的模型、取最快一次的计时
+namespace BenchmarkUtil
+{
+	inline constexpr int kRepeats = 5;
+
+	//不给文件时测 models 目录下自带的模型
+	inline const std::vector<std::string> kBundledModels = {
+		"models/plane/plane.obj",
+		"models/VikingRoom/viking_room.obj",
+		"models/stanfordBunny/stanford-bunny.obj",
+	};
+
+	//跑 kRepeats 次取最快一次，排除首次运行的缓存和分页开销
+	template<typename Func>
+	double bestSeconds(Func&& func)
+	{
+		double best = 1e30;
+		for (int i = 0; i < kRepeats; i++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			func();
+			auto end = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration<double>(end - start).count());
+		}
+		return best;
+	}
+}
@@ -0,0 +1,297 @@
+﻿#include "GlbBenchmark.h"
+#include "BenchmarkUtil.h"
+#include "../Graphics/GlbLoader.h"
+#include "../Graphics/Model.h"
+#include "../Graphics/ObjParser.h"
+#include "../Graphics/VertexWeld.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	//引擎最终上传的数据：压缩后的顶点 + 模型索引类型的索引
+	struct EngineMesh
+	{
+		std::vector<PackedVertex> vertices;
+		std::vector<char> indices;
+		bool index16 = false;
+	};
+
+	//和 Model::loadModel 一样解析、焊接、按包围盒压缩，只是不做顶点缓存优化和 LOD，GLB 里也没有这些
+	void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, EngineMesh& mesh)
+	{
+		ObjMesh obj = ObjParser::load(path);
+		VertexWeldTable<Vertex> weldTable(obj.indices.size());
+		vertices.clear();
+		indices.clear();
+		indices.reserve(obj.indices.size());
+		for (const ObjIndex& index : obj.indices)
+		{
+			indices.push_back(weldTable.weld(Model::makeVertex(obj, index), vertices));
+		}
+
+		glm::vec3 min = vertices[0].pos;
+		glm::vec3 max = vertices[0].pos;
+		for (const Vertex& vertex : vertices)
+		{
+			min = glm::min(min, vertex.pos);
+			max = glm::max(max, vertex.pos);
+		}
+		VertexQuantization quantization = VertexQuantization::fromBounds(min, max);
+		mesh.vertices.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			mesh.vertices[i] = PackedVertex::pack(vertices[i], quantization);
+		}
+
+		//几何池 write 时收窄成 16 位的那一步也算进来
+		mesh.index16 = vertices.size() <= 65536;
+		mesh.indices.resize(indices.size() * (mesh.index16 ? sizeof(uint16_t) : sizeof(uint32_t)));
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if (mesh.index16)
+			{
+				uint16_t narrowed = static_cast<uint16_t>(indices[i]);
+				memcpy(mesh.indices.data() + i * sizeof(uint16_t), &narrowed, sizeof(uint16_t));
+			}
+			else
+			{
+				memcpy(mesh.indices.data() + i * sizeof(uint32_t), &indices[i], sizeof(uint32_t));
+			}
+		}
+	}
+
+	//模拟 Model::upload 拷进 staging：按子网格把顶点和索引拷到连续的内存里
+	void stageGlb(const ModelData& data, EngineMesh& mesh)
+	{
+		mesh.index16 = data.indexType == VK_INDEX_TYPE_UINT16;
+		size_t indexSize = mesh.index16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		mesh.vertices.resize(data.getVertexCount());
+		mesh.indices.resize(size_t(data.getIndexCount()) * indexSize);
+		for (size_t i = 0; i < data.submeshes.size(); i++)
+		{
+			const Submesh& submesh = data.submeshes[i];
+			memcpy(mesh.vertices.data() + submesh.vertexOffset, data.sources[i].vertices, submesh.vertexCount * sizeof(PackedVertex));
+			memcpy(mesh.indices.data() + submesh.firstIndex * indexSize, data.sources[i].indices, submesh.indexCount * indexSize);
+		}
+	}
+
+	// 往 BIN 块里追加 bufferView / accessor，最后拼成一个 .glb
+	class GlbWriter
+	{
+	public:
+		int addView(const void* data, size_t size, uint32_t stride, int target)
+		{
+			m_bin.resize((m_bin.size() + 3) / 4 * 4, '\0');
+			std::ostringstream view;
+			view << "{\"buffer\":0,\"byteOffset\":" << m_bin.size() << ",\"byteLength\":" << size;
+			if (stride)
+			{
+				view << ",\"byteStride\":" << stride;
+			}
+			view << ",\"target\":" << target << "}";
+			m_bin.append(static_cast<const char*>(data), size);
+			m_views.push_back(view.str());
+			return static_cast<int>(m_views.size() - 1);
+		}
+
+		int addAccessor(int view, uint32_t offset, uint32_t componentType, bool normalized, size_t count, const char* type, const std::string& bounds = "")
+		{
+			std::ostringstream accessor;
+			accessor << "{\"bufferView\":" << view << ",\"byteOffset\":" << offset << ",\"componentType\":" << componentType
+				<< (normalized ? ",\"normalized\":true" : "") << ",\"count\":" << count << ",\"type\":\"" << type << "\"" << bounds << "}";
+			m_accessors.push_back(accessor.str());
+			return static_cast<int>(m_accessors.size() - 1);
+		}
+
+		void write(const std::string& path, const std::string& node, const std::string& primitive, bool quantized)
+		{
+			std::ostringstream json;
+			json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"VulkanHelloWorld GlbBenchmark\"},";
+			if (quantized)
+			{
+				json << "\"extensionsUsed\":[\"KHR_mesh_quantization\"],\"extensionsRequired\":[\"KHR_mesh_quantization\"],";
+			}
+			json << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[" << node << "],"
+				<< "\"meshes\":[{\"primitives\":[" << primitive << "]}],"
+				<< "\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorFactor\":[1,1,1,1]}}],"
+				<< "\"buffers\":[{\"byteLength\":" << m_bin.size() << "}],\"bufferViews\":[" << join(m_views) << "],\"accessors\":[" << join(m_accessors) << "]}";
+
+			//JSON 块用空格补齐，BIN 块用 0 补齐到 4 字节
+			std::string text = json.str();
+			text.resize((text.size() + 3) / 4 * 4, ' ');
+			m_bin.resize((m_bin.size() + 3) / 4 * 4, '\0');
+			uint32_t header[3] = { 0x46546C67, 2, static_cast<uint32_t>(12 + 8 + text.size() + 8 + m_bin.size()) };
+			uint32_t jsonChunk[2] = { static_cast<uint32_t>(text.size()), 0x4E4F534A };
+			uint32_t binChunk[2] = { static_cast<uint32_t>(m_bin.size()), 0x004E4942 };
+
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+			out.write(text.data(), static_cast<std::streamsize>(text.size()));
+			out.write(reinterpret_cast<const char*>(binChunk), sizeof(binChunk));
+			out.write(m_bin.data(), static_cast<std::streamsize>(m_bin.size()));
+			if (!out)
+			{
+				throw std::runtime_error("failed to write " + path + "!");
+			}
+		}
+
+	private:
+		std::string m_bin;
+		std::vector<std::string> m_views;
+		std::vector<std::string> m_accessors;
+
+		static std::string join(const std::vector<std::string>& items)
+		{
+			std::string result;
+			for (size_t i = 0; i < items.size(); i++)
+			{
+				result += (i ? "," : "") + items[i];
+			}
+			return result;
+		}
+	};
+
+	std::string formatVec3(const glm::vec3& v)
+	{
+		char text[96];
+		snprintf(text, sizeof(text), "[%.9g,%.9g,%.9g]", v.x, v.y, v.z);
+		return text;
+	}
+
+	int addIndices(GlbWriter& writer, const EngineMesh& mesh)
+	{
+		int view = writer.addView(mesh.indices.data(), mesh.indices.size(), 0, 34963);
+		size_t count = mesh.indices.size() / (mesh.index16 ? sizeof(uint16_t) : sizeof(uint32_t));
+		return writer.addAccessor(view, 0, mesh.index16 ? 5123 : 5125, false, count, "SCALAR");
+	}
+
+	//引擎布局：一个交错的 20 字节 bufferView，节点变换就是反量化矩阵
+	void writeEngineGlb(const std::string& path, const EngineMesh& mesh, const VertexQuantization& quantization)
+	{
+		GlbWriter writer;
+		int view = writer.addView(mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex), sizeof(PackedVertex), 34962);
+		glm::ivec3 min(32767), max(-32767);
+		for (const PackedVertex& vertex : mesh.vertices)
+		{
+			min = glm::min(min, glm::ivec3(vertex.pos.x, vertex.pos.y, vertex.pos.z));
+			max = glm::max(max, glm::ivec3(vertex.pos.x, vertex.pos.y, vertex.pos.z));
+		}
+		std::ostringstream bounds;
+		bounds << ",\"min\":[" << min.x << "," << min.y << "," << min.z << "],\"max\":[" << max.x << "," << max.y << "," << max.z << "]";
+
+		int position = writer.addAccessor(view, offsetof(PackedVertex, pos), 5122, true, mesh.vertices.size(), "VEC3", bounds.str());
+		int color = writer.addAccessor(view, offsetof(PackedVertex, color), 5121, true, mesh.vertices.size(), "VEC4");
+		int texcoord = writer.addAccessor(view, offsetof(PackedVertex, texCoord), 5123, false, mesh.vertices.size(), "VEC2");
+		int normal = writer.addAccessor(view, offsetof(PackedVertex, normal), 5120, true, mesh.vertices.size(), "VEC3");
+		int indices = addIndices(writer, mesh);
+
+		char scale[32];
+		snprintf(scale, sizeof(scale), "%.9g", quantization.extent);
+		std::string node = "{\"mesh\":0,\"translation\":" + formatVec3(quantization.center) + ",\"scale\":[" + scale + "," + scale + "," + scale + "]}";
+		std::ostringstream primitive;
+		primitive << "{\"attributes\":{\"POSITION\":" << position << ",\"COLOR_0\":" << color << ",\"_TEXCOORD_HALF\":" << texcoord
+			<< ",\"NORMAL\":" << normal << "},\"indices\":" << indices << ",\"material\":0}";
+		writer.write(path, node, primitive.str(), true);
+	}
+
+	//标准布局：各属性一个 float 的 bufferView，其它 glTF 工具导出的就是这样
+	void writeFloatGlb(const std::string& path, const std::vector<Vertex>& vertices, const EngineMesh& mesh)
+	{
+		std::vector<glm::vec3> positions, colors, normals;
+		std::vector<glm::vec2> texcoords;
+		for (const Vertex& vertex : vertices)
+		{
+			positions.push_back(vertex.pos);
+			colors.push_back(vertex.color);
+			normals.push_back(vertex.normal);
+			texcoords.push_back(vertex.texCoord);
+		}
+		glm::vec3 min = positions[0];
+		glm::vec3 max = positions[0];
+		for (const glm::vec3& position : positions)
+		{
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+
+		GlbWriter writer;
+		auto addFloats = [&](const void* data, size_t size, size_t count, const char* type, const std::string& bounds = "") {
+			return writer.addAccessor(writer.addView(data, size, 0, 34962), 0, 5126, false, count, type, bounds);
+		};
+		int position = addFloats(positions.data(), positions.size() * sizeof(glm::vec3), positions.size(), "VEC3",
+			",\"min\":" + formatVec3(min) + ",\"max\":" + formatVec3(max));
+		int color = addFloats(colors.data(), colors.size() * sizeof(glm::vec3), colors.size(), "VEC3");
+		int texcoord = addFloats(texcoords.data(), texcoords.size() * sizeof(glm::vec2), texcoords.size(), "VEC2");
+		int normal = addFloats(normals.data(), normals.size() * sizeof(glm::vec3), normals.size(), "VEC3");
+		int indices = addIndices(writer, mesh);
+
+		std::ostringstream primitive;
+		primitive << "{\"attributes\":{\"POSITION\":" << position << ",\"COLOR_0\":" << color << ",\"TEXCOORD_0\":" << texcoord
+			<< ",\"NORMAL\":" << normal << "},\"indices\":" << indices << ",\"material\":0}";
+		writer.write(path, "{\"mesh\":0}", primitive.str(), false);
+	}
+
+	bool sameMesh(const EngineMesh& a, const EngineMesh& b)
+	{
+		return a.index16 == b.index16 && a.indices == b.indices && a.vertices.size() == b.vertices.size()
+			&& memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(PackedVertex)) == 0;
+	}
+}
+
+int GlbBenchmark::run(const std::vector<std::string>& paths)
+{
+	const std::vector<std::string>& files = paths.empty() ? BenchmarkUtil::kBundledModels : paths;
+	std::filesystem::create_directories("cache/bench");
+	bool allMatch = true;
+
+	std::printf("%-44s %10s %10s %10s %10s %8s %s\n", "file", "tris", "OBJ ms", "GLB ms", "GLB f32 ms", "speedup", "result");
+	for (const std::string& path : files)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		EngineMesh objMesh;
+		double obj = BenchmarkUtil::bestSeconds([&]() { loadObj(path, vertices, indices, objMesh); });
+
+		glm::vec3 min = vertices[0].pos;
+		glm::vec3 max = vertices[0].pos;
+		for (const Vertex& vertex : vertices)
+		{
+			min = glm::min(min, vertex.pos);
+			max = glm::max(max, vertex.pos);
+		}
+		std::string stem = "cache/bench/" + std::filesystem::path(path).stem().string();
+		std::string enginePath = stem + ".glb";
+		std::string floatPath = stem + ".f32.glb";
+		writeEngineGlb(enginePath, objMesh, VertexQuantization::fromBounds(min, max));
+		writeFloatGlb(floatPath, vertices, objMesh);
+
+		EngineMesh engineMesh;
+		bool direct = false;
+		double engine = BenchmarkUtil::bestSeconds([&]() {
+			ModelData data;
+			GlbLoader::load(enginePath, data);
+			direct = data.vertices.empty();
+			stageGlb(data, engineMesh);
+		});
+
+		EngineMesh floatMesh;
+		double floats = BenchmarkUtil::bestSeconds([&]() {
+			ModelData data;
+			GlbLoader::load(floatPath, data);
+			stageGlb(data, floatMesh);
+		});
+
+		bool match = direct && sameMesh(objMesh, engineMesh) && sameMesh(objMesh, floatMesh);
+		allMatch = allMatch && match;
+		std::printf("%-44s %10zu %10.2f %10.2f %10.2f %7.1fx %s%s\n", path.c_str(), indices.size() / 3, obj * 1000.0, engine * 1000.0, floats * 1000.0,
+			obj / engine, match ? "match" : "MISMATCH", direct ? "" : " (direct path not taken)");
+	}
+	return allMatch ? 0 : 1;
+}
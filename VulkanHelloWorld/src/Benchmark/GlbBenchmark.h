@@ -0,0 +1,13 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+// GLB 和 OBJ 的加载耗时对比：先把 OBJ 解析、焊接成引擎顶点，写出两份等价的 GLB（cache/bench 下）：
+// 一份是引擎布局（量化顶点，走直接拷贝），一份是标准的 float 属性（走逐顶点转换）
+// 然后分别计时：OBJ 解析 + 焊接 + 压缩、两种 GLB 的 GlbLoader::load，都算上拷进 staging 的那次 memcpy，取最快一次
+// 最后核对三条路径得到的顶点和索引逐字节相同
+// 运行方式：VulkanHelloWorld.exe --bench-glb [文件...]，不给文件时测 models 目录下自带的模型
+namespace GlbBenchmark
+{
+	int run(const std::vector<std::string>& paths);
+}
@@ -0,0 +1,81 @@
+﻿#include "ObjBenchmark.h"
+#include "BenchmarkUtil.h"
+#include "../Graphics/ObjParser.h"
+#include <tiny_obj_loader.h>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+namespace
+{
+	size_t countTinyobjCorners(const std::vector<tinyobj::shape_t>& shapes)
+	{
+		size_t count = 0;
+		for (const auto& shape : shapes)
+		{
+			count += shape.mesh.indices.size();
+		}
+		return count;
+	}
+
+	//逐个角点比较两边引用的属性下标，Model 把所有 shape 连起来用，所以这里也按顺序连起来比
+	bool matchesTinyobj(const ObjMesh& mesh, const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes)
+	{
+		if (mesh.positions != attrib.vertices || mesh.normals != attrib.normals || mesh.texcoords != attrib.texcoords)
+		{
+			return false;
+		}
+		size_t corner = 0;
+		for (const auto& shape : shapes)
+		{
+			for (const auto& index : shape.mesh.indices)
+			{
+				if (corner >= mesh.indices.size())
+				{
+					return false;
+				}
+				const ObjIndex& ours = mesh.indices[corner++];
+				if (ours.vertex != index.vertex_index || ours.texcoord != index.texcoord_index || ours.normal != index.normal_index)
+				{
+					return false;
+				}
+			}
+		}
+		return corner == mesh.indices.size();
+	}
+}
+
+int ObjBenchmark::run(const std::vector<std::string>& paths)
+{
+	const std::vector<std::string>& files = paths.empty() ? BenchmarkUtil::kBundledModels : paths;
+	bool allMatch = true;
+
+	std::printf("%-44s %10s %12s %12s %8s %s\n", "file", "size MB", "ObjParser", "tinyobj", "speedup", "result");
+	for (const std::string& path : files)
+	{
+		double sizeMB = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+
+		ObjMesh mesh;
+		double ours = BenchmarkUtil::bestSeconds([&]() { mesh = ObjParser::load(path); });
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		double theirs = BenchmarkUtil::bestSeconds([&]() {
+			attrib = {};
+			shapes.clear();
+			materials.clear();
+			std::string warn, err;
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+			{
+				throw std::runtime_error(warn + err);
+			}
+		});
+
+		bool match = matchesTinyobj(mesh, attrib, shapes);
+		allMatch = allMatch && match;
+		std::printf("%-44s %10.2f %7.1f MB/s %7.1f MB/s %7.2fx %s (%zu tris)\n", path.c_str(), sizeMB,
+			sizeMB / ours, sizeMB / theirs, theirs / ours, match ? "match" : "MISMATCH", countTinyobjCorners(shapes) / 3);
+	}
+	return allMatch ? 0 : 1;
+}
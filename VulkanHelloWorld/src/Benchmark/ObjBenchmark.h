@@ -0,0 +1,10 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+// OBJ 解析吞吐对比：同一份文件分别用 ObjParser 和 tinyobj 解析若干次，取最快一次算 MB/s，并核对两边的三角形是否一致
+// 运行方式：VulkanHelloWorld.exe --bench-obj [文件...]，不给文件时测 models 目录下自带的模型
+namespace ObjBenchmark
+{
+	int run(const std::vector<std::string>& paths);
+}
@@ -0,0 +1,140 @@
+﻿#include "ShadowBenchmark.h"
+#include "BenchmarkUtil.h"
+#include "../Graphics/MeshOptimizer.h"
+#include "../Graphics/Model.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t kCacheLine = 64;
+	//顶点读取经过的缓存，按行数算，大致是一个 L1 的量级
+	constexpr uint32_t kFetchCacheLines = 128;
+	//CPU 计时用的数据至少复制到这么大，避免整个落在缓存里测不出带宽
+	constexpr size_t kMinWorkingSet = 64ull * 1024 * 1024;
+
+	//最近用过的缓存行放在最前面，满了挤掉最后一个
+	class LineCache
+	{
+	public:
+		bool access(uint64_t line)
+		{
+			auto found = std::find(m_lines.begin(), m_lines.end(), line);
+			if (found != m_lines.end())
+			{
+				std::rotate(m_lines.begin(), found, found + 1);
+				return true;
+			}
+			if (m_lines.size() == kFetchCacheLines)
+			{
+				m_lines.pop_back();
+			}
+			m_lines.insert(m_lines.begin(), line);
+			return false;
+		}
+
+	private:
+		std::vector<uint64_t> m_lines;
+	};
+
+	//后变换缓存未命中的顶点按 stride 从流里取 stride 字节（交错流取整个顶点，位置流取 8 字节），返回读进来的字节数
+	uint64_t simulateFetch(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t stride, uint32_t& transforms)
+	{
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = MeshOptimizer::kCacheSize + 1;
+		LineCache lines;
+		uint64_t bytes = 0;
+		transforms = 0;
+		for (uint32_t i = 0; i < indexCount; i++)
+		{
+			uint32_t v = indices[i];
+			if (time - cacheTime[v] <= MeshOptimizer::kCacheSize)
+			{
+				continue;
+			}
+			cacheTime[v] = time++;
+			transforms++;
+			uint64_t first = uint64_t(v) * stride / kCacheLine;
+			uint64_t last = (uint64_t(v) * stride + stride - 1) / kCacheLine;
+			for (uint64_t line = first; line <= last; line++)
+			{
+				bytes += lines.access(line) ? 0 : kCacheLine;
+			}
+		}
+		return bytes;
+	}
+
+	//阴影顶点着色器在 CPU 上的对照：取位置、反量化、乘光源矩阵，结果累加起来防止被优化掉
+	glm::vec4 transformPositions(const char* stream, uint32_t stride, size_t copies, size_t copyBytes, const uint32_t* indices, uint32_t indexCount, const glm::mat4& lightMatrix)
+	{
+		glm::vec4 sum(0.0f);
+		for (size_t copy = 0; copy < copies; copy++)
+		{
+			const char* base = stream + copy * copyBytes;
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				PackedPosition position;
+				memcpy(&position, base + size_t(indices[i]) * stride, sizeof(PackedPosition));
+				glm::vec4 pos(position.x / 32767.0f, position.y / 32767.0f, position.z / 32767.0f, 1.0f);
+				sum += lightMatrix * pos;
+			}
+		}
+		return sum;
+	}
+}
+
+int ShadowBenchmark::run(const std::vector<std::string>& paths)
+{
+	const std::vector<std::string>& files = paths.empty() ? BenchmarkUtil::kBundledModels : paths;
+	bool allMatch = true;
+
+	std::printf("%-44s %10s %10s %12s %12s %7s %10s %10s %7s %s\n", "file", "tris", "VS runs", "fetch 20B", "fetch 8B", "ratio",
+		"CPU 20B", "CPU 8B", "speedup", "result");
+	for (const std::string& path : files)
+	{
+		std::unique_ptr<ModelData> data = Model::load(path);
+		if (data->chunk || !data->submeshes.empty())
+		{
+			std::printf("%-44s skipped (only single meshes)\n", path.c_str());
+			continue;
+		}
+		const MeshLod& lod = data->lods[0];
+		const uint32_t* indices = data->getIndices() + lod.indexOffset;
+		uint32_t vertexCount = data->getVertexCount();
+		const PackedVertex* vertices = static_cast<const PackedVertex*>(data->getVertices());
+
+		uint32_t transforms = 0;
+		uint64_t interleavedBytes = simulateFetch(indices, lod.indexCount, vertexCount, sizeof(PackedVertex), transforms);
+		uint64_t positionBytes = simulateFetch(indices, lod.indexCount, vertexCount, sizeof(PackedPosition), transforms);
+
+		//和几何池一样把位置拆成单独的流，两种布局都复制到足够大
+		size_t copies = std::max<size_t>(1, kMinWorkingSet / (size_t(vertexCount) * sizeof(PackedVertex)));
+		std::vector<char> interleaved(copies * vertexCount * sizeof(PackedVertex));
+		std::vector<char> positions(copies * vertexCount * sizeof(PackedPosition));
+		for (size_t copy = 0; copy < copies; copy++)
+		{
+			memcpy(interleaved.data() + copy * vertexCount * sizeof(PackedVertex), vertices, vertexCount * sizeof(PackedVertex));
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				memcpy(positions.data() + (copy * vertexCount + v) * sizeof(PackedPosition), &vertices[v].pos, sizeof(PackedPosition));
+			}
+		}
+
+		glm::mat4 lightMatrix = glm::mat4(0.5f) * data->quantization.getDequantMatrix();
+		glm::vec4 interleavedSum, positionSum;
+		double interleavedTime = BenchmarkUtil::bestSeconds([&]() {
+			interleavedSum = transformPositions(interleaved.data(), sizeof(PackedVertex), copies, vertexCount * sizeof(PackedVertex), indices, lod.indexCount, lightMatrix);
+		});
+		double positionTime = BenchmarkUtil::bestSeconds([&]() {
+			positionSum = transformPositions(positions.data(), sizeof(PackedPosition), copies, vertexCount * sizeof(PackedPosition), indices, lod.indexCount, lightMatrix);
+		});
+
+		bool match = interleavedSum == positionSum;
+		allMatch = allMatch && match;
+		std::printf("%-44s %10u %10u %9.1f KB %9.1f KB %6.2fx %7.2f ms %7.2f ms %6.2fx %s\n", path.c_str(), lod.indexCount / 3, transforms,
+			interleavedBytes / 1024.0, positionBytes / 1024.0, double(interleavedBytes) / double(positionBytes),
+			interleavedTime * 1000.0, positionTime * 1000.0, interleavedTime / positionTime, match ? "match" : "MISMATCH");
+	}
+	return allMatch ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+// 阴影 pass 的顶点带宽对比：交错的 20 字节顶点（原来阴影管线绑的整条流）和只有位置的 8 字节流
+// 1. 按模型第 0 级的索引顺序模拟 GPU 取顶点：后变换缓存（FIFO）未命中的顶点才会被取，取的时候按 64 字节的缓存行读，
+//    缓存行再经过一个小的 LRU 缓存，统计两种布局实际读了多少字节
+// 2. 在 CPU 上按同样的索引顺序把位置反量化、乘上光源矩阵，数据复制到超出末级缓存的大小，比较两种布局的耗时，取最快一次
+// 最后核对两种布局算出的结果相同
+// 运行方式：VulkanHelloWorld.exe --bench-shadow [文件...]，不给文件时测 models 目录下自带的模型
+namespace ShadowBenchmark
+{
+	int run(const std::vector<std::string>& paths);
+}
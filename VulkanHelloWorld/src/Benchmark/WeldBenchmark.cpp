@@ -0,0 +1,73 @@
+﻿#include "WeldBenchmark.h"
+#include "BenchmarkUtil.h"
+#include "../Graphics/Model.h"
+#include "../Graphics/ObjParser.h"
+#include "../Graphics/VertexWeld.h"
+#include <cstdio>
+#include <unordered_map>
+
+namespace
+{
+	struct WeldResult
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	//原来 Model::loadModel 里的写法，作为对照
+	WeldResult weldWithUnorderedMap(const std::vector<Vertex>& corners)
+	{
+		WeldResult result;
+		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		for (const Vertex& vertex : corners)
+		{
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(result.vertices.size());
+				result.vertices.push_back(vertex);
+			}
+			result.indices.push_back(uniqueVertices[vertex]);
+		}
+		return result;
+	}
+
+	WeldResult weldWithTable(const std::vector<Vertex>& corners)
+	{
+		WeldResult result;
+		VertexWeldTable<Vertex> weldTable(corners.size());
+		result.vertices.reserve(corners.size() / 4);
+		result.indices.reserve(corners.size());
+		for (const Vertex& vertex : corners)
+		{
+			result.indices.push_back(weldTable.weld(vertex, result.vertices));
+		}
+		return result;
+	}
+}
+
+int WeldBenchmark::run(const std::vector<std::string>& paths)
+{
+	const std::vector<std::string>& files = paths.empty() ? BenchmarkUtil::kBundledModels : paths;
+	bool allMatch = true;
+
+	std::printf("%-44s %10s %10s %12s %12s %8s %s\n", "file", "corners", "unique", "unordered_map", "WeldTable", "speedup", "result");
+	for (const std::string& path : files)
+	{
+		ObjMesh mesh = ObjParser::load(path);
+		std::vector<Vertex> corners;
+		corners.reserve(mesh.indices.size());
+		for (const ObjIndex& index : mesh.indices)
+		{
+			corners.push_back(Model::makeVertex(mesh, index));
+		}
+
+		WeldResult reference, ours;
+		double mapSeconds = BenchmarkUtil::bestSeconds([&]() { reference = weldWithUnorderedMap(corners); });
+		double tableSeconds = BenchmarkUtil::bestSeconds([&]() { ours = weldWithTable(corners); });
+
+		bool match = reference.indices == ours.indices && reference.vertices == ours.vertices;
+		allMatch = allMatch && match;
+		std::printf("%-44s %10zu %10zu %9.2f ms %9.2f ms %7.2fx %s\n", path.c_str(), corners.size(), ours.vertices.size(),
+			mapSeconds * 1000.0, tableSeconds * 1000.0, mapSeconds / tableSeconds, match ? "match" : "MISMATCH");
+	}
+	return allMatch ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+// 顶点焊接对比：同一份角点流分别用原来的 std::unordered_map<Vertex, uint32_t> 和 VertexWeldTable 去重，
+// 取最快一次比较耗时，并核对两边输出的顶点和索引完全相同
+// 运行方式：VulkanHelloWorld.exe --bench-weld [文件...]，不给文件时测 models 目录下自带的模型
+namespace WeldBenchmark
+{
+	int run(const std::vector<std::string>& paths);
+}
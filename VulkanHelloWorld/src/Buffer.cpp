@@ -1,50 +1,72 @@
 #include "Buffer.h"
 #include <stdexcept>
+#include <limits>
 
-void Buffer::createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+namespace
 {
-	//buffer
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+	void createBufferHandle(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer)
 	{
-		throw std::runtime_error("failed to create buffer!");
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device.getLogicalDevice(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create buffer!");
+		}
 	}
+}
 
-	//ڴ
+void Buffer::createBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation, MemoryUsage memoryUsage)
+{
+	//创建buffer
+	createBufferHandle(device, size, usage, buffer);
+
+	//从分配器的大块内存里切一段出来，而不是每个buffer单独vkAllocateMemory
 	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	uint32_t memoryTypeIndex = Buffer::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-	allocInfo.memoryTypeIndex = memoryTypeIndex;
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+	vkGetBufferMemoryRequirements(device.getLogicalDevice(), buffer, &memRequirements);
+	allocation = device.getAllocator().allocate(memRequirements, properties, true, memoryUsage);
+
+	//把刚才分配的内存绑定到buffer上
+	vkBindBufferMemory(device.getLogicalDevice(), buffer, allocation.memory, allocation.offset);
+
+}
+
+bool Buffer::createDirectWriteBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& allocation, MemoryUsage memoryUsage, bool requireLargeHeap)
+{
+	createBufferHandle(device, size, usage, buffer);
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device.getLogicalDevice(), buffer, &memRequirements);
+	if (!device.getAllocator().supportsDirectWrite(memRequirements.memoryTypeBits, requireLargeHeap))
 	{
-		throw std::runtime_error("failed to allocate buffer memory!");
+		vkDestroyBuffer(device.getLogicalDevice(), buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+		return false;
 	}
 
-	//Ѹղŷڴ󶨵buffer
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
-
+	allocation = device.getAllocator().allocate(memRequirements,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		true, memoryUsage);
+	vkBindBufferMemory(device.getLogicalDevice(), buffer, allocation.memory, allocation.offset);
+	return true;
 }
 
-//ѰҷڴͣΪԴкܶ಻ͬ
-uint32_t Buffer::findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void Buffer::destroyBuffer(Devices& device, VkBuffer& buffer, Allocation& allocation)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	if (buffer != VK_NULL_HANDLE)
 	{
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
+		vkDestroyBuffer(device.getLogicalDevice(), buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
 	}
-	throw std::runtime_error("failed to find suitable memory type!");
+	device.getAllocator().free(allocation);
+}
+
+//寻找符合条件的内存类型，因为显存有很多不同的类型；内存属性在 Devices 里已经缓存，不用每次都查询
+uint32_t Buffer::findMemoryType(Devices& device, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	return device.getAllocator().findMemoryType(typeFilter, properties);
 }
 
 void Buffer::copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
@@ -106,8 +128,15 @@ void CommandBuffer::endSingleTimeCommands(VkDevice device, VkCommandPool command
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue);
+	//只等这一次提交的fence，不用vkQueueWaitIdle把整个队列（包括在途的上传和渲染）都等空
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+	vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	vkDestroyFence(device, fence, nullptr);
 	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
@@ -116,21 +145,33 @@ void CommandBuffer::endSingleTimeCommands(VkDevice device, VkCommandPool command
 UniformBuffer::UniformBuffer(Devices& device, VkDeviceSize size)
 	:m_device(device), m_size(size)
 {
-	Buffer::createBuffer(m_device.getLogicalDevice(), m_device.getPhysicalDevice(), m_size,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		m_buffer, m_buffermemory);
+	//uniform 很小，即使只有 256MB 的 BAR 窗口也值得放进显存里直接写
+	if (!Buffer::createDirectWriteBuffer(m_device, m_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, m_buffer, m_allocation, MemoryUsage::Uniform, false))
+	{
+		Buffer::createBuffer(m_device, m_size,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_buffer, m_allocation, MemoryUsage::Uniform);
+	}
 
-	vkMapMemory(m_device.getLogicalDevice(),m_buffermemory , 0, m_size, 0, &m_mappedData);
+	//HOST_VISIBLE的内存块由分配器常驻映射，这里直接拿指针
+	m_mappedData = m_allocation.mappedData;
 }
 
 UniformBuffer::~UniformBuffer()
 {
-	vkUnmapMemory(m_device.getLogicalDevice(), m_buffermemory);
-	vkDestroyBuffer(m_device.getLogicalDevice(), m_buffer, nullptr);
-	vkFreeMemory(m_device.getLogicalDevice(), m_buffermemory, nullptr);
+	Buffer::destroyBuffer(m_device, m_buffer, m_allocation);
 }
 
 void UniformBuffer::update(const void* data)
 {
-	memcpy(m_mappedData, data, m_size);
+	update(data, 0, m_size);
+}
+
+void UniformBuffer::update(const void* data, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (offset + size > m_size)
+	{
+		throw std::runtime_error("failed to update uniform buffer: range out of bounds!");
+	}
+	memcpy(static_cast<char*>(m_mappedData) + offset, data, static_cast<size_t>(size));
 }
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include<glm/glm.hpp>
 #include<vector>
 #define GLFW_INCLUDE_VULKAN
@@ -9,9 +9,13 @@
 class Buffer
 {
 public:
-	static void createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	static void createBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& allocation, MemoryUsage memoryUsage = MemoryUsage::Other);
+	//UMA/ReBAR 上直接分配 DEVICE_LOCAL | HOST_VISIBLE 的内存，数据 memcpy 到 allocation.mappedData 即可，不需要 staging 和拷贝提交
+	//不支持时返回 false，buffer 保持为空，调用方走原来的 staging 路径
+	static bool createDirectWriteBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& allocation, MemoryUsage memoryUsage, bool requireLargeHeap = true);
+	static void destroyBuffer(Devices& device, VkBuffer& buffer, Allocation& allocation);
 	static void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-	static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	static uint32_t findMemoryType(Devices& device, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	static void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 };
 
@@ -33,13 +37,15 @@ public:
 	UniformBuffer& operator=(const UniformBuffer&) = delete;
 
 	VkBuffer getHandle() const { return m_buffer; }
-	VkDeviceMemory getMemory() const { return m_buffermemory; }
+	const Allocation& getAllocation() const { return m_allocation; }
 	void update(const void* data);
+	//只写 [offset, offset + size)，其余数据保持不变
+	void update(const void* data, VkDeviceSize offset, VkDeviceSize size);
 private:
 	Devices& m_device;
 	VkDeviceSize m_size;
 	VkBuffer m_buffer;
-	VkDeviceMemory m_buffermemory;
+	Allocation m_allocation;
 	void* m_mappedData = nullptr;
 
 };
@@ -0,0 +1,255 @@
+﻿#include "Defragmenter.h"
+#include "Devices.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+	//没有可搬的内容时，隔多少帧再重新挑一次源块
+	constexpr uint64_t kScanInterval = 120;
+
+	void destroyRelocated(Devices& device, RelocatedResource& resource)
+	{
+		if (resource.imageView != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(device.getLogicalDevice(), resource.imageView, nullptr);
+		}
+		if (resource.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(device.getLogicalDevice(), resource.image, nullptr);
+		}
+		if (resource.buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device.getLogicalDevice(), resource.buffer, nullptr);
+		}
+		device.getAllocator().free(resource.allocation);
+	}
+}
+
+Defragmenter::Defragmenter(Devices& device, VkDeviceSize frameBudget)
+	: m_device(device), m_frameBudget(frameBudget)
+{
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(m_device.getLogicalDevice(), &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create defragmentation fence!");
+	}
+}
+
+Defragmenter::~Defragmenter()
+{
+	//设备销毁时已经空闲，旧资源直接销毁，不再进删除队列
+	if (!m_moves.empty())
+	{
+		vkWaitForFences(m_device.getLogicalDevice(), 1, &m_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		for (const Move& move : m_moves)
+		{
+			RelocatedResource old = move.resource->endRelocation(move.slot);
+			destroyRelocated(m_device, old);
+		}
+	}
+	if (m_commandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(m_device.getLogicalDevice(), m_device.getCommandPool(), 1, &m_commandBuffer);
+	}
+	m_device.getAllocator().endDefragmentation();
+	vkDestroyFence(m_device.getLogicalDevice(), m_fence, nullptr);
+}
+
+void Defragmenter::registerResource(Relocatable* resource)
+{
+	m_resources.push_back(resource);
+}
+
+void Defragmenter::unregisterResource(Relocatable* resource)
+{
+	settle(resource);
+
+	auto it = std::find(m_resources.begin(), m_resources.end(), resource);
+	if (it != m_resources.end())
+	{
+		*it = m_resources.back();
+		m_resources.pop_back();
+	}
+}
+
+void Defragmenter::settle(Relocatable* resource)
+{
+	bool moving = std::any_of(m_moves.begin(), m_moves.end(), [resource](const Move& move) { return move.resource == resource; });
+	if (moving)
+	{
+		vkWaitForFences(m_device.getLogicalDevice(), 1, &m_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		completeMoves();
+	}
+}
+
+void Defragmenter::update()
+{
+	m_frame++;
+
+	if (!m_moves.empty())
+	{
+		//上一批拷贝还没完成就先不动，下一帧再看
+		if (vkGetFenceStatus(m_device.getLogicalDevice(), m_fence) != VK_SUCCESS)
+		{
+			return;
+		}
+		completeMoves();
+	}
+
+	MemoryAllocator& allocator = m_device.getAllocator();
+	if (!m_passActive)
+	{
+		if (!m_enabled || m_frame < m_nextScanFrame)
+		{
+			return;
+		}
+		m_nextScanFrame = m_frame + kScanInterval;
+		m_stats.sourceBlocks = allocator.beginDefragmentation();
+		if (m_stats.sourceBlocks == 0)
+		{
+			return;
+		}
+		m_passActive = true;
+		m_stats.passCount++;
+	}
+
+	bool remaining = m_enabled && recordMoves();
+	if (!m_moves.empty())
+	{
+		submitMoves();
+		return;
+	}
+	if (remaining)
+	{
+		//源块里还有资源暂时搬不了（比如还在上传），下一帧再试
+		return;
+	}
+
+	//源块里的旧内存要等延迟销毁之后才真正释放，在这之前取消标记的话新分配又会落回源块
+	if (m_moves.empty() && m_retiring == 0)
+	{
+		allocator.endDefragmentation();
+		m_passActive = false;
+		m_stats.sourceBlocks = 0;
+	}
+}
+
+DefragStats Defragmenter::getStats() const
+{
+	DefragStats stats = m_stats;
+	stats.pendingMoves = m_moves.size();
+	stats.retiredResources = m_retiring;
+	stats.passActive = m_passActive;
+	return stats;
+}
+
+bool Defragmenter::recordMoves()
+{
+	MemoryAllocator& allocator = m_device.getAllocator();
+	VkDeviceSize remainingBudget = m_frameBudget;
+	bool remaining = false;
+	size_t count = m_resources.size();
+
+	for (size_t n = 0; n < count; n++)
+	{
+		size_t index = (m_cursor + n) % count;
+		Relocatable* resource = m_resources[index];
+		for (uint32_t slot = 0; slot < resource->getSlotCount(); slot++)
+		{
+			const Allocation& allocation = resource->getSlotAllocation(slot);
+			if (!allocator.isDefragmentationSource(allocation))
+			{
+				continue;
+			}
+			remaining = true;
+
+			//预算用完了，下一帧从这里接着搬；单个超过预算的资源也要能搬，所以第一个不受限制
+			if (!m_moves.empty() && allocation.size > remainingBudget)
+			{
+				m_cursor = index;
+				return true;
+			}
+
+			if (m_commandBuffer == VK_NULL_HANDLE)
+			{
+				VkCommandBufferAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandPool = m_device.getCommandPool();
+				allocInfo.commandBufferCount = 1;
+				vkAllocateCommandBuffers(m_device.getLogicalDevice(), &allocInfo, &m_commandBuffer);
+
+				VkCommandBufferBeginInfo beginInfo{};
+				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+			}
+
+			VkDeviceSize size = allocation.size;
+			if (resource->beginRelocation(slot, m_commandBuffer))
+			{
+				m_moves.push_back({ resource, slot, size });
+				remainingBudget -= std::min(size, remainingBudget);
+			}
+		}
+	}
+
+	m_cursor = 0;
+	return remaining;
+}
+
+void Defragmenter::submitMoves()
+{
+	//新 buffer 的拷贝写入对之后的顶点/索引/着色器读取可见，image 的布局转换由资源自己录
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+	vkEndCommandBuffer(m_commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_commandBuffer;
+
+	vkResetFences(m_device.getLogicalDevice(), 1, &m_fence);
+	if (vkQueueSubmit(m_device.getGraphicsQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit defragmentation copies!");
+	}
+
+	m_stats.lastFrameBytes = 0;
+	for (const Move& move : m_moves)
+	{
+		m_stats.lastFrameBytes += move.size;
+	}
+}
+
+void Defragmenter::completeMoves()
+{
+	for (const Move& move : m_moves)
+	{
+		//换句柄发生在本帧录制之前，之前提交的帧可能还在用旧句柄
+		RelocatedResource old = move.resource->endRelocation(move.slot);
+		m_retiring++;
+		m_device.getDeletionQueue().push([this, old]() mutable {
+			destroyRelocated(m_device, old);
+			m_retiring--;
+		});
+		m_stats.movedAllocations++;
+		m_stats.movedBytes += move.size;
+	}
+	m_moves.clear();
+
+	if (m_commandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(m_device.getLogicalDevice(), m_device.getCommandPool(), 1, &m_commandBuffer);
+		m_commandBuffer = VK_NULL_HANDLE;
+	}
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "MemoryAllocator.h"
+
+class Devices;
+
+// 搬走之后留下的旧句柄，交给 DeletionQueue 等引用它们的帧都结束后再销毁
+struct RelocatedResource
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	Allocation allocation;
+};
+
+// 可以被碎片整理搬动的资源，一个资源可以有多块内存（比如几何池的顶点和索引），用 slot 区分
+class Relocatable
+{
+public:
+	virtual ~Relocatable() = default;
+
+	virtual uint32_t getSlotCount() const = 0;
+	virtual const Allocation& getSlotAllocation(uint32_t slot) const = 0;
+	//在新内存上创建资源，并把拷贝命令录进 commandBuffer；数据还没上传完之类暂时不能搬时返回 false
+	virtual bool beginRelocation(uint32_t slot, VkCommandBuffer commandBuffer) = 0;
+	//GPU 拷贝已经完成：换成新句柄，把旧句柄交出来延迟销毁
+	virtual RelocatedResource endRelocation(uint32_t slot) = 0;
+};
+
+struct DefragStats
+{
+	uint64_t passCount = 0;
+	uint64_t movedAllocations = 0;
+	VkDeviceSize movedBytes = 0;
+	VkDeviceSize lastFrameBytes = 0;   // 最近一次提交的拷贝量
+	size_t sourceBlocks = 0;           // 当前这轮选中的搬出源块数
+	size_t pendingMoves = 0;           // 已提交、GPU 还没拷完的数量
+	size_t retiredResources = 0;       // 等待延迟销毁的旧资源
+	bool passActive = false;
+};
+
+// 增量碎片整理：每帧最多搬 frameBudget 字节，把使用率低的块里的资源用 GPU 拷贝搬到别的块
+// 拷贝提交到图形队列，和前后帧的读取靠队列顺序 + 屏障同步；拷贝完成后在下一帧开头换句柄
+class Defragmenter
+{
+public:
+	Defragmenter(Devices& device, VkDeviceSize frameBudget = 8ull * 1024 * 1024);
+	~Defragmenter();
+
+	Defragmenter(const Defragmenter&) = delete;
+	Defragmenter& operator=(const Defragmenter&) = delete;
+
+	void registerResource(Relocatable* resource);
+	//资源销毁前调用；如果它正在被搬，会等这次拷贝完成再返回
+	void unregisterResource(Relocatable* resource);
+	//资源正在被搬的话等拷贝完成、换好句柄再返回，资源仍然留在整理范围里；没在搬时直接返回
+	void settle(Relocatable* resource);
+
+	//每帧等完本帧 fence 之后、录制命令之前调用一次
+	void update();
+
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+	bool isEnabled() const { return m_enabled; }
+	void setFrameBudget(VkDeviceSize bytes) { m_frameBudget = bytes; }
+	VkDeviceSize getFrameBudget() const { return m_frameBudget; }
+	DefragStats getStats() const;
+
+private:
+	struct Move
+	{
+		Relocatable* resource;
+		uint32_t slot;
+		VkDeviceSize size;
+	};
+
+	Devices& m_device;
+	VkDeviceSize m_frameBudget;
+	bool m_enabled = true;
+	bool m_passActive = false;
+	uint64_t m_frame = 0;
+	uint64_t m_nextScanFrame = 0;
+	size_t m_cursor = 0;   // 轮询起点，避免每帧都从同一个资源开始
+
+	std::vector<Relocatable*> m_resources;
+	std::vector<Move> m_moves;
+	size_t m_retiring = 0;   // 已经换掉、还在删除队列里的旧资源数
+	VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+	VkFence m_fence = VK_NULL_HANDLE;
+	DefragStats m_stats;
+
+	bool recordMoves();
+	void submitMoves();
+	void completeMoves();
+};
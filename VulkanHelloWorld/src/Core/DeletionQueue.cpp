@@ -0,0 +1,47 @@
+﻿#include "DeletionQueue.h"
+#include <algorithm>
+
+DeletionQueue::~DeletionQueue()
+{
+	flush();
+}
+
+void DeletionQueue::push(std::function<void()>&& deleter)
+{
+	push(std::move(deleter), 0);
+}
+
+void DeletionQueue::push(std::function<void()>&& deleter, uint64_t extraFrames)
+{
+	//延后的条目可能排在之后入队的条目后面，按帧序号插入，保持队头总是最早可以销毁的
+	uint64_t frame = m_submittedFrame + 1 + extraFrames;
+	auto it = std::upper_bound(m_entries.begin(), m_entries.end(), frame, [](uint64_t value, const Entry& entry) { return value < entry.frame; });
+	m_entries.insert(it, { frame, std::move(deleter) });
+}
+
+void DeletionQueue::retire(uint64_t completedFrame)
+{
+	if (completedFrame > m_completedFrame)
+	{
+		m_completedFrame = completedFrame;
+	}
+
+	//条目按帧序号排列，只看队头
+	while (!m_entries.empty() && m_entries.front().frame <= m_completedFrame)
+	{
+		std::function<void()> deleter = std::move(m_entries.front().deleter);
+		m_entries.pop_front();
+		deleter();
+	}
+}
+
+void DeletionQueue::flush()
+{
+	//销毁的过程中可能又有新的入队（比如 Material 释放最后一个 Texture 引用），所以循环到空为止
+	while (!m_entries.empty())
+	{
+		std::function<void()> deleter = std::move(m_entries.front().deleter);
+		m_entries.pop_front();
+		deleter();
+	}
+}
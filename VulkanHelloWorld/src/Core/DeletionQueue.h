@@ -0,0 +1,41 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+
+// 按帧序号延迟销毁 Vulkan 资源，代替 vkDeviceWaitIdle
+// 每次提交一帧序号加一；入队时记下"下一个要提交的帧"，等这一帧的 fence signal 后才真正销毁，
+// 这样正在录制、还没提交的那一帧用到的资源也是安全的
+class DeletionQueue
+{
+public:
+	DeletionQueue() = default;
+	~DeletionQueue();
+
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	void push(std::function<void()>&& deleter);
+	//在正常的时机之后再多等 extraFrames 帧才销毁，给 fence 覆盖不到的使用（比如呈现）留余量
+	void push(std::function<void()>&& deleter, uint64_t extraFrames);
+
+	//提交一帧后调用，返回这一帧的序号
+	uint64_t submitFrame() { return ++m_submittedFrame; }
+	//某一帧的 fence 已经 signal：它以及它之前的帧都结束了，销毁它们用到的资源
+	void retire(uint64_t completedFrame);
+	//设备空闲时调用，全部销毁
+	void flush();
+
+	size_t getPendingCount() const { return m_entries.size(); }
+
+private:
+	struct Entry
+	{
+		uint64_t frame;
+		std::function<void()> deleter;
+	};
+
+	uint64_t m_submittedFrame = 0;
+	uint64_t m_completedFrame = 0;
+	std::deque<Entry> m_entries;
+};
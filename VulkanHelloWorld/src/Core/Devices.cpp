@@ -4,16 +4,29 @@
 #include "ValidationLayerAssist.h"
 #include <set>
 #include <array>
+#include <cstring>
 
-Devices::Devices(GLFWwindow* window, int maxFrame) : m_MAX_FRAMES_IN_FLIGHT(maxFrame)
+Devices::Devices(GLFWwindow* window, int maxFrame, VkDeviceSize stagingRingSize) : m_MAX_FRAMES_IN_FLIGHT(maxFrame)
 {
 	createInstance();
 	setupDebugCallback();
 	createSurface(window);
 	pickPhysicalDevice();
 	createLogicalDevice();
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memProperties);
+
+	PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2 = nullptr;
+	if (m_memoryBudgetEnabled)
+	{
+		getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+			vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	}
+	m_allocator = std::make_unique<MemoryAllocator>(m_logicalDevice, m_physicalDevice, m_memProperties, getMemoryProperties2);
 	createCommandPool();
 	createDescriptorPool();
+	m_stagingRing = std::make_unique<StagingRing>(*this, stagingRingSize);
+	m_deletionQueue = std::make_unique<DeletionQueue>();
+	m_defragmenter = std::make_unique<Defragmenter>(*this);
 }
 
 void Devices::createInstance()
@@ -63,6 +76,17 @@ void Devices::createInstance()
 
 	//GLFW扩展
 	std::vector<const char*> glfwExtensions = ValidationLayerAssist::getRequiredExtensions();
+
+	//可选：查询显存预算（VK_EXT_memory_budget）需要这个实例扩展
+	for (const auto& extension : extensionProperties)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+		{
+			glfwExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			m_properties2Enabled = true;
+			break;
+		}
+	}
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(glfwExtensions.size());
 	createInfo.ppEnabledExtensionNames = glfwExtensions.data();
 
@@ -125,12 +149,14 @@ void Devices::pickPhysicalDevice()
 
 void Devices::createLogicalDevice()
 {
-	QueueFamilyIndices indices = findQueueFamilies(this->m_physicalDevice);
+	m_queueFamilies = findQueueFamilies(this->m_physicalDevice);
+	const QueueFamilyIndices& indices = m_queueFamilies;
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
 	//思考这里为什么要用set去重？
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(),
+		indices.transferFamily.value(), indices.computeFamily.value() };
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
@@ -150,8 +176,26 @@ void Devices::createLogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(Devices::deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = Devices::deviceExtensions.data();
+	//必需扩展之外，按需打开可选扩展
+	std::vector<const char*> enabledExtensions = Devices::deviceExtensions;
+	if (m_properties2Enabled)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+		for (const auto& extension : availableExtensions)
+		{
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				m_memoryBudgetEnabled = true;
+				break;
+			}
+		}
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	if (enableValidationLayers)
 	{
 		createInfo.enabledLayerCount = static_cast<uint32_t>(ValidationLayerAssist::validationLayers.size());
@@ -170,18 +214,25 @@ void Devices::createLogicalDevice()
 	//这个队列又是依赖于逻辑设备的
 	vkGetDeviceQueue(m_logicalDevice, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_logicalDevice, indices.presentFamily.value(), 0, &m_presentQueue);
+	vkGetDeviceQueue(m_logicalDevice, indices.transferFamily.value(), 0, &m_transferQueue);
+	vkGetDeviceQueue(m_logicalDevice, indices.computeFamily.value(), 0, &m_computeQueue);
 }
 
 void Devices::createCommandPool()
 {
-	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(this->m_physicalDevice);
-	VkCommandPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-	if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+	//每个队列族一个命令池，命令缓冲只能提交到创建它的池所属的队列族
+	uint32_t families[] = { m_queueFamilies.graphicsFamily.value(), m_queueFamilies.transferFamily.value(), m_queueFamilies.computeFamily.value() };
+	VkCommandPool* pools[] = { &m_commandPool, &m_transferCommandPool, &m_computeCommandPool };
+	for (int i = 0; i < 3; i++)
 	{
-		throw std::runtime_error("failed to create command pool!");
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = families[i];
+		if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, pools[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create command pool!");
+		}
 	}
 }
 
@@ -193,12 +244,14 @@ void Devices::createDescriptorPool()
 
 	const uint32_t MAX_SETS = MAX_MATERIAL_COUNT * FRAMES_IN_FLIGHT;
 
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
 
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = MAX_SETS * 1; 
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[1].descriptorCount = MAX_SETS * 2; 
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[2].descriptorCount = MAX_SETS * 2; 
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -262,11 +315,24 @@ QueueFamilyIndices Devices::findQueueFamilies(VkPhysicalDevice device)
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-	int i = 0;
+	//要把所有队列族都看一遍才能找到专用的传输/计算队列，所以这里不能提前break
+	std::optional<uint32_t> dedicatedTransfer;
+	std::optional<uint32_t> nonGraphicsTransfer;
+	uint32_t i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
+		if (queueFamily.queueCount == 0)
+		{
+			i++;
+			continue;
+		}
+
+		bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		bool transfer = queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
 		//检查该队列族是否支持图形操作
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if (graphics && !indices.graphicsFamily.has_value())
 		{
 			indices.graphicsFamily = i;
 		}
@@ -277,18 +343,46 @@ QueueFamilyIndices Devices::findQueueFamilies(VkPhysicalDevice device)
 		//询问在当前device的第i个队列族是否支持在指定的surface上进行present操作
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 
-		if (queueFamily.queueCount > 0 && presentSupport)
+		if (presentSupport && !indices.presentFamily.has_value())
 		{
 			indices.presentFamily = i;
 		}
 
-		if (indices.isComplete())
+		//只有传输能力的队列族一般对应独立的DMA引擎，最适合做上传
+		if (transfer && !graphics && !compute && !dedicatedTransfer.has_value())
 		{
-			break;
+			dedicatedTransfer = i;
+		}
+		//计算队列族也隐含传输能力，没有DMA队列时退而求其次
+		if ((transfer || compute) && !graphics && !nonGraphicsTransfer.has_value())
+		{
+			nonGraphicsTransfer = i;
+		}
+		if (compute && !graphics && !indices.computeFamily.has_value())
+		{
+			indices.computeFamily = i;
 		}
 
 		i++;
 	}
+
+	if (dedicatedTransfer.has_value())
+	{
+		indices.transferFamily = dedicatedTransfer;
+	}
+	else if (nonGraphicsTransfer.has_value())
+	{
+		indices.transferFamily = nonGraphicsTransfer;
+	}
+	else
+	{
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
+	if (!indices.computeFamily.has_value())
+	{
+		indices.computeFamily = indices.graphicsFamily;
+	}
 	return indices;
 }
 
@@ -340,8 +434,16 @@ SwapChainSupportDetails Devices::querySwapChainSupport(VkPhysicalDevice device)
 
 Devices::~Devices()
 {
+	//走到这里时设备已经空闲，延迟销毁的资源全部放掉；碎片整理器的删除回调会用到它自己，所以先 flush
+	m_deletionQueue->flush();
+	m_defragmenter.reset();
+	m_deletionQueue.reset();
+	m_stagingRing.reset();
 	vkDestroyDescriptorPool(m_logicalDevice, m_descriptorPool, nullptr);
+	vkDestroyCommandPool(m_logicalDevice, m_computeCommandPool, nullptr);
+	vkDestroyCommandPool(m_logicalDevice, m_transferCommandPool, nullptr);
 	vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+	m_allocator.reset();
 	vkDestroyDevice(m_logicalDevice, nullptr);
 	if (enableValidationLayers)
 	{
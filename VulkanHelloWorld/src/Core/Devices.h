@@ -4,11 +4,19 @@
 #include <GLFW/glfw3.h>
 #include<vector>
 #include<optional>
+#include<memory>
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "Defragmenter.h"
+#include "DeletionQueue.h"
 
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	//没有专用队列族时退回到图形队列族，所以这两个总是有值
+	std::optional<uint32_t> transferFamily;
+	std::optional<uint32_t> computeFamily;
 	inline bool isComplete()
 	{
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -17,13 +25,13 @@ struct QueueFamilyIndices
 
 struct SwapChainSupportDetails
 {
-	//VkSurfaceCapabilitiesKHRһṹ壬˽һЩ
+	//VkSurfaceCapabilitiesKHR是一个结构体，里面包含了交换链的一些基本能力
 	VkSurfaceCapabilitiesKHR capabilities;
 
-	//VkSurfaceFormatKHRһṹ壬formatcolorSpace
+	//VkSurfaceFormatKHR是一个结构体，里面包含了format和colorSpace
 	std::vector<VkSurfaceFormatKHR> formats;
 
-	//VkPresentModeKHR˽ʾģʽ޴ֱͬȣΪҪ
+	//VkPresentModeKHR包含了交换链的显示模式，包括有无垂直同步等，极为重要
 	std::vector<VkPresentModeKHR> presentModes;
 };
 
@@ -31,7 +39,7 @@ class Devices
 {
 public:
 	const static inline std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-	Devices(GLFWwindow* window, int maxFrame);
+	Devices(GLFWwindow* window, int maxFrame, VkDeviceSize stagingRingSize = 32ull * 1024 * 1024);
 	~Devices();
 
 	Devices(const Devices&) = delete;
@@ -42,25 +50,50 @@ public:
 	VkDevice getLogicalDevice() const { return m_logicalDevice; }
 	VkQueue getGraphicsQueue() const { return m_graphicsQueue; }
 	VkQueue getPresentQueue() const { return m_presentQueue; }
+	VkQueue getTransferQueue() const { return m_transferQueue; }
+	VkQueue getComputeQueue() const { return m_computeQueue; }
 	VkCommandPool getCommandPool() const { return m_commandPool; }
+	VkCommandPool getTransferCommandPool() const { return m_transferCommandPool; }
+	VkCommandPool getComputeCommandPool() const { return m_computeCommandPool; }
+	const QueueFamilyIndices& getQueueFamilies() const { return m_queueFamilies; }
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return m_memProperties; }
+	//传输队列和图形队列不是同一个队列族时，资源交接需要做所有权转移
+	bool hasDedicatedTransferQueue() const { return m_queueFamilies.transferFamily != m_queueFamilies.graphicsFamily; }
 	VkSurfaceKHR getSurface() const { return m_surface; }
 	VkDebugUtilsMessengerEXT getDebugCallback() const { return m_callback; }
 	SwapChainSupportDetails getSwapChainSupportDetails(VkPhysicalDevice device) { return querySwapChainSupport(m_physicalDevice); }
 	QueueFamilyIndices getQueueFamilyIndices(VkPhysicalDevice device) { return findQueueFamilies(device); }
 	VkDescriptorPool getDescriptorPool() const { return m_descriptorPool; }
+	MemoryAllocator& getAllocator() { return *m_allocator; }
+	StagingRing& getStagingRing() { return *m_stagingRing; }
+	Defragmenter& getDefragmenter() { return *m_defragmenter; }
+	DeletionQueue& getDeletionQueue() { return *m_deletionQueue; }
+	int getMaxFramesInFlight() const { return m_MAX_FRAMES_IN_FLIGHT; }
 
 private:
 	
 
 	VkInstance m_instance;
 	VkDebugUtilsMessengerEXT m_callback;
-	VkSurfaceKHR m_surface; // Surface Ϊѡ豸ʱҪǷ֧ʾ
+	VkSurfaceKHR m_surface; // Surface 必须放这里，因为选择物理设备时要检查是否支持显示
 	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
 	VkDevice m_logicalDevice;
 	VkQueue m_graphicsQueue;
 	VkQueue m_presentQueue;
+	VkQueue m_transferQueue;
+	VkQueue m_computeQueue;
+	QueueFamilyIndices m_queueFamilies;
+	VkPhysicalDeviceMemoryProperties m_memProperties; // 选好物理设备后查询一次，之后都用缓存
+	bool m_properties2Enabled = false;                // 实例启用了 VK_KHR_get_physical_device_properties2
+	bool m_memoryBudgetEnabled = false;               // 设备启用了 VK_EXT_memory_budget
 	VkCommandPool m_commandPool;
+	VkCommandPool m_transferCommandPool;
+	VkCommandPool m_computeCommandPool;
 	VkDescriptorPool m_descriptorPool;
+	std::unique_ptr<MemoryAllocator> m_allocator;
+	std::unique_ptr<StagingRing> m_stagingRing;
+	std::unique_ptr<Defragmenter> m_defragmenter;
+	std::unique_ptr<DeletionQueue> m_deletionQueue;
 
 	const int m_MAX_FRAMES_IN_FLIGHT;
 
@@ -0,0 +1,54 @@
+﻿#include "DirtyRanges.h"
+#include <algorithm>
+
+void DirtyRanges::add(VkDeviceSize offset, VkDeviceSize size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	//连续写同一段或紧挨着写（逐个实体更新时很常见）直接延长上一段，不增加区间数
+	if (!m_ranges.empty())
+	{
+		Range& last = m_ranges.back();
+		if (offset >= last.begin && offset <= last.end)
+		{
+			last.end = std::max(last.end, offset + size);
+			return;
+		}
+	}
+	m_ranges.push_back({ offset, offset + size });
+}
+
+uint32_t DirtyRanges::coalesce(VkDeviceSize srcBase, VkBufferCopy* regions)
+{
+	if (m_ranges.empty())
+	{
+		return 0;
+	}
+
+	//按起点排序后线性合并
+	std::sort(m_ranges.begin(), m_ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+	uint32_t regionCount = 0;
+	Range current = m_ranges[0];
+	for (size_t i = 1; i <= m_ranges.size(); i++)
+	{
+		if (i < m_ranges.size() && m_ranges[i].begin <= current.end + m_mergeGap)
+		{
+			current.end = std::max(current.end, m_ranges[i].end);
+			continue;
+		}
+
+		VkBufferCopy& region = regions[regionCount++];
+		region.srcOffset = srcBase + current.begin;
+		region.dstOffset = current.begin;
+		region.size = current.end - current.begin;
+		if (i < m_ranges.size())
+		{
+			current = m_ranges[i];
+		}
+	}
+	m_ranges.clear();
+	return regionCount;
+}
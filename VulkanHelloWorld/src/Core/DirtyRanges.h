@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// TrackedBuffer 的脏区间记录，不涉及 Vulkan 对象，可以单独测试
+// add 记下改动过的 [offset, offset + size)，coalesce 把它们排序合并成尽量少的 VkBufferCopy：
+// 重叠、相邻或空隙不超过 mergeGap 的区间并成一段，合并后的区域按偏移递增、互不重叠
+class DirtyRanges
+{
+public:
+	//两段脏区间之间的空隙小于这个值就一起拷，多拷几十字节比多一个拷贝区域便宜
+	static constexpr VkDeviceSize kDefaultMergeGap = 256;
+
+	explicit DirtyRanges(VkDeviceSize mergeGap = kDefaultMergeGap) : m_mergeGap(mergeGap) {}
+
+	void add(VkDeviceSize offset, VkDeviceSize size);
+
+	bool empty() const { return m_ranges.empty(); }
+	//合并前的区间数，也是 coalesce 输出区域数的上限
+	size_t size() const { return m_ranges.size(); }
+
+	//regions 至少能放 size() 个；srcOffset = srcBase + 区间起点，dstOffset = 区间起点。返回区域数并清空记录
+	uint32_t coalesce(VkDeviceSize srcBase, VkBufferCopy* regions);
+
+private:
+	struct Range
+	{
+		VkDeviceSize begin;
+		VkDeviceSize end;
+	};
+
+	VkDeviceSize m_mergeGap;
+	std::vector<Range> m_ranges;
+};
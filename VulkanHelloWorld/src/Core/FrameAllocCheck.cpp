@@ -0,0 +1,116 @@
+﻿#include "FrameAllocCheck.h"
+
+#ifdef FRAME_ALLOC_CHECK
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	//前几帧会有 vector 扩容、ImGui 建字体/窗口等一次性的分配
+	constexpr uint64_t kWarmupFrames = 120;
+
+	thread_local bool s_armed = false;
+	thread_local size_t s_allocations = 0;
+	thread_local size_t s_bytes = 0;
+	uint64_t s_frame = 0;
+
+	void* allocateChecked(size_t size)
+	{
+		if (s_armed)
+		{
+			s_allocations++;
+			s_bytes += size;
+		}
+		void* p = std::malloc(size == 0 ? 1 : size);
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	void* allocateAlignedChecked(size_t size, size_t alignment)
+	{
+		if (s_armed)
+		{
+			s_allocations++;
+			s_bytes += size;
+		}
+#ifdef _MSC_VER
+		void* p = _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+		void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+		if (!p)
+		{
+			throw std::bad_alloc();
+		}
+		return p;
+	}
+
+	void freeAligned(void* p)
+	{
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
+void FrameAllocCheck::beginFrame()
+{
+	s_frame++;
+	s_allocations = 0;
+	s_bytes = 0;
+	s_armed = s_frame > kWarmupFrames;
+}
+
+void FrameAllocCheck::endFrame()
+{
+	if (!s_armed)
+	{
+		return;
+	}
+	s_armed = false;
+	if (s_allocations > 0)
+	{
+		throw std::runtime_error("heap allocation inside frame loop: " + std::to_string(s_allocations) + " allocations, "
+			+ std::to_string(s_bytes) + " bytes in frame " + std::to_string(s_frame) + "!");
+	}
+}
+
+void FrameAllocCheck::abortFrame()
+{
+	s_armed = false;
+}
+
+void* operator new(size_t size) { return allocateChecked(size); }
+void* operator new[](size_t size) { return allocateChecked(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try { return allocateChecked(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	try { return allocateChecked(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAlignedChecked(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAlignedChecked(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+#endif
@@ -0,0 +1,20 @@
+﻿#pragma once
+
+// 测试模式：在预处理器定义里加上 FRAME_ALLOC_CHECK 后替换全局 operator new，
+// 预热若干帧之后，beginFrame 到 endFrame 之间只要有一次堆分配，endFrame 就抛出异常
+// 只统计调用 beginFrame 的线程，后台加载线程的分配不受影响；没有定义时全部是空函数
+// 窗口只覆盖 Renderer::beginFrame（删除队列、暂存环、碎片整理这些维护工作之后）到 endFrame 的录制和提交，
+// Scene::update（换上加载完的模型）和 ImGui 面板在 beginFrame 之前执行，不在检查范围内
+namespace FrameAllocCheck
+{
+#ifdef FRAME_ALLOC_CHECK
+	void beginFrame();
+	void endFrame();
+	//中途放弃这一帧（比如交换链过期）时调用，不做检查
+	void abortFrame();
+#else
+	inline void beginFrame() {}
+	inline void endFrame() {}
+	inline void abortFrame() {}
+#endif
+}
@@ -0,0 +1,29 @@
+﻿#include "FrameArena.h"
+#include <algorithm>
+#include <stdexcept>
+
+FrameArena::FrameArena(size_t capacity)
+	:m_memory(std::make_unique<char[]>(capacity)), m_capacity(capacity)
+{
+}
+
+void FrameArena::beginFrame()
+{
+	m_peak = std::max(m_peak, m_head);
+	m_head = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	uintptr_t base = reinterpret_cast<uintptr_t>(m_memory.get());
+	uintptr_t start = (base + m_head + alignment - 1) / alignment * alignment;
+	size_t offset = static_cast<size_t>(start - base);
+	if (offset + size > m_capacity)
+	{
+		//和 uniform 环一样直接报错，而不是退回堆分配，容量不够说明需要调大
+		throw std::runtime_error("frame arena out of space for this frame!");
+	}
+	m_head = offset + size;
+	m_peak = std::max(m_peak, m_head);
+	return reinterpret_cast<void*>(start);
+}
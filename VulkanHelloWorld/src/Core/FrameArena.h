@@ -0,0 +1,44 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// 每帧一次性的线性分配器：只做指针递增，beginFrame 时整体清空，不会单独释放
+// 用来存放只在录制期间有效的临时数据（比如 TrackedBuffer 合并后的拷贝区域），加载期的构建不要从这里取；Vulkan 在录制/调用时就会拷走参数，用完即可丢弃
+// 分配出来的指针在本帧内一直稳定，不会像 vector 扩容那样失效
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void beginFrame();
+
+	void* allocate(size_t size, size_t alignment);
+	//只支持平凡类型，析构函数不会被调用
+	template<typename T>
+	T* allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "FrameArena only holds trivially destructible types");
+		T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		for (size_t i = 0; i < count; i++)
+		{
+			new (data + i) T{};
+		}
+		return data;
+	}
+
+	size_t getCapacity() const { return m_capacity; }
+	size_t getUsedBytes() const { return m_head; }
+	size_t getPeakBytes() const { return m_peak; }
+
+private:
+	std::unique_ptr<char[]> m_memory;
+	size_t m_capacity;
+	size_t m_head = 0;
+	size_t m_peak = 0;
+};
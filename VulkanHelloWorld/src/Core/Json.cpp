@@ -0,0 +1,279 @@
+﻿#include "Json.h"
+#include <charconv>
+#include <stdexcept>
+
+namespace
+{
+	const JsonValue kNull{};
+
+	//递归下降的深度上限，防止恶意文件把栈打爆
+	constexpr int kMaxDepth = 256;
+
+	void appendUtf8(std::string& out, uint32_t code)
+	{
+		if (code < 0x80)
+		{
+			out += static_cast<char>(code);
+		}
+		else if (code < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+}
+
+class JsonParser
+{
+public:
+	explicit JsonParser(std::string_view text) : m_text(text) {}
+
+	JsonValue parseDocument()
+	{
+		JsonValue value = parseValue(0);
+		skipWhitespace();
+		if (m_pos != m_text.size())
+		{
+			fail("trailing characters");
+		}
+		return value;
+	}
+
+private:
+	std::string_view m_text;
+	size_t m_pos = 0;
+
+	[[noreturn]] void fail(const char* what)
+	{
+		throw std::runtime_error("failed to parse json: " + std::string(what) + " at offset " + std::to_string(m_pos) + "!");
+	}
+
+	void skipWhitespace()
+	{
+		while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\n' || m_text[m_pos] == '\r'))
+		{
+			m_pos++;
+		}
+	}
+
+	bool consume(char c)
+	{
+		skipWhitespace();
+		if (m_pos < m_text.size() && m_text[m_pos] == c)
+		{
+			m_pos++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c)
+	{
+		if (!consume(c))
+		{
+			fail("unexpected character");
+		}
+	}
+
+	bool consumeLiteral(std::string_view literal)
+	{
+		if (m_text.substr(m_pos, literal.size()) == literal)
+		{
+			m_pos += literal.size();
+			return true;
+		}
+		return false;
+	}
+
+	JsonValue parseValue(int depth)
+	{
+		if (depth > kMaxDepth)
+		{
+			fail("nesting too deep");
+		}
+		skipWhitespace();
+		if (m_pos >= m_text.size())
+		{
+			fail("unexpected end");
+		}
+
+		JsonValue value;
+		char c = m_text[m_pos];
+		if (c == '{')
+		{
+			m_pos++;
+			value.m_type = JsonValue::Type::Object;
+			if (consume('}'))
+			{
+				return value;
+			}
+			do
+			{
+				skipWhitespace();
+				std::string key = parseString();
+				expect(':');
+				value.m_object.emplace_back(std::move(key), parseValue(depth + 1));
+			} while (consume(','));
+			expect('}');
+		}
+		else if (c == '[')
+		{
+			m_pos++;
+			value.m_type = JsonValue::Type::Array;
+			if (consume(']'))
+			{
+				return value;
+			}
+			do
+			{
+				value.m_array.push_back(parseValue(depth + 1));
+			} while (consume(','));
+			expect(']');
+		}
+		else if (c == '"')
+		{
+			value.m_type = JsonValue::Type::String;
+			value.m_string = parseString();
+		}
+		else if (consumeLiteral("true") || consumeLiteral("false"))
+		{
+			value.m_type = JsonValue::Type::Bool;
+			value.m_bool = c == 't';
+		}
+		else if (consumeLiteral("null"))
+		{
+		}
+		else
+		{
+			value.m_type = JsonValue::Type::Number;
+			const char* begin = m_text.data() + m_pos;
+			const char* end = m_text.data() + m_text.size();
+			auto [next, error] = std::from_chars(begin, end, value.m_number);
+			if (error != std::errc() || next == begin)
+			{
+				fail("invalid value");
+			}
+			m_pos += static_cast<size_t>(next - begin);
+		}
+		return value;
+	}
+
+	std::string parseString()
+	{
+		if (m_pos >= m_text.size() || m_text[m_pos] != '"')
+		{
+			fail("expected string");
+		}
+		m_pos++;
+		std::string out;
+		while (true)
+		{
+			if (m_pos >= m_text.size())
+			{
+				fail("unterminated string");
+			}
+			char c = m_text[m_pos++];
+			if (c == '"')
+			{
+				return out;
+			}
+			if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+			if (m_pos >= m_text.size())
+			{
+				fail("unterminated string");
+			}
+			char escape = m_text[m_pos++];
+			switch (escape)
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				uint32_t code = parseHex4();
+				//代理对拼回一个码点，落单的代理按原样编码
+				if (code >= 0xD800 && code < 0xDC00 && consumeLiteral("\\u"))
+				{
+					uint32_t low = parseHex4();
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, code);
+				break;
+			}
+			default:
+				fail("invalid escape");
+			}
+		}
+	}
+
+	uint32_t parseHex4()
+	{
+		if (m_pos + 4 > m_text.size())
+		{
+			fail("invalid unicode escape");
+		}
+		uint32_t code = 0;
+		auto [next, error] = std::from_chars(m_text.data() + m_pos, m_text.data() + m_pos + 4, code, 16);
+		if (error != std::errc() || next != m_text.data() + m_pos + 4)
+		{
+			fail("invalid unicode escape");
+		}
+		m_pos += 4;
+		return code;
+	}
+};
+
+JsonValue JsonValue::parse(std::string_view text)
+{
+	return JsonParser(text).parseDocument();
+}
+
+const JsonValue* JsonValue::find(std::string_view key) const
+{
+	for (const auto& [name, value] : m_object)
+	{
+		if (name == key)
+		{
+			return &value;
+		}
+	}
+	return nullptr;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const
+{
+	const JsonValue* value = find(key);
+	return value ? *value : kNull;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	return index < m_array.size() ? m_array[index] : kNull;
+}
+
+size_t JsonValue::size() const
+{
+	return m_type == Type::Array ? m_array.size() : m_type == Type::Object ? m_object.size() : 0;
+}
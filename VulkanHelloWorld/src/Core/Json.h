@@ -0,0 +1,48 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 只读的 JSON 文档树，够 glTF 的 JSON 块用：数字一律存成 double，对象按出现顺序存成键值对
+// 访问不存在的键或越界的下标返回一个 null，不抛异常，取值时用默认值兜底；只有 parse 遇到语法错误才抛
+class JsonValue
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	static JsonValue parse(std::string_view text);
+
+	Type getType() const { return m_type; }
+	bool isNull() const { return m_type == Type::Null; }
+	bool isNumber() const { return m_type == Type::Number; }
+	bool isString() const { return m_type == Type::String; }
+	bool isArray() const { return m_type == Type::Array; }
+	bool isObject() const { return m_type == Type::Object; }
+
+	bool contains(std::string_view key) const { return find(key) != nullptr; }
+	const JsonValue& operator[](std::string_view key) const;
+	const JsonValue& operator[](size_t index) const;
+	//数组的元素个数，对象的键个数，其它为 0
+	size_t size() const;
+
+	bool asBool(bool fallback = false) const { return m_type == Type::Bool ? m_bool : fallback; }
+	double asNumber(double fallback = 0.0) const { return m_type == Type::Number ? m_number : fallback; }
+	//整数字段（下标、字节偏移），不是数字时返回 fallback
+	long long asInt(long long fallback = 0) const { return m_type == Type::Number ? static_cast<long long>(m_number) : fallback; }
+	const std::string& asString() const { return m_string; }
+	const std::vector<JsonValue>& getArray() const { return m_array; }
+	const std::vector<std::pair<std::string, JsonValue>>& getObject() const { return m_object; }
+
+private:
+	Type m_type = Type::Null;
+	bool m_bool = false;
+	double m_number = 0.0;
+	std::string m_string;
+	std::vector<JsonValue> m_array;
+	std::vector<std::pair<std::string, JsonValue>> m_object;
+
+	friend class JsonParser;
+	const JsonValue* find(std::string_view key) const;
+};
@@ -0,0 +1,27 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+
+// 只读内存映射文件：大模型文件不用整块读进内存，按需由系统换页
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+};
@@ -0,0 +1,576 @@
+﻿#include "MemoryAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+
+namespace
+{
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+}
+
+const char* getMemoryUsageName(MemoryUsage usage)
+{
+	switch (usage)
+	{
+	case MemoryUsage::Mesh: return "mesh";
+	case MemoryUsage::Texture: return "texture";
+	case MemoryUsage::Uniform: return "uniform";
+	case MemoryUsage::RenderTarget: return "render_target";
+	case MemoryUsage::Staging: return "staging";
+	default: return "other";
+	}
+}
+
+BlockMetadata::BlockMetadata(VkDeviceSize size) : m_size(size)
+{
+	insertFreeRange(0, size);
+}
+
+bool BlockMetadata::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset)
+{
+	if (size == 0 || size > m_size - m_usedSize)
+	{
+		return false;
+	}
+
+	//从不小于 size 的最小空闲区间开始找，对齐后放得下就用
+	for (auto it = m_freeBySize.lower_bound(size); it != m_freeBySize.end(); ++it)
+	{
+		VkDeviceSize rangeBegin = it->second;
+		VkDeviceSize rangeSize = it->first;
+		VkDeviceSize alignedOffset = alignUp(rangeBegin, alignment);
+		VkDeviceSize padding = alignedOffset - rangeBegin;
+		if (padding + size > rangeSize)
+		{
+			continue;
+		}
+
+		eraseFreeRange(m_freeRanges.find(rangeBegin));
+
+		//前置空隙算在这次分配里，释放时一起还回去，避免产生一堆几字节的碎片
+		VkDeviceSize used = padding + size;
+		if (used < rangeSize)
+		{
+			insertFreeRange(rangeBegin + used, rangeSize - used);
+		}
+
+		m_allocations[alignedOffset] = Range{ rangeBegin, used };
+		m_usedSize += used;
+		outOffset = alignedOffset;
+		return true;
+	}
+
+	return false;
+}
+
+void BlockMetadata::free(VkDeviceSize offset)
+{
+	auto it = m_allocations.find(offset);
+	if (it == m_allocations.end())
+	{
+		throw std::runtime_error("failed to free allocation: unknown offset!");
+	}
+
+	VkDeviceSize begin = it->second.begin;
+	VkDeviceSize size = it->second.size;
+	m_usedSize -= size;
+	m_allocations.erase(it);
+
+	//和右边的空闲区间合并
+	auto next = m_freeRanges.find(begin + size);
+	if (next != m_freeRanges.end())
+	{
+		size += next->second;
+		eraseFreeRange(next);
+	}
+
+	//和左边的空闲区间合并
+	auto prev = m_freeRanges.lower_bound(begin);
+	if (prev != m_freeRanges.begin())
+	{
+		--prev;
+		if (prev->first + prev->second == begin)
+		{
+			begin = prev->first;
+			size += prev->second;
+			eraseFreeRange(prev);
+		}
+	}
+
+	insertFreeRange(begin, size);
+}
+
+void BlockMetadata::grow(VkDeviceSize newSize)
+{
+	if (newSize <= m_size)
+	{
+		return;
+	}
+
+	VkDeviceSize begin = m_size;
+	VkDeviceSize size = newSize - m_size;
+	auto last = m_freeRanges.empty() ? m_freeRanges.end() : std::prev(m_freeRanges.end());
+	if (last != m_freeRanges.end() && last->first + last->second == m_size)
+	{
+		begin = last->first;
+		size += last->second;
+		eraseFreeRange(last);
+	}
+	insertFreeRange(begin, size);
+	m_size = newSize;
+}
+
+VkDeviceSize BlockMetadata::getLargestFreeRange() const
+{
+	return m_freeBySize.empty() ? 0 : m_freeBySize.rbegin()->first;
+}
+
+VkDeviceSize BlockMetadata::getFreeSize() const
+{
+	VkDeviceSize size = 0;
+	for (const auto& [begin, rangeSize] : m_freeRanges)
+	{
+		size += rangeSize;
+	}
+	return size;
+}
+
+void BlockMetadata::insertFreeRange(VkDeviceSize begin, VkDeviceSize size)
+{
+	m_freeRanges[begin] = size;
+	m_freeBySize.emplace(size, begin);
+}
+
+void BlockMetadata::eraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator it)
+{
+	auto range = m_freeBySize.equal_range(it->second);
+	for (auto bySize = range.first; bySize != range.second; ++bySize)
+	{
+		if (bySize->second == it->first)
+		{
+			m_freeBySize.erase(bySize);
+			break;
+		}
+	}
+	m_freeRanges.erase(it);
+}
+
+struct MemoryBlock
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mappedData = nullptr;
+	uint32_t memoryTypeIndex = 0;
+	bool linear = true;
+	bool dedicated = false;   // 大资源单独占一整块，释放时直接还给驱动
+	bool defragSource = false;// 正在被碎片整理搬空，不再接受新分配
+	uint32_t pinnedCount = 0; // 不能搬动的分配数量（Mesh/Texture 以外的用途）
+	BlockMetadata metadata;
+
+	explicit MemoryBlock(VkDeviceSize size) : metadata(size) {}
+};
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memProperties,
+	PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2, VkDeviceSize preferredBlockSize)
+	: m_device(device), m_physicalDevice(physicalDevice), m_memProperties(memProperties),
+	m_getMemoryProperties2(getMemoryProperties2), m_preferredBlockSize(preferredBlockSize)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (auto& typePools : m_pools)
+	{
+		for (auto& pool : typePools)
+		{
+			for (auto& block : pool)
+			{
+				if (block->mappedData)
+				{
+					vkUnmapMemory(m_device, block->memory);
+				}
+				vkFreeMemory(m_device, block->memory, nullptr);
+			}
+			pool.clear();
+		}
+	}
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, MemoryUsage usage)
+{
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	//粒度为 1 时线性和非线性资源可以紧挨着放，共用一组块
+	bool poolLinear = m_bufferImageGranularity > 1 ? linear : true;
+	auto& pool = m_pools[memoryTypeIndex][poolLinear ? 1 : 0];
+
+	VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+	MemoryBlock* target = nullptr;
+	VkDeviceSize offset = 0;
+
+	if (requirements.size > blockSize / 2)
+	{
+		target = createBlock(memoryTypeIndex, requirements.size, poolLinear, true);
+		target->metadata.allocate(requirements.size, requirements.alignment, offset);
+	}
+	else
+	{
+		for (auto& block : pool)
+		{
+			if (!block->dedicated && !block->defragSource && block->metadata.allocate(requirements.size, requirements.alignment, offset))
+			{
+				target = block.get();
+				break;
+			}
+		}
+
+		if (!target)
+		{
+			target = createBlock(memoryTypeIndex, blockSize, poolLinear, false);
+			if (!target->metadata.allocate(requirements.size, requirements.alignment, offset))
+			{
+				throw std::runtime_error("failed to sub-allocate memory from new block!");
+			}
+		}
+	}
+
+	Allocation allocation{};
+	allocation.memory = target->memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.usage = usage;
+	allocation.block = target;
+	if (target->mappedData)
+	{
+		allocation.mappedData = static_cast<char*>(target->mappedData) + offset;
+	}
+
+	if (!isMovableUsage(usage))
+	{
+		target->pinnedCount++;
+	}
+
+	uint32_t heapIndex = m_memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	m_heapUsage[heapIndex][static_cast<size_t>(usage)] += requirements.size;
+	return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+	MemoryBlock* block = allocation.block;
+	if (!block)
+	{
+		return;
+	}
+
+	block->metadata.free(allocation.offset);
+	if (!isMovableUsage(allocation.usage))
+	{
+		block->pinnedCount--;
+	}
+	uint32_t heapIndex = m_memProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+	m_heapUsage[heapIndex][static_cast<size_t>(allocation.usage)] -= allocation.size;
+	allocation = Allocation{};
+
+	if (!block->metadata.isEmpty())
+	{
+		return;
+	}
+
+	//搬空了，留下来的话可以重新接受分配
+	block->defragSource = false;
+	if (block->dedicated)
+	{
+		destroyBlock(block);
+		return;
+	}
+
+	//每组最多保留一个空块，避免在阈值附近反复申请/释放
+	auto& pool = m_pools[block->memoryTypeIndex][block->linear ? 1 : 0];
+	for (auto& other : pool)
+	{
+		if (other.get() != block && !other->dedicated && other->metadata.isEmpty())
+		{
+			destroyBlock(block);
+			return;
+		}
+	}
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (m_memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool MemoryAllocator::supportsDirectWrite(uint32_t typeFilter, bool requireLargeHeap) const
+{
+	const VkMemoryPropertyFlags directWrite = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	VkDeviceSize largestDeviceLocalHeap = 0;
+	for (uint32_t i = 0; i < m_memProperties.memoryHeapCount; i++)
+	{
+		if (m_memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			largestDeviceLocalHeap = std::max(largestDeviceLocalHeap, m_memProperties.memoryHeaps[i].size);
+		}
+	}
+
+	for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++)
+	{
+		if (!(typeFilter & (1 << i)) || (m_memProperties.memoryTypes[i].propertyFlags & directWrite) != directWrite)
+		{
+			continue;
+		}
+
+		VkDeviceSize heapSize = m_memProperties.memoryHeaps[m_memProperties.memoryTypes[i].heapIndex].size;
+		if (!requireLargeHeap || heapSize * 2 >= largestDeviceLocalHeap)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+AllocatorStats MemoryAllocator::getStats() const
+{
+	AllocatorStats stats{};
+	VkDeviceSize freeBytes = 0;
+	for (auto& typePools : m_pools)
+	{
+		for (auto& pool : typePools)
+		{
+			for (auto& block : pool)
+			{
+				const BlockMetadata& metadata = block->metadata;
+				stats.blockCount++;
+				stats.allocationCount += metadata.getAllocationCount();
+				stats.reservedBytes += metadata.getSize();
+				stats.usedBytes += metadata.getUsedSize();
+				stats.freeRangeCount += metadata.getFreeRangeCount();
+				stats.largestFreeRange = std::max(stats.largestFreeRange, metadata.getLargestFreeRange());
+				freeBytes += metadata.getSize() - metadata.getUsedSize();
+			}
+		}
+	}
+
+	if (freeBytes > 0)
+	{
+		stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes);
+	}
+	return stats;
+}
+
+std::vector<HeapStats> MemoryAllocator::getHeapStats() const
+{
+	std::vector<HeapStats> heaps;
+	getHeapStats(heaps);
+	return heaps;
+}
+
+void MemoryAllocator::getHeapStats(std::vector<HeapStats>& heaps) const
+{
+	//resize 到同样大小时不会重新分配，每帧刷新面板可以复用同一个 vector
+	heaps.resize(m_memProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < m_memProperties.memoryHeapCount; i++)
+	{
+		heaps[i].size = m_memProperties.memoryHeaps[i].size;
+		heaps[i].flags = m_memProperties.memoryHeaps[i].flags;
+		heaps[i].reservedBytes = m_heapReserved[i];
+		for (size_t usage = 0; usage < static_cast<size_t>(MemoryUsage::Count); usage++)
+		{
+			heaps[i].usedBytes[usage] = m_heapUsage[i][usage];
+		}
+	}
+
+	//budget 会随着其他进程的占用变化，每次都重新查询
+	if (m_getMemoryProperties2)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memProperties2{};
+		memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memProperties2.pNext = &budgetProperties;
+		m_getMemoryProperties2(m_physicalDevice, &memProperties2);
+
+		for (uint32_t i = 0; i < m_memProperties.memoryHeapCount; i++)
+		{
+			heaps[i].budget = budgetProperties.heapBudget[i];
+			heaps[i].driverUsage = budgetProperties.heapUsage[i];
+		}
+	}
+}
+
+void MemoryAllocator::writeJsonReport(std::ostream& out) const
+{
+	AllocatorStats stats = getStats();
+	std::vector<HeapStats> heaps = getHeapStats();
+
+	out << "{\n";
+	out << "  \"memoryBudgetSupported\": " << (isMemoryBudgetSupported() ? "true" : "false") << ",\n";
+	out << "  \"blockCount\": " << stats.blockCount << ",\n";
+	out << "  \"allocationCount\": " << stats.allocationCount << ",\n";
+	out << "  \"reservedBytes\": " << stats.reservedBytes << ",\n";
+	out << "  \"usedBytes\": " << stats.usedBytes << ",\n";
+	out << "  \"fragmentation\": " << stats.fragmentation << ",\n";
+	out << "  \"heaps\": [\n";
+	for (size_t i = 0; i < heaps.size(); i++)
+	{
+		const HeapStats& heap = heaps[i];
+		out << "    {\n";
+		out << "      \"index\": " << i << ",\n";
+		out << "      \"size\": " << heap.size << ",\n";
+		out << "      \"deviceLocal\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false") << ",\n";
+		out << "      \"reservedBytes\": " << heap.reservedBytes << ",\n";
+		out << "      \"budget\": " << heap.budget << ",\n";
+		out << "      \"driverUsage\": " << heap.driverUsage << ",\n";
+		out << "      \"usedBytes\": {";
+		for (size_t usage = 0; usage < static_cast<size_t>(MemoryUsage::Count); usage++)
+		{
+			out << (usage ? ", " : " ") << "\"" << getMemoryUsageName(static_cast<MemoryUsage>(usage)) << "\": " << heap.usedBytes[usage];
+		}
+		out << " }\n";
+		out << "    }" << (i + 1 < heaps.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+size_t MemoryAllocator::beginDefragmentation()
+{
+	size_t sourceCount = 0;
+	for (auto& typePools : m_pools)
+	{
+		for (auto& pool : typePools)
+		{
+			MemoryBlock* candidate = nullptr;
+			VkDeviceSize totalFree = 0;
+			for (auto& block : pool)
+			{
+				if (block->dedicated)
+				{
+					continue;
+				}
+				totalFree += block->metadata.getSize() - block->metadata.getUsedSize();
+				if (block->pinnedCount > 0 || block->metadata.isEmpty())
+				{
+					continue;
+				}
+				if (!candidate || block->metadata.getUsedSize() < candidate->metadata.getUsedSize())
+				{
+					candidate = block.get();
+				}
+			}
+
+			if (!candidate)
+			{
+				continue;
+			}
+
+			//只有不到一半在用、而且其它块的空闲空间装得下时才值得搬，否则只会多申请一个新块
+			VkDeviceSize used = candidate->metadata.getUsedSize();
+			VkDeviceSize otherFree = totalFree - (candidate->metadata.getSize() - used);
+			if (used * 2 <= candidate->metadata.getSize() && otherFree >= used)
+			{
+				candidate->defragSource = true;
+				sourceCount++;
+			}
+		}
+	}
+	return sourceCount;
+}
+
+void MemoryAllocator::endDefragmentation()
+{
+	for (auto& typePools : m_pools)
+	{
+		for (auto& pool : typePools)
+		{
+			for (auto& block : pool)
+			{
+				block->defragSource = false;
+			}
+		}
+	}
+}
+
+bool MemoryAllocator::isDefragmentationSource(const Allocation& allocation) const
+{
+	return allocation.block && allocation.block->defragSource;
+}
+
+bool MemoryAllocator::isMovableUsage(MemoryUsage usage)
+{
+	return usage == MemoryUsage::Mesh || usage == MemoryUsage::Texture;
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+{
+	//小堆（比如 256MB 的 BAR）上不要一次吃掉太多
+	uint32_t heapIndex = m_memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize = m_memProperties.memoryHeaps[heapIndex].size;
+	return std::min(m_preferredBlockSize, heapSize / 8);
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool linear, bool dedicated)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	auto block = std::make_unique<MemoryBlock>(size);
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->linear = linear;
+	block->dedicated = dedicated;
+
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate memory block!");
+	}
+
+	//HOST_VISIBLE 的块整块常驻映射，同一块 VkDeviceMemory 不能被映射两次
+	if (m_memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(m_device, block->memory, 0, size, 0, &block->mappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(m_device, block->memory, nullptr);
+			throw std::runtime_error("failed to map memory block!");
+		}
+	}
+
+	m_heapReserved[m_memProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+
+	auto& pool = m_pools[memoryTypeIndex][linear ? 1 : 0];
+	pool.push_back(std::move(block));
+	return pool.back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+	auto& pool = m_pools[block->memoryTypeIndex][block->linear ? 1 : 0];
+	auto it = std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; });
+	if (it == pool.end())
+	{
+		return;
+	}
+
+	if (block->mappedData)
+	{
+		vkUnmapMemory(m_device, block->memory);
+	}
+	vkFreeMemory(m_device, block->memory, nullptr);
+	m_heapReserved[m_memProperties.memoryTypes[block->memoryTypeIndex].heapIndex] -= block->metadata.getSize();
+	pool.erase(it);
+}
@@ -0,0 +1,153 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include <memory>
+#include <ostream>
+
+// 单个内存块内部的区间管理：空闲链表 + best-fit
+// 这里只做纯 CPU 的偏移计算，不调用任何 Vulkan 函数，不需要 GPU 也能单独测试
+class BlockMetadata
+{
+public:
+	explicit BlockMetadata(VkDeviceSize size);
+
+	//成功时通过 outOffset 返回已经按 alignment 对齐好的偏移
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset);
+	void free(VkDeviceSize offset);
+	//把管理的范围扩大到 newSize，新增的部分是空闲的（和末尾的空闲区间合并）
+	void grow(VkDeviceSize newSize);
+
+	VkDeviceSize getSize() const { return m_size; }
+	VkDeviceSize getUsedSize() const { return m_usedSize; }
+	VkDeviceSize getLargestFreeRange() const;
+	//所有空闲区间的总大小，和 getUsedSize 加起来应该正好是 getSize
+	VkDeviceSize getFreeSize() const;
+	size_t getFreeRangeCount() const { return m_freeRanges.size(); }
+	size_t getAllocationCount() const { return m_allocations.size(); }
+	bool isEmpty() const { return m_allocations.empty(); }
+
+private:
+	struct Range
+	{
+		VkDeviceSize begin;
+		VkDeviceSize size;
+	};
+
+	VkDeviceSize m_size;
+	VkDeviceSize m_usedSize = 0;
+
+	//空闲区间：起始偏移 -> 大小，用来和左右邻居合并
+	std::map<VkDeviceSize, VkDeviceSize> m_freeRanges;
+	//空闲区间：大小 -> 起始偏移，用来做 best-fit 查找
+	std::multimap<VkDeviceSize, VkDeviceSize> m_freeBySize;
+	//已分配：对齐后的偏移 -> 实际占用的区间（包含对齐产生的前置空隙）
+	std::map<VkDeviceSize, Range> m_allocations;
+
+	void insertFreeRange(VkDeviceSize begin, VkDeviceSize size);
+	void eraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator it);
+};
+
+struct MemoryBlock;
+
+// 分配的用途，用来按类别统计显存
+enum class MemoryUsage : uint32_t
+{
+	Mesh,
+	Texture,
+	Uniform,
+	RenderTarget,
+	Staging,
+	Other,
+	Count
+};
+
+const char* getMemoryUsageName(MemoryUsage usage);
+
+// 一次子分配的结果，buffer/image 绑定时用 memory + offset
+struct Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mappedData = nullptr;   // 只有 HOST_VISIBLE 的内存才有，整块常驻映射
+	uint32_t memoryTypeIndex = 0;
+	MemoryUsage usage = MemoryUsage::Other;
+	MemoryBlock* block = nullptr;
+};
+
+struct AllocatorStats
+{
+	size_t blockCount = 0;
+	size_t allocationCount = 0;
+	VkDeviceSize reservedBytes = 0;     // 向驱动申请的总量
+	VkDeviceSize usedBytes = 0;         // 实际分出去的量
+	size_t freeRangeCount = 0;
+	VkDeviceSize largestFreeRange = 0;
+	float fragmentation = 0.0f;         // 1 - 最大空闲区间/空闲总量，0 表示完全没有碎片
+};
+
+// 单个内存堆的统计，budget/driverUsage 只有启用 VK_EXT_memory_budget 时才有值
+struct HeapStats
+{
+	VkDeviceSize size = 0;
+	VkMemoryHeapFlags flags = 0;
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes[static_cast<size_t>(MemoryUsage::Count)] = {};
+	VkDeviceSize budget = 0;
+	VkDeviceSize driverUsage = 0;
+};
+
+class MemoryAllocator
+{
+public:
+	//getMemoryProperties2 为空表示不支持 VK_EXT_memory_budget
+	MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties& memProperties,
+		PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2 = nullptr, VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	//linear: buffer 和 LINEAR tiling 的 image 为 true，OPTIMAL tiling 的 image 为 false
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, MemoryUsage usage = MemoryUsage::Other);
+	void free(Allocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	//是否有 DEVICE_LOCAL | HOST_VISIBLE | HOST_COHERENT 的内存可以让 CPU 直接写显存
+	//requireLargeHeap: 只认 UMA / ReBAR 这种整块显存都可映射的情况，排除只有 256MB BAR 窗口的独显
+	bool supportsDirectWrite(uint32_t typeFilter, bool requireLargeHeap) const;
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return m_memProperties; }
+	AllocatorStats getStats() const;
+	std::vector<HeapStats> getHeapStats() const;
+	void getHeapStats(std::vector<HeapStats>& heaps) const;
+	bool isMemoryBudgetSupported() const { return m_getMemoryProperties2 != nullptr; }
+	void writeJsonReport(std::ostream& out) const;
+
+	//碎片整理：每组挑一个使用率最低、且其它块放得下它全部内容的块作为搬出源，返回选中的块数
+	//只有 Mesh/Texture 的分配可以被搬动，含有其它用途分配的块不会被选中
+	size_t beginDefragmentation();
+	void endDefragmentation();
+	//源块不再接受新分配，块里的分配搬完并释放后块就空了
+	bool isDefragmentationSource(const Allocation& allocation) const;
+
+private:
+	VkDevice m_device;
+	VkPhysicalDevice m_physicalDevice;
+	VkPhysicalDeviceMemoryProperties m_memProperties;
+	PFN_vkGetPhysicalDeviceMemoryProperties2 m_getMemoryProperties2;
+	VkDeviceSize m_bufferImageGranularity;
+	VkDeviceSize m_preferredBlockSize;
+
+	//每种内存类型一组块；bufferImageGranularity > 1 时线性/非线性资源分开放，天然满足粒度要求
+	std::vector<std::unique_ptr<MemoryBlock>> m_pools[VK_MAX_MEMORY_TYPES][2];
+
+	//每个堆按用途统计已分配的字节数，以及向驱动申请的总量
+	VkDeviceSize m_heapUsage[VK_MAX_MEMORY_HEAPS][static_cast<size_t>(MemoryUsage::Count)] = {};
+	VkDeviceSize m_heapReserved[VK_MAX_MEMORY_HEAPS] = {};
+
+	static bool isMovableUsage(MemoryUsage usage);
+	VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+	MemoryBlock* createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool linear, bool dedicated);
+	void destroyBlock(MemoryBlock* block);
+};
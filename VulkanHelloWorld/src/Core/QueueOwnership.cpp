@@ -0,0 +1,74 @@
+﻿#include "QueueOwnership.h"
+
+namespace
+{
+	VkBufferMemoryBarrier makeBufferBarrier(VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily, VkDeviceSize offset, VkDeviceSize size)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+		return barrier;
+	}
+
+	VkImageMemoryBarrier makeImageBarrier(VkImage image, VkImageAspectFlags aspectFlags, VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t srcFamily, uint32_t dstFamily)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = aspectFlags;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		return barrier;
+	}
+}
+
+void QueueOwnership::releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkDeviceSize offset, VkDeviceSize size)
+{
+	//release 一侧的 dstAccessMask 会被忽略
+	VkBufferMemoryBarrier barrier = makeBufferBarrier(buffer, srcFamily, dstFamily, offset, size);
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void QueueOwnership::acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkDeviceSize offset, VkDeviceSize size)
+{
+	//acquire 一侧的 srcAccessMask 会被忽略
+	VkBufferMemoryBarrier barrier = makeBufferBarrier(buffer, srcFamily, dstFamily, offset, size);
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void QueueOwnership::releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectFlags,
+	VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+	VkImageMemoryBarrier barrier = makeImageBarrier(image, aspectFlags, oldLayout, newLayout, srcFamily, dstFamily);
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void QueueOwnership::acquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectFlags,
+	VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier = makeImageBarrier(image, aspectFlags, oldLayout, newLayout, srcFamily, dstFamily);
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,23 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+
+// 队列族所有权转移（QFOT）
+// EXCLUSIVE 模式的资源从一个队列族交给另一个队列族时，需要在源队列上录一个 release 屏障，
+// 再在目标队列上录一个参数相同的 acquire 屏障，两次提交之间用信号量保证先后顺序
+class QueueOwnership
+{
+public:
+	//offset/size 指定只转移 buffer 的一段，几何池这种多个模型共用的大 buffer 只交接刚写入的区间
+	static void releaseBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	static void acquireBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	//布局转换可以和所有权转移放在同一对屏障里完成，两边的 oldLayout/newLayout 必须一致
+	static void releaseImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectFlags,
+		VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess);
+	static void acquireImage(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectFlags,
+		VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+};
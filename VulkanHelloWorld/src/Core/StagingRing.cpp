@@ -0,0 +1,352 @@
+﻿#include "StagingRing.h"
+#include "Devices.h"
+#include "../Buffer.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	//16 字节同时满足 vkCmdCopyBufferToImage 对 4 字节和 texel 大小的对齐要求
+	constexpr VkDeviceSize kCopyAlignment = 16;
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+StagingRing::StagingRing(Devices& device, VkDeviceSize size)
+	:m_device(device), m_size(size)
+{
+	Buffer::createBuffer(m_device, m_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_buffer, m_allocation, MemoryUsage::Staging);
+}
+
+StagingRing::~StagingRing()
+{
+	wait();
+	for (VkFence fence : m_freeFences)
+	{
+		vkDestroyFence(m_device.getLogicalDevice(), fence, nullptr);
+	}
+	for (VkSemaphore semaphore : m_freeSemaphores)
+	{
+		vkDestroySemaphore(m_device.getLogicalDevice(), semaphore, nullptr);
+	}
+	Buffer::destroyBuffer(m_device, m_buffer, m_allocation);
+}
+
+void StagingRing::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const char* src = static_cast<const char*>(data);
+	VkDeviceSize maxChunk = m_size / 2;
+	VkDeviceSize done = 0;
+	while (done < size)
+	{
+		VkDeviceSize chunk = std::min(size - done, maxChunk);
+		VkDeviceSize offset = acquire(chunk, kCopyAlignment);
+		memcpy(static_cast<char*>(m_allocation.mappedData) + offset, src + done, static_cast<size_t>(chunk));
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = offset;
+		copyRegion.dstOffset = dstOffset + done;
+		copyRegion.size = chunk;
+		vkCmdCopyBuffer(getCommandBuffer(), m_buffer, dstBuffer, 1, &copyRegion);
+
+		done += chunk;
+	}
+}
+
+void StagingRing::uploadImage(VkImage image, uint32_t width, uint32_t height, uint32_t texelSize, const void* pixels)
+{
+	VkDeviceSize rowBytes = static_cast<VkDeviceSize>(width) * texelSize;
+	if (rowBytes > m_size / 2)
+	{
+		throw std::runtime_error("failed to upload image: row is larger than staging ring!");
+	}
+
+	const char* src = static_cast<const char*>(pixels);
+	uint32_t rowsPerChunk = static_cast<uint32_t>((m_size / 2) / rowBytes);
+	uint32_t row = 0;
+	while (row < height)
+	{
+		uint32_t rows = std::min(height - row, rowsPerChunk);
+		VkDeviceSize chunk = rowBytes * rows;
+		VkDeviceSize offset = acquire(chunk, kCopyAlignment);
+		memcpy(static_cast<char*>(m_allocation.mappedData) + offset, src + rowBytes * row, static_cast<size_t>(chunk));
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+		region.imageExtent = { width, rows, 1 };
+		vkCmdCopyBufferToImage(getCommandBuffer(), m_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		row += rows;
+	}
+}
+
+UploadToken StagingRing::flush()
+{
+	if (m_recording == VK_NULL_HANDLE && m_acquireRecording == VK_NULL_HANDLE)
+	{
+		return m_submittedToken;
+	}
+
+	//只有 acquire 屏障也要有一个传输命令缓冲来 signal 信号量
+	getCommandBuffer();
+	vkEndCommandBuffer(m_recording);
+
+	Segment segment{};
+	segment.end = m_head;
+	segment.fence = getFence();
+	segment.commandBuffer = m_recording;
+	segment.acquireCommandBuffer = m_acquireRecording;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &m_recording;
+
+	if (m_acquireRecording == VK_NULL_HANDLE)
+	{
+		if (vkQueueSubmit(m_device.getTransferQueue(), 1, &submitInfo, segment.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit staging copy!");
+		}
+	}
+	else
+	{
+		//传输队列 signal，图形队列 wait 之后再执行 acquire；fence 挂在后一次提交上，signal 时两边都完成了
+		vkEndCommandBuffer(m_acquireRecording);
+		segment.semaphore = getSemaphore();
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &segment.semaphore;
+		if (vkQueueSubmit(m_device.getTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit staging copy!");
+		}
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo acquireInfo{};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &segment.semaphore;
+		acquireInfo.pWaitDstStageMask = &waitStage;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &m_acquireRecording;
+		if (vkQueueSubmit(m_device.getGraphicsQueue(), 1, &acquireInfo, segment.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit queue ownership acquire!");
+		}
+	}
+
+	m_submittedToken++;
+	segment.token = m_submittedToken;
+	m_inFlight.push_back(segment);
+	m_recording = VK_NULL_HANDLE;
+	m_acquireRecording = VK_NULL_HANDLE;
+	m_hasPending = false;
+	return m_submittedToken;
+}
+
+bool StagingRing::isComplete(UploadToken token)
+{
+	reclaim();
+	return token <= m_completedToken;
+}
+
+void StagingRing::wait(UploadToken token)
+{
+	if (token > m_submittedToken)
+	{
+		flush();
+	}
+	while (token > m_completedToken && !m_inFlight.empty())
+	{
+		retireOldest();
+	}
+}
+
+void StagingRing::wait()
+{
+	flush();
+	while (!m_inFlight.empty())
+	{
+		retireOldest();
+	}
+}
+
+void StagingRing::reclaim()
+{
+	while (!m_inFlight.empty() && vkGetFenceStatus(m_device.getLogicalDevice(), m_inFlight.front().fence) == VK_SUCCESS)
+	{
+		retireOldest();
+	}
+}
+
+VkDeviceSize StagingRing::getInFlightBytes() const
+{
+	if (m_inFlight.empty() && !m_hasPending)
+	{
+		return 0;
+	}
+	return m_head > m_tail ? m_head - m_tail : m_size - m_tail + m_head;
+}
+
+VkDeviceSize StagingRing::acquire(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = 0;
+	while (!tryAcquire(size, alignment, offset))
+	{
+		//空间不够：先把手上录制的提交掉，再等最老的一段完成
+		flush();
+		if (m_inFlight.empty())
+		{
+			throw std::runtime_error("failed to acquire staging memory: request larger than ring!");
+		}
+		retireOldest();
+	}
+	return offset;
+}
+
+bool StagingRing::tryAcquire(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	bool empty = m_inFlight.empty() && !m_hasPending;
+	if (empty)
+	{
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	VkDeviceSize start = alignUp(m_head, alignment);
+	if (m_head > m_tail || empty)
+	{
+		//空闲区间是 [head, size) 和 [0, tail)
+		if (start + size <= m_size)
+		{
+			offset = start;
+		}
+		else if (size <= m_tail)
+		{
+			offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (m_head < m_tail && start + size <= m_tail)
+	{
+		offset = start;
+	}
+	else
+	{
+		return false;
+	}
+
+	m_head = offset + size;
+	m_hasPending = true;
+	return true;
+}
+
+VkCommandBuffer StagingRing::getCommandBuffer()
+{
+	if (m_recording == VK_NULL_HANDLE)
+	{
+		m_recording = beginCommandBuffer(m_device.getTransferCommandPool());
+	}
+	return m_recording;
+}
+
+VkCommandBuffer StagingRing::getAcquireCommandBuffer()
+{
+	if (m_acquireRecording == VK_NULL_HANDLE)
+	{
+		m_acquireRecording = beginCommandBuffer(m_device.getCommandPool());
+	}
+	return m_acquireRecording;
+}
+
+VkCommandBuffer StagingRing::beginCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	vkAllocateCommandBuffers(m_device.getLogicalDevice(), &allocInfo, &commandBuffer);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	return commandBuffer;
+}
+
+VkFence StagingRing::getFence()
+{
+	if (!m_freeFences.empty())
+	{
+		VkFence fence = m_freeFences.back();
+		m_freeFences.pop_back();
+		return fence;
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	if (vkCreateFence(m_device.getLogicalDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create staging fence!");
+	}
+	return fence;
+}
+
+VkSemaphore StagingRing::getSemaphore()
+{
+	if (!m_freeSemaphores.empty())
+	{
+		VkSemaphore semaphore = m_freeSemaphores.back();
+		m_freeSemaphores.pop_back();
+		return semaphore;
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VkSemaphore semaphore;
+	if (vkCreateSemaphore(m_device.getLogicalDevice(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create staging semaphore!");
+	}
+	return semaphore;
+}
+
+void StagingRing::retireOldest()
+{
+	Segment segment = m_inFlight.front();
+	m_inFlight.pop_front();
+
+	vkWaitForFences(m_device.getLogicalDevice(), 1, &segment.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	vkResetFences(m_device.getLogicalDevice(), 1, &segment.fence);
+	m_freeFences.push_back(segment.fence);
+	vkFreeCommandBuffers(m_device.getLogicalDevice(), m_device.getTransferCommandPool(), 1, &segment.commandBuffer);
+	if (segment.acquireCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(m_device.getLogicalDevice(), m_device.getCommandPool(), 1, &segment.acquireCommandBuffer);
+		m_freeSemaphores.push_back(segment.semaphore);
+	}
+
+	m_tail = segment.end;
+	m_completedToken = segment.token;
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+#include "MemoryAllocator.h"
+
+class Devices;
+
+// 上传完成的凭证：每次提交递增，0 表示不需要等待
+using UploadToken = uint64_t;
+
+// 常驻映射的环形 staging buffer，所有 CPU->GPU 的上传都从这里走
+// 每次提交的一段区间挂一个 fence，fence signal 之后这段空间才会被回收
+// 拷贝提交到传输队列；有专用传输队列族时，图形队列侧的 acquire 屏障单独录在另一个命令缓冲里，用信号量串起来
+class StagingRing
+{
+public:
+	StagingRing(Devices& device, VkDeviceSize size);
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	//只负责录制拷贝命令，超过环大小一半的数据会自动切块
+	void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	//image 必须已经处于 TRANSFER_DST_OPTIMAL 布局，按行切块
+	void uploadImage(VkImage image, uint32_t width, uint32_t height, uint32_t texelSize, const void* pixels);
+
+	//当前正在录制的命令缓冲（传输队列），空间不够时 acquire 会把它提交掉，所以每次录制前都要重新获取
+	VkCommandBuffer getCommandBuffer();
+	//和当前传输命令缓冲配对的图形队列命令缓冲，用来录 acquire 屏障，flush 时等传输完成后再执行
+	VkCommandBuffer getAcquireCommandBuffer();
+
+	UploadToken flush();                   // 把已录制的命令提交到队列，返回这次提交的凭证
+	bool isComplete(UploadToken token);    // 非阻塞查询
+	void wait(UploadToken token);          // 阻塞直到 token 对应的提交完成
+	void wait();                           // 提交并等待所有在途拷贝完成
+	void reclaim();                        // 非阻塞地回收 fence 已经 signal 的区间，每帧调用一次
+
+	VkDeviceSize getSize() const { return m_size; }
+	VkDeviceSize getInFlightBytes() const;
+
+private:
+	struct Segment
+	{
+		VkDeviceSize end;
+		VkFence fence;
+		VkCommandBuffer commandBuffer;
+		VkCommandBuffer acquireCommandBuffer;
+		VkSemaphore semaphore;
+		UploadToken token;
+	};
+
+	Devices& m_device;
+	VkDeviceSize m_size;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	Allocation m_allocation;
+
+	VkDeviceSize m_head = 0;   // 下一次写入的位置
+	VkDeviceSize m_tail = 0;   // 最老的在途区间的起点
+	bool m_hasPending = false; // 是否有已写入但还没提交的数据
+	UploadToken m_submittedToken = 0;
+	UploadToken m_completedToken = 0;
+
+	VkCommandBuffer m_recording = VK_NULL_HANDLE;
+	VkCommandBuffer m_acquireRecording = VK_NULL_HANDLE;
+	std::deque<Segment> m_inFlight;
+	std::vector<VkFence> m_freeFences;
+	std::vector<VkSemaphore> m_freeSemaphores;
+
+	VkDeviceSize acquire(VkDeviceSize size, VkDeviceSize alignment);
+	bool tryAcquire(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+	void retireOldest();
+	VkCommandBuffer beginCommandBuffer(VkCommandPool commandPool);
+	VkFence getFence();
+	VkSemaphore getSemaphore();
+};
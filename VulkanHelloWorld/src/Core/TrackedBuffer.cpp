@@ -0,0 +1,87 @@
+﻿#include "TrackedBuffer.h"
+#include "Devices.h"
+#include "FrameArena.h"
+#include "../Buffer.h"
+#include <cstring>
+#include <stdexcept>
+
+TrackedBuffer::TrackedBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, int maxFrame, MemoryUsage memoryUsage)
+	:m_device(device), m_size(size), m_shadow(static_cast<size_t>(size), 0)
+{
+	Buffer::createBuffer(m_device, m_size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		m_buffer, m_allocation, memoryUsage);
+	//每帧一段 staging：写入时这一帧的 fence 已经等过，不会覆盖 GPU 还在读的数据
+	Buffer::createBuffer(m_device, m_size * maxFrame, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_staging, m_stagingAllocation, MemoryUsage::Staging);
+
+	//影子数据初始为 0，第一帧把整块同步上去
+	markDirty(0, m_size);
+}
+
+TrackedBuffer::~TrackedBuffer()
+{
+	Devices& device = m_device;
+	VkBuffer buffer = m_buffer;
+	Allocation allocation = m_allocation;
+	VkBuffer staging = m_staging;
+	Allocation stagingAllocation = m_stagingAllocation;
+	m_device.getDeletionQueue().push([&device, buffer, allocation, staging, stagingAllocation]() mutable {
+		Buffer::destroyBuffer(device, staging, stagingAllocation);
+		Buffer::destroyBuffer(device, buffer, allocation);
+	});
+}
+
+void TrackedBuffer::write(VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+	memcpy(map(offset, size), data, static_cast<size_t>(size));
+}
+
+void* TrackedBuffer::map(VkDeviceSize offset, VkDeviceSize size)
+{
+	if (offset + size > m_size)
+	{
+		throw std::runtime_error("failed to write tracked buffer: range out of bounds!");
+	}
+	markDirty(offset, size);
+	return m_shadow.data() + offset;
+}
+
+VkDeviceSize TrackedBuffer::recordCopies(VkCommandBuffer cmd, uint32_t frameIndex, FrameArena& arena, TrackedUploadStats& stats)
+{
+	stats.bufferCount++;
+	stats.frameWrites += m_writeCount;
+	m_writeCount = 0;
+	if (m_dirty.empty())
+	{
+		return 0;
+	}
+
+	//合并后的区域数不会超过脏区间数，按上限从帧分配器取，vkCmdCopyBuffer 录制时就拷走了
+	VkBufferCopy* regions = arena.allocate<VkBufferCopy>(m_dirty.size());
+	uint32_t regionCount = m_dirty.coalesce(m_size * frameIndex, regions);
+
+	VkDeviceSize bytes = 0;
+	char* staging = static_cast<char*>(m_stagingAllocation.mappedData);
+	for (uint32_t i = 0; i < regionCount; i++)
+	{
+		const VkBufferCopy& region = regions[i];
+		memcpy(staging + region.srcOffset, m_shadow.data() + region.dstOffset, static_cast<size_t>(region.size));
+		bytes += region.size;
+	}
+	vkCmdCopyBuffer(cmd, m_staging, m_buffer, regionCount, regions);
+
+	stats.frameBytes += bytes;
+	stats.frameRegions += regionCount;
+	return bytes;
+}
+
+void TrackedBuffer::markDirty(VkDeviceSize offset, VkDeviceSize size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	m_writeCount++;
+	m_dirty.add(offset, size);
+}
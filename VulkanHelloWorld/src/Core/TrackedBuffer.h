@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "DirtyRanges.h"
+
+class Devices;
+class FrameArena;
+
+struct TrackedUploadStats
+{
+	VkDeviceSize frameBytes = 0;   // 本帧实际拷贝的字节数（包含合并进来的空隙）
+	uint32_t frameWrites = 0;      // 本帧 write 调用次数
+	uint32_t frameRegions = 0;     // 合并后的 VkBufferCopy 个数
+	uint32_t bufferCount = 0;
+	VkDeviceSize totalBytes = 0;
+};
+
+// 常驻显存的 buffer：CPU 侧保留一份影子数据，write 只更新影子并记录脏区间
+// 每帧录制命令之前由 Renderer 调用 recordCopies，把脏区间排序合并成尽量少的拷贝区域，
+// 经本帧自己的 staging 段拷进显存，只为改动的部分付出带宽
+// 拷贝和绘制录在同一个图形命令缓冲里，前后的屏障由 Renderer 统一录制
+class TrackedBuffer
+{
+public:
+	TrackedBuffer(Devices& device, VkDeviceSize size, VkBufferUsageFlags usage, int maxFrame, MemoryUsage memoryUsage = MemoryUsage::Other);
+	~TrackedBuffer();
+
+	TrackedBuffer(const TrackedBuffer&) = delete;
+	TrackedBuffer& operator=(const TrackedBuffer&) = delete;
+
+	void write(VkDeviceSize offset, const void* data, VkDeviceSize size);
+	template<typename T>
+	void write(VkDeviceSize offset, const T& data) { write(offset, &data, sizeof(T)); }
+	//直接改影子数据时用，调用方自己保证只写 [offset, offset + size)
+	void* map(VkDeviceSize offset, VkDeviceSize size);
+
+	bool isDirty() const { return !m_dirty.empty(); }
+	//本帧的 fence 已经等过；拷贝区域从帧分配器里取，返回录制的字节数
+	VkDeviceSize recordCopies(VkCommandBuffer cmd, uint32_t frameIndex, FrameArena& arena, TrackedUploadStats& stats);
+
+	VkBuffer getHandle() const { return m_buffer; }
+	VkDeviceSize getSize() const { return m_size; }
+
+private:
+	Devices& m_device;
+	VkDeviceSize m_size;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	Allocation m_allocation;
+	VkBuffer m_staging = VK_NULL_HANDLE;   // 每帧一段，和显存 buffer 同样大小，偏移一一对应
+	Allocation m_stagingAllocation;
+
+	std::vector<char> m_shadow;
+	DirtyRanges m_dirty;
+	uint32_t m_writeCount = 0;
+
+	void markDirty(VkDeviceSize offset, VkDeviceSize size);
+};
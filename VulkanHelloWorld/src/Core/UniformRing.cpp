@@ -0,0 +1,52 @@
+﻿#include "UniformRing.h"
+#include "Devices.h"
+#include "../Buffer.h"
+#include <stdexcept>
+#include <cstring>
+
+UniformRing::UniformRing(Devices& device, VkDeviceSize frameSize, int maxFrame)
+	:m_device(device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_device.getPhysicalDevice(), &properties);
+	m_alignment = properties.limits.minUniformBufferOffsetAlignment;
+
+	//每帧的起点也要对齐，否则动态偏移算出来不对齐
+	m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+	//能放进可映射的显存就直接写显存，GPU 读 uniform 时不用再走 PCIe
+	if (!Buffer::createDirectWriteBuffer(m_device, m_frameSize * maxFrame, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, m_buffer, m_allocation, MemoryUsage::Uniform, false))
+	{
+		Buffer::createBuffer(m_device, m_frameSize * maxFrame, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_buffer, m_allocation, MemoryUsage::Uniform);
+	}
+}
+
+UniformRing::~UniformRing()
+{
+	Buffer::destroyBuffer(m_device, m_buffer, m_allocation);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+	m_frameBegin = m_frameSize * frameIndex;
+	m_head = m_frameBegin;
+	++m_frameSerial;
+}
+
+uint32_t UniformRing::push(const void* data, VkDeviceSize size)
+{
+	VkDeviceSize offset = m_head;
+	if (offset + size > m_frameBegin + m_frameSize)
+	{
+		throw std::runtime_error("uniform ring out of space for this frame!");
+	}
+
+	if (data)
+	{
+		memcpy(static_cast<char*>(m_allocation.mappedData) + offset, data, static_cast<size_t>(size));
+	}
+	m_head = (offset + size + m_alignment - 1) / m_alignment * m_alignment;
+	return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "MemoryAllocator.h"
+
+class Devices;
+
+// 每帧一段的瞬时 uniform 环：所有帧共用一个常驻映射的大 buffer，按帧切成几段
+// 每次 push 返回一个满足 minUniformBufferOffsetAlignment 的偏移，作为 UNIFORM_BUFFER_DYNAMIC 的动态偏移使用
+// 每帧的数据写一次用一次，不需要为新的数据创建 buffer 或 descriptor set
+class UniformRing
+{
+public:
+	UniformRing(Devices& device, VkDeviceSize frameSize, int maxFrame);
+	~UniformRing();
+
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	//该帧的 fence 已经等过之后调用，回收这一帧上一轮的全部数据
+	void beginFrame(uint32_t frameIndex);
+
+	//返回动态偏移；data 为空时只分配不拷贝，可以通过 getMappedData 自己写
+	uint32_t push(const void* data, VkDeviceSize size);
+	template<typename T>
+	uint32_t push(const T& data) { return push(&data, sizeof(T)); }
+
+	void* getMappedData(uint32_t offset) const { return static_cast<char*>(m_allocation.mappedData) + offset; }
+	VkBuffer getHandle() const { return m_buffer; }
+	VkDeviceSize getFrameSize() const { return m_frameSize; }
+	VkDeviceSize getUsedBytes() const { return m_head - m_frameBegin; }
+	//每次 beginFrame 加一，用来判断一个偏移是不是这一帧 push 出来的
+	uint64_t getFrameSerial() const { return m_frameSerial; }
+
+private:
+	Devices& m_device;
+	VkDeviceSize m_frameSize;
+	VkDeviceSize m_alignment;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	Allocation m_allocation;
+
+	VkDeviceSize m_frameBegin = 0;
+	VkDeviceSize m_head = 0;
+	uint64_t m_frameSerial = 0;
+};
@@ -0,0 +1,119 @@
+﻿#include "UploadBatch.h"
+#include "Devices.h"
+#include "QueueOwnership.h"
+#include <stdexcept>
+
+namespace
+{
+	constexpr VkAccessFlags kBufferReadAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	constexpr VkPipelineStageFlags kBufferReadStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	//同一队列族内的布局转换，不涉及所有权
+	void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+UploadBatch::UploadBatch(Devices& device) : m_device(device)
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+	//忘记 submit 的话也要把录好的命令提交出去，否则它们会混进下一批
+	if (!m_submitted)
+	{
+		submit();
+	}
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	m_device.getStagingRing().uploadBuffer(dstBuffer, dstOffset, data, size);
+	m_buffers.push_back({ dstBuffer, dstOffset, size });
+}
+
+void UploadBatch::uploadImage(VkImage image, uint32_t width, uint32_t height, uint32_t texelSize, const void* pixels)
+{
+	//UNDEFINED -> TRANSFER_DST，传输队列也支持这两个阶段
+	transitionImageLayout(m_device.getStagingRing().getCommandBuffer(), image,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	m_device.getStagingRing().uploadImage(image, width, height, texelSize, pixels);
+	m_images.push_back(image);
+}
+
+UploadToken UploadBatch::submit()
+{
+	m_submitted = true;
+	StagingRing& ring = m_device.getStagingRing();
+
+	if (!m_device.hasDedicatedTransferQueue())
+	{
+		//同一个队列族：一个内存屏障让拷贝写入对之后的顶点/索引/着色器读取可见
+		VkCommandBuffer commandBuffer = ring.getCommandBuffer();
+		if (!m_buffers.empty())
+		{
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = kBufferReadAccess;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, kBufferReadStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		for (VkImage image : m_images)
+		{
+			transitionImageLayout(commandBuffer, image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
+	else
+	{
+		//不同队列族：传输队列 release，图形队列 acquire，image 的布局转换也在这一对屏障里完成
+		uint32_t transferFamily = m_device.getQueueFamilies().transferFamily.value();
+		uint32_t graphicsFamily = m_device.getQueueFamilies().graphicsFamily.value();
+		for (const BufferRange& range : m_buffers)
+		{
+			QueueOwnership::releaseBuffer(ring.getCommandBuffer(), range.buffer, transferFamily, graphicsFamily,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, range.offset, range.size);
+			QueueOwnership::acquireBuffer(ring.getAcquireCommandBuffer(), range.buffer, transferFamily, graphicsFamily,
+				kBufferReadStages, kBufferReadAccess, range.offset, range.size);
+		}
+
+		for (VkImage image : m_images)
+		{
+			QueueOwnership::releaseImage(ring.getCommandBuffer(), image, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				transferFamily, graphicsFamily,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+			QueueOwnership::acquireImage(ring.getAcquireCommandBuffer(), image, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				transferFamily, graphicsFamily,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
+
+	m_buffers.clear();
+	m_images.clear();
+	return ring.flush();
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "StagingRing.h"
+
+class Devices;
+
+// 一批上传：拷贝和布局转换都录进 staging 环的同一个命令缓冲，submit 时只提交一次，不等待
+// submit 会在末尾补上屏障（有专用传输队列时是 release/acquire 一对），之后图形队列上的绘制可以直接使用这些资源
+class UploadBatch
+{
+public:
+	explicit UploadBatch(Devices& device);
+	~UploadBatch();
+
+	UploadBatch(const UploadBatch&) = delete;
+	UploadBatch& operator=(const UploadBatch&) = delete;
+
+	void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	//包含 UNDEFINED -> TRANSFER_DST -> SHADER_READ_ONLY 两次布局转换
+	void uploadImage(VkImage image, uint32_t width, uint32_t height, uint32_t texelSize, const void* pixels);
+
+	UploadToken submit();
+
+private:
+	Devices& m_device;
+	struct BufferRange
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	std::vector<BufferRange> m_buffers; // 本批写过的 buffer 区间，submit 时统一做屏障/所有权转移
+	std::vector<VkImage> m_images;     // 本批写过的 image，当前处于 TRANSFER_DST_OPTIMAL
+	bool m_submitted = false;
+};
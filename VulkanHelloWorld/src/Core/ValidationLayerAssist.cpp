@@ -1,8 +1,8 @@
 #include "ValidationLayerAssist.h"
 
-//ΪvkCreateDebugUtilsMessengerEXTһչVulkan 1.0ĵһ֣Բֱӵ
-//ʱ̬شм
-//ĲvkCreateDebugUtilsMessengerEXTȫһֻǶһȡָĹ̡
+//因为vkCreateDebugUtilsMessengerEXT是一个扩展函数，它不是Vulkan 1.0核心的一部分，所以不能直接调用它。
+//必须在运行时动态地从驱动程序中加载这个函数。
+//所以这个函数的参数和vkCreateDebugUtilsMessengerEXT完全一样，只是多了一步获取函数指针的过程。
 VkResult ValidationLayerAssist::CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback)
 {
 
@@ -88,7 +88,7 @@ std::vector<const char*> ValidationLayerAssist::getRequiredExtensions()
 	const char** glfwExtensions;
 	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	//һԵԭʼָ룬Cconst char**תstd::vector<const char*>
+	//接受一对迭代器，在这里是原始指针，把C风格数组const char**转换成std::vector<const char*>
 	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 	if (enableValidationLayers)
 	{
@@ -7,7 +7,7 @@
 #include <cstdlib>
 #include <vector>
 
-//У㣬ֻҪDEBUGģʽͽУ
+//校验层，只要不是DEBUG模式就禁用校验层
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
 #else
@@ -4,14 +4,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-//ƶö
+//定义移动方向枚举
 enum CameraMovement { FORWARD, BACKWARD, LEFT, RIGHT };
 
 const float YAW = 225.0f;
-const float PITCH = -30.0f; // ʼǣ΢΢¿
-const float SPEED = 2.5f;   // ƶٶ
-const float SENSITIVITY = 0.1f;   // 
-const float ZOOM = 45.0f;  // Ұ (FOV)
+const float PITCH = -30.0f; // 初始俯仰角，微微向下看
+const float SPEED = 2.5f;   // 移动速度
+const float SENSITIVITY = 0.1f;   // 鼠标灵敏度
+const float ZOOM = 45.0f;  // 视野 (FOV)
 
 class Camera
 {
@@ -24,16 +24,16 @@ public:
 
 	bool active = true;
 
-	// ŷ
+	// 欧拉角
 	float Yaw;
 	float Pitch;
 
-	// ѡ
+	// 选项
 	float MovementSpeed;
 	float MouseSensitivity;
 	float Zoom;
 
-	// 캯Ĭϰ (2, 2, 2) Ҳ֮ǰľݵλãZᳯ
+	// 构造函数：默认把相机放在坐标 (2, 2, 2) 也就是你之前看木屋的位置，Z轴朝上
 	Camera(glm::vec3 position = glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f), float yaw = YAW, float pitch = PITCH)
 		: Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM) {
 		Position = position;
@@ -43,12 +43,12 @@ public:
 		updateCameraVectors();
 	}
 
-	// ȡ View  
+	// 获取 View 矩阵 
 	glm::mat4 getViewMatrix() const {
 		return glm::lookAt(Position, Position + Front, Up);
 	}
 
-	// ȡ Projection  
+	// 获取 Projection 矩阵 
 	glm::mat4 getProjectionMatrix(float aspect) const {
 		glm::mat4 proj = glm::perspective(glm::radians(Zoom), aspect, 0.1f, 100.0f);
 		proj[1][1] *= -1;
@@ -64,7 +64,7 @@ public:
 		if(move == RIGHT) Position += Right * vel;
 	}
 
-	// ƶ
+	// 处理鼠标移动
 	void processMouseMovement(float xoffset, float yoffset, bool constrainPitch = true) {
 		if (active)
 		{
@@ -74,7 +74,7 @@ public:
 			Yaw += xoffset;
 			Pitch += yoffset;
 
-			// ֹӽǷת
+			// 防止视角发生“翻转”的死锁
 			if (constrainPitch) {
 				if (Pitch > 89.0f)  Pitch = 89.0f;
 				if (Pitch < -89.0f) Pitch = -89.0f;
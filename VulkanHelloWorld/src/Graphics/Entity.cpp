@@ -1,7 +1,14 @@
-#include "Entity.h"
+﻿#include "Entity.h"
+#include <algorithm>
 
-Entity::Entity(std::shared_ptr<Model> model, std::shared_ptr<Material> material)
-	: m_model(model), m_material(material)
+namespace
+{
+	//往粗的 LOD 切时，像素误差要低于阈值的 (1 - kLodHysteresis)
+	constexpr float kLodHysteresis = 0.25f;
+}
+
+Entity::Entity(std::shared_ptr<Model> model, std::shared_ptr<Material> material, uint32_t submesh)
+	: m_model(model), m_material(material), m_submesh(submesh)
 {
 	m_modelMatrix = glm::mat4(1.0f);
 	m_position = glm::vec3(0.0f);
@@ -28,20 +35,114 @@ glm::mat4 Entity::getModelMatrix()
 	return m_modelMatrix;
 }
 
-void Entity::drawMain(VkCommandBuffer cmd, uint32_t currentFrame)
+void Entity::getBoundingSphere(glm::vec3& center, float& radius)
+{
+	glm::mat4 modelMatrix = getModelMatrix();
+	const MeshBounds& bounds = m_model->getBounds();
+	float scale = std::max(std::max(std::abs(m_scale.x), std::abs(m_scale.y)), std::abs(m_scale.z));
+	center = glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	radius = glm::length(bounds.max - bounds.min) * 0.5f * scale;
+}
+
+uint32_t Entity::selectLod(const DrawView& view, uint32_t current)
+{
+	const std::vector<MeshLod>& lods = m_model->getLods();
+	uint32_t lodCount = static_cast<uint32_t>(lods.size());
+	if (lodCount <= 1)
+	{
+		return 0;
+	}
+
+	//包围球放到世界空间，距离从球面算起，相机在球里面时用最精细的一级
+	glm::vec3 center;
+	float radius;
+	getBoundingSphere(center, radius);
+	float scale = std::max(std::max(std::abs(m_scale.x), std::abs(m_scale.y)), std::abs(m_scale.z));
+	float distance = glm::length(center - view.position) - radius;
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+
+	float pixelsPerUnit = scale * view.bias * view.pixelScale / distance;
+	auto pixelError = [&](uint32_t lod) { return lods[lod].error * pixelsPerUnit; };
+
+	uint32_t target = 0;
+	for (uint32_t lod = lodCount - 1; lod > 0; lod--)
+	{
+		if (pixelError(lod) <= view.maxPixelError)
+		{
+			target = lod;
+			break;
+		}
+	}
+	current = std::min(current, lodCount - 1);
+	while (target > current && pixelError(target) > view.maxPixelError * (1.0f - kLodHysteresis))
+	{
+		target--;
+	}
+	return target;
+}
+
+void Entity::drawMain(VkCommandBuffer cmd, uint32_t currentFrame, uint32_t globalUboOffset, const DrawView& view, DrawStats& stats)
 {
-	glm::mat4 modelMat = getModelMatrix();
-	m_material->bind(cmd, currentFrame);
+	//整个实体在视锥外就跳过；合批后的实体就是一个格子，剔除的粒度也就是格子
+	//阴影 pass 不做这一步，视锥外的物体也可能把影子投进来
+	glm::vec3 center;
+	float radius;
+	getBoundingSphere(center, radius);
+	if (!view.frustum.intersectsSphere(center, radius))
+	{
+		stats.culledEntities++;
+		return;
+	}
+	stats.entities++;
+
+	//渐进加载时细的几级还没传完，先用已经到位的最细一级
+	m_lod = std::max(selectLod(view, m_lod), m_model->getAvailableLod());
+	//顶点里存的是量化后的位置，反量化矩阵合进推送的模型矩阵，着色器不用改
+	glm::mat4 modelMat = getModelMatrix() * m_model->getDequantMatrix();
+	m_material->bind(cmd, currentFrame, globalUboOffset);
 	VkPipelineLayout pipelineLayout = m_material->getPipeline()->getPipelineLayout().getHandle();
 	vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &modelMat);
-	m_model->bind(cmd);
-	m_model->draw(cmd);
+
+	if (m_submesh != kWholeModel)
+	{
+		m_model->drawSubmesh(cmd, m_submesh);
+		stats.triangles += m_model->getSubmeshes()[m_submesh].indexCount / 3;
+		return;
+	}
+
+	const std::vector<Meshlet>& meshlets = m_model->getMeshlets();
+	if (m_lod != 0 || !view.cullMeshlets || meshlets.empty())
+	{
+		m_model->draw(cmd, m_lod);
+		stats.triangles += m_model->getLods()[m_lod].indexCount / 3;
+		return;
+	}
+
+	//簇的包围球和法线锥都在模型空间，把视锥和相机变换过去再测
+	glm::mat4 modelMatrix = getModelMatrix();
+	Frustum frustum = view.frustum.transformed(modelMatrix);
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(view.position, 1.0f));
+	bool cullBackfaces = (m_material->getPipeline()->getCullMode() & VK_CULL_MODE_BACK_BIT) != 0;
+	stats.visibleMeshlets += MeshletBuilder::cull(meshlets, frustum, cameraPosition, cullBackfaces, m_visibleMeshlets);
+	stats.totalMeshlets += static_cast<uint32_t>(meshlets.size());
+	stats.triangles += m_model->drawMeshlets(cmd, m_visibleMeshlets);
 }
 
-void Entity::drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout)
+void Entity::drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout, const DrawView& view, DrawStats& stats)
 {
-	glm::mat4 modelMat = getModelMatrix();
+	stats.entities++;
+	m_shadowLod = std::max(selectLod(view, m_shadowLod), m_model->getAvailableLod());
+	glm::mat4 modelMat = getModelMatrix() * m_model->getDequantMatrix();
 	vkCmdPushConstants(cmd, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &modelMat);
-	m_model->bind(cmd);
-	m_model->draw(cmd);
+	if (m_submesh != kWholeModel)
+	{
+		m_model->drawSubmesh(cmd, m_submesh);
+		stats.triangles += m_model->getSubmeshes()[m_submesh].indexCount / 3;
+		return;
+	}
+	m_model->draw(cmd, m_shadowLod);
+	stats.triangles += m_model->getLods()[m_shadowLod].indexCount / 3;
 }
@@ -1,26 +1,63 @@
-#pragma once
+﻿#pragma once
 #include <memory>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Model.h"
 #include "Material.h"
+#include "Frustum.h"
+
+// 选 LOD 和剔除用的视图参数，每个 pass 填一次
+struct DrawView
+{
+	glm::vec3 position = glm::vec3(0.0f); // 视点
+	float pixelScale = 1.0f;              // 视口高度 / (2 * tan(fov / 2))：距离为 1 处一个单位长度占多少像素
+	float maxPixelError = 1.0f;           // 允许的屏幕空间误差（像素）
+	float bias = 1.0f;                    // 误差先乘上它再比较，阴影 pass 用更大的值选更粗的 LOD
+	Frustum frustum{};                    // 世界空间的视锥
+	bool cullMeshlets = false;            // 画第 0 级时按簇做视锥剔除（管线剔除背面时再加法线锥剔除）
+};
+
+// 一个 pass 实际提交的量
+struct DrawStats
+{
+	uint32_t triangles = 0;
+	uint32_t entities = 0;       // 实际画了的实体（每个一次推送常量和至少一次 draw）
+	uint32_t culledEntities = 0; // 整个包围球在视锥外、没有画的实体
+	uint32_t visibleMeshlets = 0;
+	uint32_t totalMeshlets = 0;
+};
 
 class Entity
 {
 public:
-	Entity(std::shared_ptr<Model> model, std::shared_ptr<Material> material);
+	//默认画整个模型；给了 submesh 时只画模型的这个子网格（GLB 的一个图元），不选 LOD、不做簇剔除
+	static constexpr uint32_t kWholeModel = UINT32_MAX;
+
+	Entity(std::shared_ptr<Model> model, std::shared_ptr<Material> material, uint32_t submesh = kWholeModel);
 	~Entity();
 
 	void setPosition(glm::vec3 position) { m_position = position; m_modified = true; }
 	void setRotation(glm::vec3 rotation) { m_rotation = rotation; m_modified = true;}
 	void setScale(glm::vec3 scale) { m_scale = scale; m_modified = true;}
+	//静态实体摆好之后不再移动，Scene::buildStaticBatches 会把它们按材质和格子合并掉
+	void setStatic(bool isStatic) { m_static = isStatic; }
+	bool isStatic() const { return m_static; }
 
 	glm::mat4 getModelMatrix();
-	void drawMain(VkCommandBuffer cmd, uint32_t currentFrame);
-	void drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout);
+	const std::shared_ptr<Model>& getModel() const { return m_model; }
+	const std::shared_ptr<Material>& getMaterial() const { return m_material; }
+	uint32_t getSubmesh() const { return m_submesh; }
+	//模型包围盒的外接球放到世界空间
+	void getBoundingSphere(glm::vec3& center, float& radius);
+	void drawMain(VkCommandBuffer cmd, uint32_t currentFrame, uint32_t globalUboOffset, const DrawView& view, DrawStats& stats);
+	void drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout, const DrawView& view, DrawStats& stats);
+	//最近一次主 pass / 阴影 pass 选中的 LOD
+	uint32_t getLod() const { return m_lod; }
+	uint32_t getShadowLod() const { return m_shadowLod; }
 private:
 	std::shared_ptr<Model> m_model;
 	std::shared_ptr<Material> m_material;
+	uint32_t m_submesh;
 
 	glm::vec3 m_position;
 	glm::vec3 m_rotation;
@@ -28,4 +65,13 @@ private:
 
 	glm::mat4 m_modelMatrix;
 	bool m_modified = true;
+	bool m_static = false;
+
+	//两个 pass 各自记住上一帧的 LOD，做迟滞用
+	uint32_t m_lod = 0;
+	uint32_t m_shadowLod = 0;
+	std::vector<uint32_t> m_visibleMeshlets; // 每帧复用，避免在帧循环里分配
+
+	//按 LOD 的几何误差投影到屏幕上的像素数来选；变粗需要误差低于阈值一定比例，避免在阈值附近来回切
+	uint32_t selectLod(const DrawView& view, uint32_t current);
 };
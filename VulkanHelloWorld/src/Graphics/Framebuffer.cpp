@@ -1,7 +1,7 @@
-#include "Framebuffer.h"
+﻿#include "Framebuffer.h"
 #include <stdexcept>
 
-Framebuffer::Framebuffer(VkDevice device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments)
+Framebuffer::Framebuffer(Devices& device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments)
 	: m_device(device)
 {
 	VkFramebufferCreateInfo framebufferInfo{};
@@ -13,14 +13,17 @@ Framebuffer::Framebuffer(VkDevice device, VkRenderPass renderPass, VkExtent2D ex
 	framebufferInfo.height = extent.height;
 	framebufferInfo.layers = 1;
 
-	if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_handle) != VK_SUCCESS) {
+	if (vkCreateFramebuffer(m_device.getLogicalDevice(), &framebufferInfo, nullptr, &m_handle) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create framebuffer!");
 	}
 }
 
 Framebuffer::~Framebuffer()
 {
+	//交换链重建时旧的帧缓冲可能还被在途的帧引用，等这些帧结束再销毁
 	if (m_handle != VK_NULL_HANDLE) {
-		vkDestroyFramebuffer(m_device, m_handle, nullptr);
+		VkDevice device = m_device.getLogicalDevice();
+		VkFramebuffer handle = m_handle;
+		m_device.getDeletionQueue().push([device, handle]() { vkDestroyFramebuffer(device, handle, nullptr); });
 	}
 }
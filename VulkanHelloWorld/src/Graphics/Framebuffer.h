@@ -1,11 +1,12 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include "../Core/Devices.h"
 
 class Framebuffer
 {
 public:
-	Framebuffer(VkDevice device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments);
+	Framebuffer(Devices& device, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkImageView>& attachments);
 	~Framebuffer();
 
 	Framebuffer(const Framebuffer&) = delete;
@@ -14,6 +15,6 @@ public:
 	VkFramebuffer getHandle() const { return m_handle; }
 
 private:
-	VkDevice m_device;
+	Devices& m_device;
 	VkFramebuffer m_handle = VK_NULL_HANDLE;
 };
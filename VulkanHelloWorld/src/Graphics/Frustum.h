@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+
+// 视锥的 6 个平面，法线朝内：dot(normal, p) + w >= 0 在里面
+// 投影用的是 [0,1] 的深度（GLM_FORCE_DEPTH_ZERO_TO_ONE），Y 翻转不影响平面
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	static Frustum fromMatrix(const glm::mat4& viewProj)
+	{
+		glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+		glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+		glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+		glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0; // 左
+		frustum.planes[1] = row3 - row0; // 右
+		frustum.planes[2] = row3 + row1; // 下
+		frustum.planes[3] = row3 - row1; // 上
+		frustum.planes[4] = row2;        // 近
+		frustum.planes[5] = row3 - row2; // 远
+		frustum.normalize();
+		return frustum;
+	}
+
+	//变换到模型空间：平面按 Mᵀ 变换，在模型空间里测试和在世界空间里测试结果一样，非均匀缩放也成立
+	Frustum transformed(const glm::mat4& model) const
+	{
+		Frustum frustum;
+		glm::mat4 transposed = glm::transpose(model);
+		for (int i = 0; i < 6; i++)
+		{
+			frustum.planes[i] = transposed * planes[i];
+		}
+		frustum.normalize();
+		return frustum;
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	void normalize()
+	{
+		for (glm::vec4& plane : planes)
+		{
+			float length = glm::length(glm::vec3(plane));
+			if (length > 0.0f)
+			{
+				plane /= length;
+			}
+		}
+	}
+};
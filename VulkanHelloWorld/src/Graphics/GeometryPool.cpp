@@ -0,0 +1,319 @@
+﻿#include "GeometryPool.h"
+#include "../Buffer.h"
+#include "../Vertex.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+GeometryPool::GeometryPool(Devices& device, const VertexLayout& layout, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: m_device(device),
+	m_index(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(uint32_t), indexCapacity),
+	m_index16(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(uint16_t), indexCapacity)
+{
+	for (uint32_t binding = 0; binding < layout.getBindingCount(); binding++)
+	{
+		m_vertex.emplace_back(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, layout.getStride(binding), vertexCapacity);
+		m_vertexStride += layout.getStride(binding);
+	}
+	if (m_vertex.empty() || m_vertex.size() > kMaxVertexStreams)
+	{
+		throw std::runtime_error("failed to create geometry pool: unsupported number of vertex bindings!");
+	}
+
+	//先尝试 UMA/ReBAR 的直接写入，不支持时 createStreamBuffer 会退回 staging 上传
+	for (Stream& stream : m_vertex)
+	{
+		stream.directWrite = true;
+		createStreamBuffer(stream, vertexCapacity, stream.buffer, stream.allocation);
+	}
+	m_index.directWrite = true;
+	m_index16.directWrite = true;
+	createStreamBuffer(m_index, indexCapacity, m_index.buffer, m_index.allocation);
+	createStreamBuffer(m_index16, indexCapacity, m_index16.buffer, m_index16.allocation);
+
+	m_device.getDefragmenter().registerResource(this);
+}
+
+GeometryPool::~GeometryPool()
+{
+	m_device.getDefragmenter().unregisterResource(this);
+
+	Devices& device = m_device;
+	std::vector<std::pair<VkBuffer, Allocation>> buffers = { { m_index16.buffer, m_index16.allocation }, { m_index.buffer, m_index.allocation } };
+	for (const Stream& stream : m_vertex)
+	{
+		buffers.emplace_back(stream.buffer, stream.allocation);
+	}
+	m_device.getDeletionQueue().push([&device, buffers]() mutable {
+		for (auto& [buffer, allocation] : buffers)
+		{
+			Buffer::destroyBuffer(device, buffer, allocation);
+		}
+	});
+}
+
+GeometryRange GeometryPool::upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, UploadToken& token)
+{
+	GeometryRange range = allocate(vertexCount, indexCount);
+
+	//顶点和索引录进同一批一起提交，不等待
+	UploadBatch batch(m_device);
+	write(batch, range, vertices, indices);
+	token = batch.submit();
+	trackUpload(token);
+	return range;
+}
+
+GeometryRange GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount)
+{
+	return allocate(vertexCount, indexCount, vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+}
+
+GeometryRange GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType)
+{
+	//正在被搬的话先等拷贝完成，否则写进旧 buffer 的数据会丢
+	settleRelocation();
+
+	GeometryRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	range.indexType = indexType;
+	range.vertexOffset = static_cast<int32_t>(allocateRange(m_vertex[0], vertexCount));
+	//其它顶点流跟着第一条流扩容，容量始终相同
+	for (size_t i = 1; i < m_vertex.size(); i++)
+	{
+		if (m_vertex[i].capacity < m_vertex[0].capacity)
+		{
+			grow(m_vertex[i], m_vertex[0].capacity);
+		}
+	}
+	range.firstIndex = allocateRange(getIndexStream(range.indexType), range.indexCount);
+	return range;
+}
+
+void GeometryPool::write(UploadBatch& batch, const GeometryRange& range, const void* vertices, const uint32_t* indices)
+{
+	writeVertices(batch, range, 0, vertices, range.vertexCount);
+	writeNarrowedIndices(batch, range, 0, indices, range.indexCount);
+}
+
+void GeometryPool::writeVertices(UploadBatch& batch, const GeometryRange& range, uint32_t firstVertex, const void* vertices, uint32_t count)
+{
+	uint32_t offset = static_cast<uint32_t>(range.vertexOffset) + firstVertex;
+	if (m_vertex.size() == 1)
+	{
+		write(batch, m_vertex[0], offset, vertices, count);
+		return;
+	}
+
+	//按 binding 的顺序把每个顶点切成几段，直接写入时拆进映射的显存，否则先拆到临时内存再走 staging
+	const char* source = static_cast<const char*>(vertices);
+	uint32_t sourceOffset = 0;
+	std::vector<char> split;
+	for (Stream& stream : m_vertex)
+	{
+		char* destination = nullptr;
+		if (stream.directWrite)
+		{
+			destination = static_cast<char*>(stream.allocation.mappedData) + VkDeviceSize(offset) * stream.stride;
+		}
+		else
+		{
+			split.resize(size_t(count) * stream.stride);
+			destination = split.data();
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			memcpy(destination + size_t(i) * stream.stride, source + size_t(i) * m_vertexStride + sourceOffset, stream.stride);
+		}
+		if (!stream.directWrite)
+		{
+			batch.uploadBuffer(stream.buffer, VkDeviceSize(offset) * stream.stride, split.data(), VkDeviceSize(count) * stream.stride);
+		}
+		sourceOffset += stream.stride;
+	}
+}
+
+void GeometryPool::writeIndices(UploadBatch& batch, const GeometryRange& range, uint32_t firstIndex, const void* indices, uint32_t count)
+{
+	write(batch, getIndexStream(range.indexType), range.firstIndex + firstIndex, indices, count);
+}
+
+void GeometryPool::writeNarrowedIndices(UploadBatch& batch, const GeometryRange& range, uint32_t firstIndex, const uint32_t* indices, uint32_t count)
+{
+	if (range.indexType != VK_INDEX_TYPE_UINT16)
+	{
+		write(batch, m_index, range.firstIndex + firstIndex, indices, count);
+		return;
+	}
+	std::vector<uint16_t> narrowed(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		narrowed[i] = static_cast<uint16_t>(indices[i]);
+	}
+	write(batch, m_index16, range.firstIndex + firstIndex, narrowed.data(), count);
+}
+
+void GeometryPool::free(const GeometryRange& range)
+{
+	m_vertex[0].metadata.free(static_cast<VkDeviceSize>(range.vertexOffset));
+	getIndexStream(range.indexType).metadata.free(range.firstIndex);
+}
+
+void GeometryPool::bind(VkCommandBuffer cmd) const
+{
+	//每帧都会调用，用栈上的定长数组，不在帧循环里分配堆内存
+	std::array<VkBuffer, kMaxVertexStreams> buffers{};
+	std::array<VkDeviceSize, kMaxVertexStreams> offsets{};
+	for (size_t i = 0; i < m_vertex.size(); i++)
+	{
+		buffers[i] = m_vertex[i].buffer;
+	}
+	vkCmdBindVertexBuffers(cmd, 0, static_cast<uint32_t>(m_vertex.size()), buffers.data(), offsets.data());
+}
+
+void GeometryPool::bindPositions(VkCommandBuffer cmd) const
+{
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &m_vertex[0].buffer, &offset);
+}
+
+void GeometryPool::bindIndices(VkCommandBuffer cmd, VkIndexType indexType) const
+{
+	VkBuffer buffer = indexType == VK_INDEX_TYPE_UINT16 ? m_index16.buffer : m_index.buffer;
+	vkCmdBindIndexBuffer(cmd, buffer, 0, indexType);
+}
+
+bool GeometryPool::beginRelocation(uint32_t slot, VkCommandBuffer commandBuffer)
+{
+	if (!m_device.getStagingRing().isComplete(m_uploadToken))
+	{
+		return false;
+	}
+
+	Stream& stream = getStream(slot);
+	createStreamBuffer(stream, stream.capacity, stream.newBuffer, stream.newAllocation);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = VkDeviceSize(stream.capacity) * stream.stride;
+	vkCmdCopyBuffer(commandBuffer, stream.buffer, stream.newBuffer, 1, &copyRegion);
+	return true;
+}
+
+RelocatedResource GeometryPool::endRelocation(uint32_t slot)
+{
+	Stream& stream = getStream(slot);
+
+	RelocatedResource old;
+	old.buffer = stream.buffer;
+	old.allocation = stream.allocation;
+
+	stream.buffer = stream.newBuffer;
+	stream.allocation = stream.newAllocation;
+	stream.newBuffer = VK_NULL_HANDLE;
+	stream.newAllocation = Allocation{};
+	return old;
+}
+
+void GeometryPool::createStreamBuffer(Stream& stream, uint32_t capacity, VkBuffer& buffer, Allocation& allocation)
+{
+	//TRANSFER_SRC 是给扩容和碎片整理拷贝旧内容用的
+	VkDeviceSize size = VkDeviceSize(capacity) * stream.stride;
+	VkBufferUsageFlags usage = stream.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (stream.directWrite && Buffer::createDirectWriteBuffer(m_device, size, usage, buffer, allocation, MemoryUsage::Mesh))
+	{
+		return;
+	}
+	stream.directWrite = false;
+	Buffer::createBuffer(m_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation, MemoryUsage::Mesh);
+}
+
+uint32_t GeometryPool::allocateRange(Stream& stream, uint32_t count)
+{
+	if (count == 0)
+	{
+		throw std::runtime_error("failed to allocate geometry range: empty mesh!");
+	}
+
+	VkDeviceSize offset = 0;
+	if (!stream.metadata.allocate(count, 1, offset))
+	{
+		grow(stream, stream.capacity + count);
+		if (!stream.metadata.allocate(count, 1, offset))
+		{
+			throw std::runtime_error("failed to allocate geometry range!");
+		}
+	}
+	return static_cast<uint32_t>(offset);
+}
+
+void GeometryPool::grow(Stream& stream, uint32_t minCapacity)
+{
+	uint32_t newCapacity = stream.capacity;
+	while (newCapacity < minCapacity)
+	{
+		newCapacity *= 2;
+	}
+
+	//旧 buffer 上所有在途的上传都要落地，拷贝才能拿到完整内容
+	m_device.getStagingRing().wait();
+
+	VkBuffer newBuffer = VK_NULL_HANDLE;
+	Allocation newAllocation;
+	createStreamBuffer(stream, newCapacity, newBuffer, newAllocation);
+
+	//扩容很少发生，同步拷贝一次就好；拷完的数据要对之后帧的顶点/索引读取可见
+	VkCommandBuffer commandBuffer = CommandBuffer::beginSingleTimeCommands(m_device.getLogicalDevice(), m_device.getCommandPool());
+	VkBufferCopy copyRegion{};
+	copyRegion.size = VkDeviceSize(stream.capacity) * stream.stride;
+	vkCmdCopyBuffer(commandBuffer, stream.buffer, newBuffer, 1, &copyRegion);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	CommandBuffer::endSingleTimeCommands(m_device.getLogicalDevice(), m_device.getCommandPool(), m_device.getGraphicsQueue(), commandBuffer);
+
+	//在途的帧还绑着旧 buffer
+	Devices& device = m_device;
+	VkBuffer oldBuffer = stream.buffer;
+	Allocation oldAllocation = stream.allocation;
+	m_device.getDeletionQueue().push([&device, oldBuffer, oldAllocation]() mutable {
+		Buffer::destroyBuffer(device, oldBuffer, oldAllocation);
+	});
+
+	m_growCount++;
+	stream.buffer = newBuffer;
+	stream.allocation = newAllocation;
+	stream.capacity = newCapacity;
+	stream.metadata.grow(newCapacity);
+}
+
+void GeometryPool::write(UploadBatch& batch, Stream& stream, uint32_t offset, const void* data, uint32_t count)
+{
+	VkDeviceSize byteOffset = VkDeviceSize(offset) * stream.stride;
+	VkDeviceSize byteSize = VkDeviceSize(count) * stream.stride;
+	if (stream.directWrite)
+	{
+		memcpy(static_cast<char*>(stream.allocation.mappedData) + byteOffset, data, static_cast<size_t>(byteSize));
+		return;
+	}
+	batch.uploadBuffer(stream.buffer, byteOffset, data, byteSize);
+}
+
+void GeometryPool::settleRelocation()
+{
+	bool relocating = m_index.newBuffer != VK_NULL_HANDLE || m_index16.newBuffer != VK_NULL_HANDLE;
+	for (const Stream& stream : m_vertex)
+	{
+		relocating = relocating || stream.newBuffer != VK_NULL_HANDLE;
+	}
+	if (!relocating)
+	{
+		return;
+	}
+	m_device.getDefragmenter().settle(this);
+}
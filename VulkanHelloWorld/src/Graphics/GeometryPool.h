@@ -0,0 +1,114 @@
+﻿#pragma once
+#include <vulkan/vulkan.h>
+#include "../Core/Devices.h"
+#include "../Core/UploadBatch.h"
+#include <algorithm>
+#include <vector>
+
+class VertexLayout;
+
+// 一个模型在几何池里占的区间，单位是顶点/索引个数，可以直接填进 vkCmdDrawIndexed
+struct GeometryRange
+{
+	int32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32; // 决定 firstIndex 落在哪个索引流里
+};
+
+// 全场景共用的顶点/索引大 buffer，每个模型在里面切一段
+// 每个 pass 只需要绑定一次，draw 时靠 firstIndex/vertexOffset 区分模型，也是之后 multi-draw / indirect 的前提
+// 顶点数不超过 65536 的模型自动用 16 位索引，放在单独的索引流里，draw 前按类型绑定对应的索引 buffer
+// 顶点按布局的 binding 拆成几条非交错的流，各占一个 buffer、偏移相同；CPU 端传进来的顶点是各 binding 的数据按顺序拼起来的，写入时拆开
+// 阴影/深度 pass 只绑第一条流（位置），不用把颜色、UV、法线也读一遍
+// 空间不够时容量翻倍：新建更大的 buffer，用 GPU 把旧内容拷过去，旧 buffer 交给删除队列
+class GeometryPool : public Relocatable
+{
+public:
+	//布局最多能有几个 binding，bind 时用定长数组
+	static constexpr uint32_t kMaxVertexStreams = 4;
+
+	GeometryPool(Devices& device, const VertexLayout& layout, uint32_t vertexCapacity = 256 * 1024, uint32_t indexCapacity = 1024 * 1024);
+	~GeometryPool();
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	//切出区间并上传（UMA/ReBAR 上直接写进映射的显存），索引是相对模型自己的顶点的；token 是这次上传的凭证
+	//索引总是以 32 位传进来，放得进 16 位时在这里收窄
+	GeometryRange upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, UploadToken& token);
+	//upload 拆成两步，几个模型可以共用一批上传：先给所有模型 allocate（可能扩容），再逐个 write 进同一批
+	//扩容会把旧 buffer 拷到新 buffer，所以同一批里不能在 write 之后再 allocate，否则还没提交的写入会落在旧 buffer 上
+	GeometryRange allocate(uint32_t vertexCount, uint32_t indexCount);
+	void write(UploadBatch& batch, const GeometryRange& range, const void* vertices, const uint32_t* indices);
+	//由调用方指定索引类型，比如每个子网格的索引各自相对自己的顶点时，只要每个子网格放得进 16 位就行
+	GeometryRange allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType);
+	//分段写入区间的一部分，first 相对区间起点；索引已经是区间的索引类型，原样拷贝
+	void writeVertices(UploadBatch& batch, const GeometryRange& range, uint32_t firstVertex, const void* vertices, uint32_t count);
+	void writeIndices(UploadBatch& batch, const GeometryRange& range, uint32_t firstIndex, const void* indices, uint32_t count);
+	//同上，但索引以 32 位传进来，区间是 16 位时在这里收窄
+	void writeNarrowedIndices(UploadBatch& batch, const GeometryRange& range, uint32_t firstIndex, const uint32_t* indices, uint32_t count);
+	//不经过 allocate 就往已有区间补写（比如渐进加载后几帧补传细的 LOD）时，先调用它等正在进行的碎片整理拷贝完成
+	void settleRelocation();
+	//批次提交后登记凭证，传完之前池不会被碎片整理搬动
+	void trackUpload(UploadToken token) { m_uploadToken = std::max(m_uploadToken, token); }
+	//调用方负责保证 GPU 已经不再读这段区间（Model 通过删除队列延迟调用）
+	void free(const GeometryRange& range);
+
+	//只绑定顶点 buffer（每条流绑到自己的 binding）；索引 buffer 按模型的索引类型用 bindIndices 绑定，类型不变时不用重复绑
+	void bind(VkCommandBuffer cmd) const;
+	//只绑定 binding 0 的位置流，配合只声明了这一个 binding 的管线
+	void bindPositions(VkCommandBuffer cmd) const;
+	void bindIndices(VkCommandBuffer cmd, VkIndexType indexType) const;
+
+	//CPU 端一个顶点的大小，各条流的步长之和
+	uint32_t getVertexStride() const { return m_vertexStride; }
+	uint32_t getStreamCount() const { return static_cast<uint32_t>(m_vertex.size()); }
+	uint32_t getStreamStride(uint32_t binding) const { return m_vertex[binding].stride; }
+	uint32_t getVertexCapacity() const { return m_vertex[0].capacity; }
+	uint32_t getIndexCapacity() const { return m_index.capacity + m_index16.capacity; }
+	uint32_t getUsedVertices() const { return static_cast<uint32_t>(m_vertex[0].metadata.getUsedSize()); }
+	uint32_t getUsedIndices() const { return static_cast<uint32_t>(m_index.metadata.getUsedSize() + m_index16.metadata.getUsedSize()); }
+	//任意一条流扩容过的次数，显示在显存面板上
+	uint32_t getGrowCount() const { return m_growCount; }
+
+	//槽位 0 是第一条顶点流，1/2 是索引流，之后是其余的顶点流
+	uint32_t getSlotCount() const override { return static_cast<uint32_t>(m_vertex.size()) + 2; }
+	const Allocation& getSlotAllocation(uint32_t slot) const override { return slot == 0 ? m_vertex[0].allocation : slot == 1 ? m_index.allocation : slot == 2 ? m_index16.allocation : m_vertex[slot - 2].allocation; }
+	bool beginRelocation(uint32_t slot, VkCommandBuffer commandBuffer) override;
+	RelocatedResource endRelocation(uint32_t slot) override;
+
+private:
+	struct Stream
+	{
+		VkBufferUsageFlags usage;
+		uint32_t stride;
+		uint32_t capacity;     // 元素个数
+		BlockMetadata metadata; // 以元素为单位管理区间，偏移直接就是 firstIndex/vertexOffset
+		VkBuffer buffer = VK_NULL_HANDLE;
+		Allocation allocation;
+		bool directWrite = false;
+		//碎片整理已经录了拷贝、等 GPU 完成的新 buffer
+		VkBuffer newBuffer = VK_NULL_HANDLE;
+		Allocation newAllocation;
+
+		Stream(VkBufferUsageFlags usage, uint32_t stride, uint32_t capacity) : usage(usage), stride(stride), capacity(capacity), metadata(capacity) {}
+	};
+
+	Devices& m_device;
+	//每个 binding 一条；区间只由第一条流的 metadata 管理，其它流容量跟它一致、用同样的偏移
+	std::vector<Stream> m_vertex;
+	uint32_t m_vertexStride = 0;
+	Stream m_index;
+	Stream m_index16;
+	UploadToken m_uploadToken = 0; // 最近一次上传的凭证，传完之前不能被搬动
+	uint32_t m_growCount = 0;
+
+	Stream& getStream(uint32_t slot) { return slot == 0 ? m_vertex[0] : slot == 1 ? m_index : slot == 2 ? m_index16 : m_vertex[slot - 2]; }
+	Stream& getIndexStream(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? m_index16 : m_index; }
+	void createStreamBuffer(Stream& stream, uint32_t capacity, VkBuffer& buffer, Allocation& allocation);
+	uint32_t allocateRange(Stream& stream, uint32_t count);
+	void grow(Stream& stream, uint32_t minCapacity);
+	void write(UploadBatch& batch, Stream& stream, uint32_t offset, const void* data, uint32_t count);
+};
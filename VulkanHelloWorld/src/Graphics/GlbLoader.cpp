@@ -0,0 +1,773 @@
+﻿#include "GlbLoader.h"
+#include "../Core/Json.h"
+#include "../Core/MappedFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace
+{
+	constexpr uint32_t kMagic = 0x46546C67;     // "glTF"
+	constexpr uint32_t kChunkJson = 0x4E4F534A; // "JSON"
+	constexpr uint32_t kChunkBin = 0x004E4942;  // "BIN\0"
+
+	constexpr uint32_t kByte = 5120;
+	constexpr uint32_t kUnsignedByte = 5121;
+	constexpr uint32_t kShort = 5122;
+	constexpr uint32_t kUnsignedShort = 5123;
+	constexpr uint32_t kUnsignedInt = 5125;
+	constexpr uint32_t kFloat = 5126;
+	constexpr long long kTriangles = 4;
+
+	//已经检查过边界的 accessor，data 指向映射内存里的第一个元素
+	struct Accessor
+	{
+		const char* data = nullptr;
+		uint32_t count = 0;
+		uint32_t stride = 0;
+		uint32_t componentType = 0;
+		uint32_t components = 0;
+		bool normalized = false;
+		long long view = -1;
+		uint64_t offsetInView = 0;
+		const JsonValue* json = nullptr;
+	};
+
+	struct MeshInstance
+	{
+		uint32_t mesh;
+		glm::mat4 world;
+	};
+
+	uint32_t componentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case kByte: case kUnsignedByte: return 1;
+		case kShort: case kUnsignedShort: return 2;
+		case kUnsignedInt: case kFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	uint32_t componentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	template<typename T>
+	T readUnaligned(const char* p)
+	{
+		T value;
+		memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	class GlbFile
+	{
+	public:
+		GlbFile(const std::string& path) : m_path(path), m_file(std::make_unique<MappedFile>(path))
+		{
+			const char* data = m_file->getData();
+			uint64_t size = m_file->getSize();
+			if (size < 20 || readUnaligned<uint32_t>(data) != kMagic)
+			{
+				fail("not a binary glTF file");
+			}
+			if (readUnaligned<uint32_t>(data + 4) != 2)
+			{
+				fail("only glTF 2.0 is supported");
+			}
+			uint64_t length = readUnaligned<uint32_t>(data + 8);
+			if (length > size)
+			{
+				fail("file is truncated");
+			}
+
+			//第一个块必须是 JSON，第二个（可选）是 BIN，之后的未知块跳过
+			uint64_t offset = 12;
+			for (uint32_t chunk = 0; offset + 8 <= length; chunk++)
+			{
+				uint64_t chunkLength = readUnaligned<uint32_t>(data + offset);
+				uint32_t chunkType = readUnaligned<uint32_t>(data + offset + 4);
+				if (offset + 8 + chunkLength > length)
+				{
+					fail("chunk exceeds the file");
+				}
+				const char* chunkData = data + offset + 8;
+				if (chunk == 0)
+				{
+					if (chunkType != kChunkJson)
+					{
+						fail("first chunk is not JSON");
+					}
+					m_json = JsonValue::parse(std::string_view(chunkData, chunkLength));
+				}
+				else if (chunk == 1 && chunkType == kChunkBin)
+				{
+					m_bin = chunkData;
+					m_binSize = chunkLength;
+				}
+				offset += 8 + (chunkLength + 3) / 4 * 4;
+			}
+			if (!m_json.isObject())
+			{
+				fail("missing JSON chunk");
+			}
+		}
+
+		[[noreturn]] void fail(const std::string& what) const
+		{
+			throw std::runtime_error("failed to load glb " + m_path + ": " + what + "!");
+		}
+
+		const std::string& getPath() const { return m_path; }
+		const JsonValue& getJson() const { return m_json; }
+		std::unique_ptr<MappedFile> releaseFile() { return std::move(m_file); }
+
+		//只支持存在 BIN 块里的 buffer 0
+		void getBufferView(long long index, const char*& data, uint64_t& length, uint32_t& byteStride) const
+		{
+			const JsonValue& view = m_json["bufferViews"][static_cast<size_t>(std::max(index, -1LL))];
+			if (!view.isObject())
+			{
+				fail("invalid bufferView " + std::to_string(index));
+			}
+			const JsonValue& buffer = m_json["buffers"][0];
+			if (view["buffer"].asInt(-1) != 0 || !buffer.isObject() || buffer.contains("uri") || !m_bin)
+			{
+				fail("bufferView " + std::to_string(index) + " does not reference the BIN chunk");
+			}
+			long long offset = view["byteOffset"].asInt(0);
+			long long byteLength = view["byteLength"].asInt(-1);
+			if (offset < 0 || byteLength < 0 || uint64_t(offset) + uint64_t(byteLength) > m_binSize)
+			{
+				fail("bufferView " + std::to_string(index) + " exceeds the BIN chunk");
+			}
+			long long stride = view["byteStride"].asInt(0);
+			if (view.contains("byteStride") && (stride < 4 || stride > 252 || stride % 4 != 0))
+			{
+				fail("bufferView " + std::to_string(index) + " has an invalid byteStride");
+			}
+			data = m_bin + offset;
+			length = static_cast<uint64_t>(byteLength);
+			byteStride = static_cast<uint32_t>(stride);
+		}
+
+		Accessor getAccessor(long long index) const
+		{
+			const JsonValue& json = m_json["accessors"][static_cast<size_t>(std::max(index, -1LL))];
+			std::string name = "accessor " + std::to_string(index);
+			if (!json.isObject())
+			{
+				fail("invalid " + name);
+			}
+			if (json.contains("sparse"))
+			{
+				fail(name + " is sparse, which is not supported");
+			}
+			if (!json.contains("bufferView"))
+			{
+				fail(name + " has no bufferView");
+			}
+
+			Accessor accessor;
+			accessor.json = &json;
+			accessor.view = json["bufferView"].asInt(-1);
+			accessor.componentType = static_cast<uint32_t>(json["componentType"].asInt(0));
+			accessor.components = componentCount(json["type"].asString());
+			accessor.normalized = json["normalized"].asBool();
+			uint32_t size = componentSize(accessor.componentType);
+			long long count = json["count"].asInt(0);
+			long long offset = json["byteOffset"].asInt(0);
+			if (size == 0 || accessor.components == 0 || count <= 0 || count > UINT32_MAX || offset < 0)
+			{
+				fail(name + " has an invalid type or count");
+			}
+
+			const char* viewData = nullptr;
+			uint64_t viewLength = 0;
+			uint32_t byteStride = 0;
+			getBufferView(accessor.view, viewData, viewLength, byteStride);
+			uint32_t elementSize = size * accessor.components;
+			accessor.count = static_cast<uint32_t>(count);
+			accessor.stride = byteStride ? byteStride : elementSize;
+			accessor.offsetInView = static_cast<uint64_t>(offset);
+			//BIN 块本身从 4 字节对齐的位置开始，元素起点和步长都要按分量大小对齐
+			if (accessor.stride < elementSize || accessor.stride % size != 0 || (viewData - m_bin + offset) % size != 0)
+			{
+				fail(name + " is misaligned");
+			}
+			if (accessor.offsetInView + uint64_t(accessor.stride) * (accessor.count - 1) + elementSize > viewLength)
+			{
+				fail(name + " exceeds its bufferView");
+			}
+			accessor.data = viewData + offset;
+			return accessor;
+		}
+
+		//整个场景里带网格的节点，世界矩阵已经乘好；没有 scenes 时把所有根节点当作场景
+		std::vector<MeshInstance> collectInstances() const
+		{
+			std::vector<MeshInstance> instances;
+			const JsonValue& nodes = m_json["nodes"];
+			const JsonValue& scenes = m_json["scenes"];
+			if (scenes.size() > 0)
+			{
+				const JsonValue& scene = scenes[static_cast<size_t>(m_json["scene"].asInt(0))];
+				for (const JsonValue& root : scene["nodes"].getArray())
+				{
+					collectNode(root.asInt(-1), glm::mat4(1.0f), 0, instances);
+				}
+				return instances;
+			}
+
+			std::vector<bool> isChild(nodes.size(), false);
+			for (const JsonValue& node : nodes.getArray())
+			{
+				for (const JsonValue& child : node["children"].getArray())
+				{
+					size_t index = static_cast<size_t>(child.asInt(-1));
+					if (index < isChild.size())
+					{
+						isChild[index] = true;
+					}
+				}
+			}
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				if (!isChild[i])
+				{
+					collectNode(static_cast<long long>(i), glm::mat4(1.0f), 0, instances);
+				}
+			}
+			return instances;
+		}
+
+	private:
+		std::string m_path;
+		std::unique_ptr<MappedFile> m_file;
+		JsonValue m_json;
+		const char* m_bin = nullptr;
+		uint64_t m_binSize = 0;
+
+		void collectNode(long long index, const glm::mat4& parent, size_t depth, std::vector<MeshInstance>& instances) const
+		{
+			const JsonValue& nodes = m_json["nodes"];
+			const JsonValue& node = nodes[static_cast<size_t>(std::max(index, -1LL))];
+			//合法的节点树深度不会超过节点数，超过了说明有环
+			if (!node.isObject() || depth > nodes.size())
+			{
+				fail("invalid node hierarchy");
+			}
+			glm::mat4 world = parent * localMatrix(node);
+			if (node.contains("mesh"))
+			{
+				long long mesh = node["mesh"].asInt(-1);
+				if (mesh < 0 || static_cast<size_t>(mesh) >= m_json["meshes"].size())
+				{
+					fail("node references an invalid mesh");
+				}
+				instances.push_back({ static_cast<uint32_t>(mesh), world });
+			}
+			for (const JsonValue& child : node["children"].getArray())
+			{
+				collectNode(child.asInt(-1), world, depth + 1, instances);
+			}
+		}
+
+		static glm::mat4 localMatrix(const JsonValue& node)
+		{
+			const JsonValue& matrix = node["matrix"];
+			if (matrix.size() == 16)
+			{
+				float values[16];
+				for (size_t i = 0; i < 16; i++)
+				{
+					values[i] = static_cast<float>(matrix[i].asNumber());
+				}
+				return glm::make_mat4(values);
+			}
+			glm::vec3 translation(0.0f);
+			glm::vec3 scale(1.0f);
+			glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+			if (node["translation"].size() == 3)
+			{
+				translation = { node["translation"][0].asNumber(), node["translation"][1].asNumber(), node["translation"][2].asNumber() };
+			}
+			if (node["scale"].size() == 3)
+			{
+				scale = { node["scale"][0].asNumber(), node["scale"][1].asNumber(), node["scale"][2].asNumber() };
+			}
+			//glTF 的四元数是 xyzw，glm 的构造函数是 wxyz
+			if (node["rotation"].size() == 4)
+			{
+				const JsonValue& r = node["rotation"];
+				rotation = glm::quat(static_cast<float>(r[3].asNumber(1.0)), static_cast<float>(r[0].asNumber()),
+					static_cast<float>(r[1].asNumber()), static_cast<float>(r[2].asNumber()));
+			}
+			return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+		}
+	};
+
+	//按分量类型读成 float，normalized 的整数按 glTF 的规则映射到 [0,1] / [-1,1]
+	void readFloats(const Accessor& accessor, uint32_t index, float* out, uint32_t count)
+	{
+		const char* p = accessor.data + uint64_t(index) * accessor.stride;
+		count = std::min(count, accessor.components);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float value = 0.0f;
+			switch (accessor.componentType)
+			{
+			case kByte:
+				value = static_cast<float>(readUnaligned<int8_t>(p + i));
+				value = accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+				break;
+			case kUnsignedByte:
+				value = static_cast<float>(readUnaligned<uint8_t>(p + i));
+				value = accessor.normalized ? value / 255.0f : value;
+				break;
+			case kShort:
+				value = static_cast<float>(readUnaligned<int16_t>(p + 2 * i));
+				value = accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+				break;
+			case kUnsignedShort:
+				value = static_cast<float>(readUnaligned<uint16_t>(p + 2 * i));
+				value = accessor.normalized ? value / 65535.0f : value;
+				break;
+			case kUnsignedInt:
+				value = static_cast<float>(readUnaligned<uint32_t>(p + 4 * i));
+				break;
+			case kFloat:
+				value = readUnaligned<float>(p + 4 * i);
+				break;
+			}
+			out[i] = value;
+		}
+	}
+
+	uint32_t readIndex(const Accessor& accessor, uint32_t index)
+	{
+		const char* p = accessor.data + uint64_t(index) * accessor.stride;
+		switch (accessor.componentType)
+		{
+		case kUnsignedByte: return readUnaligned<uint8_t>(p);
+		case kUnsignedShort: return readUnaligned<uint16_t>(p);
+		default: return readUnaligned<uint32_t>(p);
+		}
+	}
+
+	bool hasExtension(const JsonValue& json, const char* list, const std::string& name)
+	{
+		for (const JsonValue& extension : json[list].getArray())
+		{
+			if (extension.asString() == name)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//只有平移和正的统一缩放时返回 true，这时世界矩阵就是一个反量化矩阵
+	bool toQuantization(const glm::mat4& world, VertexQuantization& quantization)
+	{
+		float scale = world[0][0];
+		float epsilon = std::abs(scale) * 1e-6f;
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				float expected = row == column ? scale : 0.0f;
+				if (std::abs(world[column][row] - expected) > epsilon)
+				{
+					return false;
+				}
+			}
+		}
+		if (scale <= 0.0f || world[3][3] != 1.0f)
+		{
+			return false;
+		}
+		quantization.center = glm::vec3(world[3]);
+		quantization.extent = scale;
+		return true;
+	}
+
+	struct AttributeRule
+	{
+		const char* name;
+		uint32_t offset;
+		uint32_t componentType;
+		bool normalized;
+		uint32_t minComponents;
+		uint32_t maxComponents;
+	};
+
+	//和 PackedVertex 一一对应的 glTF 属性
+	const AttributeRule kEngineLayout[] = {
+		{ "POSITION", offsetof(PackedVertex, pos), kShort, true, 3, 3 },
+		{ "COLOR_0", offsetof(PackedVertex, color), kUnsignedByte, true, 3, 4 },
+		{ "_TEXCOORD_HALF", offsetof(PackedVertex, texCoord), kUnsignedShort, false, 2, 2 },
+		{ "NORMAL", offsetof(PackedVertex, normal), kByte, true, 3, 3 },
+	};
+
+	bool isEngineLayout(const GlbFile& file, const JsonValue& attributes)
+	{
+		Accessor position = file.getAccessor(attributes["POSITION"].asInt(-1));
+		if (position.stride != sizeof(PackedVertex) || position.offsetInView % sizeof(PackedVertex) != 0
+			|| (*position.json)["min"].size() != 3 || (*position.json)["max"].size() != 3)
+		{
+			return false;
+		}
+		for (const AttributeRule& rule : kEngineLayout)
+		{
+			if (!attributes.contains(rule.name))
+			{
+				return false;
+			}
+			Accessor accessor = file.getAccessor(attributes[rule.name].asInt(-1));
+			if (accessor.view != position.view || accessor.offsetInView != position.offsetInView + rule.offset
+				|| accessor.componentType != rule.componentType || accessor.normalized != rule.normalized
+				|| accessor.components < rule.minComponents || accessor.components > rule.maxComponents || accessor.count != position.count)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	Vertex readVertex(const Accessor& position, const Accessor* color, const Accessor* texcoord, bool halfTexcoord, const Accessor* normal,
+		uint32_t index, const glm::mat4& world, const glm::mat3& normalMatrix)
+	{
+		Vertex vertex{};
+		float values[4] = {};
+		readFloats(position, index, values, 3);
+		vertex.pos = glm::vec3(world * glm::vec4(values[0], values[1], values[2], 1.0f));
+
+		vertex.color = glm::vec3(1.0f);
+		if (color)
+		{
+			readFloats(*color, index, values, 3);
+			vertex.color = { values[0], values[1], values[2] };
+		}
+
+		//glTF 的 UV 原点在左上角，和 Vulkan 一致，不用像 OBJ 那样翻转 V
+		if (texcoord && halfTexcoord)
+		{
+			const char* p = texcoord->data + uint64_t(index) * texcoord->stride;
+			vertex.texCoord = { glm::unpackHalf1x16(readUnaligned<uint16_t>(p)), glm::unpackHalf1x16(readUnaligned<uint16_t>(p + 2)) };
+		}
+		else if (texcoord)
+		{
+			readFloats(*texcoord, index, values, 2);
+			vertex.texCoord = { values[0], values[1] };
+		}
+
+		if (normal)
+		{
+			readFloats(*normal, index, values, 3);
+			vertex.normal = normalMatrix * glm::vec3(values[0], values[1], values[2]);
+		}
+		return vertex;
+	}
+
+	//基础色贴图的原始字节：内嵌在 BIN 块里的，或者 glb 旁边的外部文件；data URI 不支持
+	std::vector<unsigned char> loadImage(const GlbFile& file, long long textureIndex)
+	{
+		const JsonValue& json = file.getJson();
+		const JsonValue& image = json["images"][static_cast<size_t>(json["textures"][static_cast<size_t>(textureIndex)]["source"].asInt(-1))];
+		if (image.contains("bufferView"))
+		{
+			const char* data = nullptr;
+			uint64_t length = 0;
+			uint32_t byteStride = 0;
+			file.getBufferView(image["bufferView"].asInt(-1), data, length, byteStride);
+			return std::vector<unsigned char>(data, data + length);
+		}
+
+		const std::string& uri = image["uri"].asString();
+		if (uri.empty() || uri.rfind("data:", 0) == 0)
+		{
+			return {};
+		}
+		std::filesystem::path imagePath = std::filesystem::path(file.getPath()).parent_path() / uri;
+		std::ifstream in(imagePath, std::ios::binary);
+		return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void loadMaterials(const GlbFile& file, ModelData& data)
+	{
+		for (const JsonValue& material : file.getJson()["materials"].getArray())
+		{
+			ModelMaterial result;
+			const JsonValue& pbr = material["pbrMetallicRoughness"];
+			const JsonValue& factor = pbr["baseColorFactor"];
+			for (size_t i = 0; i < 4 && factor.size() == 4; i++)
+			{
+				result.baseColor[static_cast<glm::length_t>(i)] = static_cast<float>(factor[i].asNumber(1.0));
+			}
+			if (pbr["baseColorTexture"].contains("index"))
+			{
+				result.image = loadImage(file, pbr["baseColorTexture"]["index"].asInt(-1));
+			}
+			data.materials.push_back(std::move(result));
+		}
+	}
+
+	struct Primitive
+	{
+		const JsonValue* json;
+		const MeshInstance* instance;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+}
+
+bool GlbLoader::isGlb(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".glb";
+}
+
+void GlbLoader::load(const std::string& path, ModelData& data)
+{
+	GlbFile file(path);
+	const JsonValue& json = file.getJson();
+	for (const JsonValue& extension : json["extensionsRequired"].getArray())
+	{
+		if (extension.asString() != "KHR_mesh_quantization")
+		{
+			file.fail("required extension " + extension.asString() + " is not supported");
+		}
+	}
+	bool quantized = hasExtension(json, "extensionsUsed", "KHR_mesh_quantization") || hasExtension(json, "extensionsRequired", "KHR_mesh_quantization");
+
+	//先把所有三角形图元和它们的顶点数、索引数找出来，决定索引类型和能不能直接拷贝
+	std::vector<MeshInstance> instances = file.collectInstances();
+	std::vector<Primitive> primitives;
+	uint32_t skipped = 0;
+	bool allFit16 = true;
+	for (const MeshInstance& instance : instances)
+	{
+		for (const JsonValue& primitive : json["meshes"][instance.mesh]["primitives"].getArray())
+		{
+			if (primitive["mode"].asInt(kTriangles) != kTriangles)
+			{
+				skipped++;
+				continue;
+			}
+			const JsonValue& attributes = primitive["attributes"];
+			if (!attributes.contains("POSITION"))
+			{
+				file.fail("primitive has no POSITION");
+			}
+			Accessor position = file.getAccessor(attributes["POSITION"].asInt(-1));
+			if (position.components != 3 || (!quantized && position.componentType != kFloat))
+			{
+				file.fail("POSITION must be VEC3 float (or quantized with KHR_mesh_quantization)");
+			}
+			for (const auto& [name, value] : attributes.getObject())
+			{
+				if (file.getAccessor(value.asInt(-1)).count != position.count)
+				{
+					file.fail("attribute " + name + " has a different count than POSITION");
+				}
+			}
+			uint32_t indexCount = primitive.contains("indices") ? file.getAccessor(primitive["indices"].asInt(-1)).count : position.count;
+			if (indexCount % 3 != 0)
+			{
+				file.fail("triangle list index count is not a multiple of 3");
+			}
+			allFit16 = allFit16 && position.count <= 65536;
+			primitives.push_back({ &primitive, &instance, position.count, indexCount });
+		}
+	}
+	if (primitives.empty())
+	{
+		file.fail("no triangle primitives in the default scene");
+	}
+
+	//每个子网格的索引相对它自己的 vertexOffset，所以每个图元都不超过 65536 个顶点就能用 16 位索引
+	data.indexType = allFit16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	uint32_t directIndexType = allFit16 ? kUnsignedShort : kUnsignedInt;
+	size_t indexSize = allFit16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	bool direct = instances.size() == 1 && toQuantization(instances[0].world, data.quantization)
+		&& std::all_of(primitives.begin(), primitives.end(), [&](const Primitive& primitive) { return isEngineLayout(file, (*primitive.json)["attributes"]); });
+
+	loadMaterials(file, data);
+	uint32_t defaultMaterial = static_cast<uint32_t>(data.materials.size());
+
+	//转换出来的顶点和索引先记下在数组里的偏移，数组都填完再换成指针
+	std::vector<Vertex> converted;
+	std::vector<uint32_t> convertedIndices;
+	std::vector<size_t> vertexOffsets(primitives.size(), SIZE_MAX);
+	std::vector<size_t> indexOffsets(primitives.size(), SIZE_MAX);
+	bool hasBounds = false;
+	uint32_t vertexBase = 0;
+	uint32_t indexBase = 0;
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		const Primitive& primitive = primitives[p];
+		const JsonValue& attributes = (*primitive.json)["attributes"];
+		Accessor position = file.getAccessor(attributes["POSITION"].asInt(-1));
+
+		Submesh submesh;
+		submesh.firstIndex = indexBase;
+		submesh.indexCount = primitive.indexCount;
+		submesh.vertexOffset = static_cast<int32_t>(vertexBase);
+		submesh.vertexCount = primitive.vertexCount;
+		long long material = (*primitive.json)["material"].asInt(-1);
+		submesh.material = material >= 0 && material < defaultMaterial ? static_cast<uint32_t>(material) : defaultMaterial;
+		SubmeshSource source;
+
+		if (direct)
+		{
+			//min/max 是 SHORT 的原始值，换算到模型空间就是包围盒，不用扫描顶点
+			source.vertices = position.data;
+			const JsonValue& min = (*position.json)["min"];
+			const JsonValue& max = (*position.json)["max"];
+			glm::vec3 low(min[0].asNumber(), min[1].asNumber(), min[2].asNumber());
+			glm::vec3 high(max[0].asNumber(), max[1].asNumber(), max[2].asNumber());
+			low = data.quantization.center + glm::max(low / 32767.0f, glm::vec3(-1.0f)) * data.quantization.extent;
+			high = data.quantization.center + glm::max(high / 32767.0f, glm::vec3(-1.0f)) * data.quantization.extent;
+			data.bounds.min = hasBounds ? glm::min(data.bounds.min, low) : low;
+			data.bounds.max = hasBounds ? glm::max(data.bounds.max, high) : high;
+			hasBounds = true;
+		}
+		else
+		{
+			const glm::mat4& world = primitive.instance->world;
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+			auto optional = [&](const char* name, Accessor& storage) -> const Accessor* {
+				if (!attributes.contains(name))
+				{
+					return nullptr;
+				}
+				storage = file.getAccessor(attributes[name].asInt(-1));
+				return &storage;
+			};
+			Accessor colorStorage, texcoordStorage, normalStorage;
+			const Accessor* color = optional("COLOR_0", colorStorage);
+			const Accessor* texcoord = optional("TEXCOORD_0", texcoordStorage);
+			bool halfTexcoord = !texcoord && attributes.contains("_TEXCOORD_HALF");
+			if (halfTexcoord)
+			{
+				texcoord = optional("_TEXCOORD_HALF", texcoordStorage);
+			}
+			const Accessor* normal = optional("NORMAL", normalStorage);
+
+			vertexOffsets[p] = converted.size();
+			for (uint32_t i = 0; i < position.count; i++)
+			{
+				converted.push_back(readVertex(position, color, texcoord, halfTexcoord, normal, i, world, normalMatrix));
+			}
+		}
+
+		//索引类型和模型一致、又是紧密排列的（索引的 bufferView 不允许有步长）就直接拷，否则转换；两种都要检查越界
+		if (primitive.json->contains("indices"))
+		{
+			Accessor indices = file.getAccessor((*primitive.json)["indices"].asInt(-1));
+			if (indices.components != 1 || (indices.componentType != kUnsignedByte && indices.componentType != kUnsignedShort && indices.componentType != kUnsignedInt))
+			{
+				file.fail("indices must be unsigned scalars");
+			}
+			for (uint32_t i = 0; i < indices.count; i++)
+			{
+				if (readIndex(indices, i) >= primitive.vertexCount)
+				{
+					file.fail("index out of range");
+				}
+			}
+			if (indices.componentType == directIndexType && indices.stride == indexSize)
+			{
+				source.indices = indices.data;
+			}
+			else
+			{
+				indexOffsets[p] = convertedIndices.size();
+				for (uint32_t i = 0; i < indices.count; i++)
+				{
+					convertedIndices.push_back(readIndex(indices, i));
+				}
+			}
+		}
+		else
+		{
+			indexOffsets[p] = convertedIndices.size();
+			for (uint32_t i = 0; i < primitive.indexCount; i++)
+			{
+				convertedIndices.push_back(i);
+			}
+		}
+
+		data.submeshes.push_back(submesh);
+		data.sources.push_back(source);
+		vertexBase += primitive.vertexCount;
+		indexBase += primitive.indexCount;
+	}
+
+	if (!direct)
+	{
+		data.bounds.min = data.bounds.max = converted[0].pos;
+		for (const Vertex& vertex : converted)
+		{
+			data.bounds.min = glm::min(data.bounds.min, vertex.pos);
+			data.bounds.max = glm::max(data.bounds.max, vertex.pos);
+		}
+		data.quantization = VertexQuantization::fromBounds(data.bounds.min, data.bounds.max);
+		data.vertices.resize(converted.size());
+		for (size_t i = 0; i < converted.size(); i++)
+		{
+			data.vertices[i] = PackedVertex::pack(converted[i], data.quantization);
+		}
+	}
+	if (allFit16)
+	{
+		data.indices16.assign(convertedIndices.begin(), convertedIndices.end());
+	}
+	else
+	{
+		data.indices = std::move(convertedIndices);
+	}
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		if (vertexOffsets[p] != SIZE_MAX)
+		{
+			data.sources[p].vertices = data.vertices.data() + vertexOffsets[p];
+		}
+		if (indexOffsets[p] != SIZE_MAX)
+		{
+			data.sources[p].indices = allFit16 ? static_cast<const void*>(data.indices16.data() + indexOffsets[p]) : data.indices.data() + indexOffsets[p];
+		}
+	}
+
+	data.lods.assign(1, { 0, indexBase, 0.0f });
+	data.materials.push_back(ModelMaterial{});
+	//直接拷贝的指针指向映射内存，映射要活到上传完成
+	data.file = file.releaseFile();
+
+	if (skipped > 0)
+	{
+		std::ostringstream log;
+		log << "skipped " << skipped << " non-triangle primitives in " << path << "\n";
+		std::cout << log.str() << std::flush;
+	}
+}
@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <string>
+#include "Model.h"
+
+// 二进制 glTF 2.0（.glb）加载：整个文件内存映射，解析 JSON 块，用到的每个 accessor 都要检查：落在 BIN 块里、步长和对齐合法、索引不越界
+// 默认场景里的每个三角形图元成为模型的一个子网格，材质按 glTF 的下标对应到 ModelData::materials，没有材质的图元用追加在最后的白色材质
+// 文件已经是引擎的顶点布局时，顶点（以及类型和模型一致的索引）直接从映射内存拷进 staging，不做逐顶点转换：
+//   只有一个带网格的节点，节点变换只有平移和统一缩放（正好是反量化矩阵），需要 KHR_mesh_quantization，
+//   每个图元的属性交错在同一个 byteStride 为 20 的 bufferView 里，POSITION 带 min/max：
+//   POSITION SHORT normalized VEC3 @0，COLOR_0 UNSIGNED_BYTE normalized VEC3/VEC4 @8，
+//   _TEXCOORD_HALF UNSIGNED_SHORT VEC2 @12，NORMAL BYTE normalized VEC3 @16
+// glTF 没有半精度的 UV，所以用应用自定义的 _TEXCOORD_HALF 属性存半精度浮点的原始位，别的工具会忽略它
+// 其它文件读成 Vertex、烘焙节点变换，再按包围盒量化；稀疏 accessor、外部 buffer 不支持，非三角形的图元跳过
+class GlbLoader
+{
+public:
+	static bool isGlb(const std::string& path);
+	//线程安全，出错时抛异常
+	static void load(const std::string& path, ModelData& data);
+};
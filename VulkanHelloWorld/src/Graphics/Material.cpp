@@ -9,19 +9,34 @@ Material::Material(Devices& device, int maxFrame, std::shared_ptr<Pipeline> pipe
 
 void Material::addTexture(uint32_t binding, std::shared_ptr<Texture> texture, VkSampler sampler)
 {
-	TextureData data = { binding,texture, sampler };
+	TextureData data = { binding,texture, sampler, {} };
 	m_textures.emplace(binding, data);
 }
 
-void Material::addUniformBuffer(uint32_t binding, const std::vector<VkBuffer>& buffers, VkDeviceSize range)
+void Material::addUniformBuffer(uint32_t binding, VkDeviceSize range)
 {
-	UniformData data = { binding,buffers,range };
+	UniformData data = { binding,range,0,0 };
 	m_uniformBuffers.emplace(binding, data);
 }
 
+void Material::updateUniform(uint32_t binding, const void* data)
+{
+	auto it = m_uniformBuffers.find(binding);
+	if (it == m_uniformBuffers.end() || !m_uniformRing)
+	{
+		throw std::runtime_error("failed to update uniform: binding not declared or material not built!");
+	}
+	it->second.offset = m_uniformRing->push(data, it->second.range);
+	it->second.frameSerial = m_uniformRing->getFrameSerial();
+}
+
 void Material::build(Renderer& renderer)
 {
+	m_uniformRing = &renderer.getUniformRing();
+	m_dynamicOffsets.assign(1 + m_uniformBuffers.size(), 0);
+
 	std::cout << "Allocating sets with layout: " << m_deslayout << std::endl;
+	//build 是加载期的操作，可能发生在一帧中间（比如后台模型换上之后），临时数组用局部内存，不占帧分配器这一帧的预算
 	std::vector<VkDescriptorSetLayout> layouts(m_MAX_FRAMES_IN_FLIGHT, m_deslayout);
 
 	VkDescriptorSetAllocateInfo allocInfo{};
@@ -36,103 +51,156 @@ void Material::build(Renderer& renderer)
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
+	//全局 UBO 和光源 UBO 各一个，加上材质自己的 uniform 和贴图
+	uint32_t writeCount = static_cast<uint32_t>(2 + m_uniformBuffers.size() + m_textures.size());
+	//先按最终大小分配好，填写时元素地址不会变，pBufferInfo/pImageInfo 可以直接指过去
+	std::vector<VkWriteDescriptorSet> descriptorWrites(writeCount);
+	std::vector<VkDescriptorBufferInfo> bufferInfos(2 + m_uniformBuffers.size());
+	std::vector<VkDescriptorImageInfo> imageInfos(m_textures.size());
 
-	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++)
+	for (auto& key : m_textures)
 	{
-		std::vector<VkWriteDescriptorSet> descriptorWrites;
+		key.second.versions.assign(m_MAX_FRAMES_IN_FLIGHT, key.second.tex->getVersion());
+	}
 
-		std::vector<VkDescriptorBufferInfo> bufferInfos;
-		std::vector<VkDescriptorImageInfo> imageInfos;
-		bufferInfos.reserve(m_uniformBuffers.size());
-		imageInfos.reserve(m_textures.size());
+	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		uint32_t write = 0;
+		uint32_t bufferIndex = 0;
+		uint32_t imageIndex = 0;
 
-		//ȫglobal uniform
-		VkDescriptorBufferInfo globalBufferInfo{};
-		globalBufferInfo.buffer = renderer.getGlbUniformBuffers()[i]->getHandle();
+		//加载全局global uniform，指向 uniform 环，具体位置由动态偏移决定
+		VkDescriptorBufferInfo& globalBufferInfo = bufferInfos[bufferIndex++];
+		globalBufferInfo.buffer = m_uniformRing->getHandle();
 		globalBufferInfo.offset = 0;
 		globalBufferInfo.range = sizeof(GlobalUniformBufferObject);
 
-
-		VkWriteDescriptorSet descriptorWrite{};
+		VkWriteDescriptorSet& descriptorWrite = descriptorWrites[write++];
 		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrite.dstSet = m_descriptorSets[i];
 		descriptorWrite.dstBinding = 0;
 		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pImageInfo = nullptr;
-		descriptorWrite.pBufferInfo = &globalBufferInfo; // Optional
-		descriptorWrite.pTexelBufferView = nullptr; // Optional
-
-		descriptorWrites.push_back(descriptorWrite);
+		descriptorWrite.pBufferInfo = &globalBufferInfo;
+
+		//光源 uniform 在 binding 3，指向 Renderer 的 TrackedBuffer，所有帧共用
+		VkDescriptorBufferInfo& lightBufferInfo = bufferInfos[bufferIndex++];
+		lightBufferInfo.buffer = renderer.getLightBuffer();
+		lightBufferInfo.offset = 0;
+		lightBufferInfo.range = sizeof(LightUniformBufferObject);
+
+		VkWriteDescriptorSet& lightWrite = descriptorWrites[write++];
+		lightWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		lightWrite.dstSet = m_descriptorSets[i];
+		lightWrite.dstBinding = 3;
+		lightWrite.dstArrayElement = 0;
+		lightWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		lightWrite.descriptorCount = 1;
+		lightWrite.pBufferInfo = &lightBufferInfo;
 
 		for (auto& key : m_uniformBuffers)
 		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = key.second.buffers[i];
+			VkDescriptorBufferInfo& bufferInfo = bufferInfos[bufferIndex++];
+			bufferInfo.buffer = m_uniformRing->getHandle();
 			bufferInfo.offset = 0;
 			bufferInfo.range = key.second.range;
-			bufferInfos.push_back(bufferInfo);
 
-			VkWriteDescriptorSet descriptorWrite{};
+			VkWriteDescriptorSet& descriptorWrite = descriptorWrites[write++];
 			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrite.dstSet = m_descriptorSets[i];
 			descriptorWrite.dstBinding = key.second.binding;
 			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pImageInfo = nullptr;
-			descriptorWrite.pBufferInfo = &bufferInfos.back(); // Optional
-			descriptorWrite.pTexelBufferView = nullptr; // Optional
-
-			descriptorWrites.push_back(descriptorWrite);
+			descriptorWrite.pBufferInfo = &bufferInfo;
 		}
 
 		for (auto& key : m_textures)
 		{
-			VkDescriptorImageInfo imageInfo{};
+			VkDescriptorImageInfo& imageInfo = imageInfos[imageIndex++];
 			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			imageInfo.imageView = key.second.tex->getImageView();
 			imageInfo.sampler = key.second.sampler;
-			imageInfos.push_back(imageInfo);
 
-			VkWriteDescriptorSet descriptorWrite{};
+			VkWriteDescriptorSet& descriptorWrite = descriptorWrites[write++];
 			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrite.dstSet = m_descriptorSets[i];
 			descriptorWrite.dstBinding = key.second.binding;
 			descriptorWrite.dstArrayElement = 0;
 			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pImageInfo = &imageInfos.back();
-			descriptorWrite.pBufferInfo = nullptr; // Optional
-			descriptorWrite.pTexelBufferView = nullptr; // Optional
-
-			descriptorWrites.push_back(descriptorWrite);
+			descriptorWrite.pImageInfo = &imageInfo;
 		}
 
-		vkUpdateDescriptorSets(m_device.getLogicalDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
+		//vkUpdateDescriptorSets 会立刻读完这些数据，下一个 set 直接覆盖同一块临时内存
+		vkUpdateDescriptorSets(m_device.getLogicalDevice(), write, descriptorWrites.data(), 0, nullptr);
 	}
 
 }
 
-void Material::bind(VkCommandBuffer cmdbuf, uint32_t currentFrame)
+void Material::bind(VkCommandBuffer cmdbuf, uint32_t currentFrame, uint32_t globalUboOffset)
 {
+	for (auto& key : m_textures)
+	{
+		if (key.second.versions[currentFrame] != key.second.tex->getVersion())
+		{
+			refreshTextureDescriptor(currentFrame, key.second);
+		}
+	}
+
 	VkPipelineLayout layout = m_pipeline->getPipelineLayout().getHandle();
 	vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline->getPipeline());
-	vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &m_descriptorSets[currentFrame], 0, nullptr);
+
+	//动态偏移的顺序和 binding 顺序一致
+	m_dynamicOffsets[0] = globalUboOffset;
+	size_t index = 1;
+	for (auto& key : m_uniformBuffers)
+	{
+		if (key.second.frameSerial != m_uniformRing->getFrameSerial())
+		{
+			throw std::runtime_error("failed to bind material: uniform binding not updated this frame!");
+		}
+		m_dynamicOffsets[index++] = key.second.offset;
+	}
+	vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &m_descriptorSets[currentFrame],
+		static_cast<uint32_t>(m_dynamicOffsets.size()), m_dynamicOffsets.data());
+}
+
+void Material::refreshTextureDescriptor(uint32_t currentFrame, TextureData& data)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = data.tex->getImageView();
+	imageInfo.sampler = data.sampler;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSets[currentFrame];
+	descriptorWrite.dstBinding = data.binding;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(m_device.getLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
+
+	data.versions[currentFrame] = data.tex->getVersion();
 }
 
 Material::~Material()
 {
 	if (!m_descriptorSets.empty()) {
-		// ⼸֡ռõ Sets  Devices ȫֳ
-		vkFreeDescriptorSets(
-			m_device.getLogicalDevice(),
-			m_device.getDescriptorPool(),
-			static_cast<uint32_t>(m_descriptorSets.size()),
-			m_descriptorSets.data()
-		);
+		// 把这几帧占用的 Sets 还给 Devices 里的全局池；在途的帧还绑着它们，延迟到这些帧结束
+		Devices& device = m_device;
+		std::vector<VkDescriptorSet> descriptorSets = std::move(m_descriptorSets);
+		m_device.getDeletionQueue().push([&device, descriptorSets]() {
+			vkFreeDescriptorSets(
+				device.getLogicalDevice(),
+				device.getDescriptorPool(),
+				static_cast<uint32_t>(descriptorSets.size()),
+				descriptorSets.data()
+			);
+		});
 	}
 }
 
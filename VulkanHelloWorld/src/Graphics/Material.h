@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <memory>
@@ -18,10 +18,12 @@ public:
 	Material& operator=(const Material&) = delete;
 
 	void addTexture(uint32_t binding, std::shared_ptr<Texture> texture, VkSampler sampler);
-	void addUniformBuffer(uint32_t binding, const std::vector<VkBuffer>& buffers, VkDeviceSize range);
+	//声明一个由 renderer 的 uniform 环提供数据的动态 uniform 绑定，数据每帧用 updateUniform 写入，这一帧没写就 bind 会抛异常
+	void addUniformBuffer(uint32_t binding, VkDeviceSize range);
+	void updateUniform(uint32_t binding, const void* data);
 
 	void build(Renderer& renderer);
-	void bind(VkCommandBuffer cmdbuf, uint32_t currentFrame);
+	void bind(VkCommandBuffer cmdbuf, uint32_t currentFrame, uint32_t globalUboOffset);
 	
 	void setPipeline(std::shared_ptr<Pipeline> pipeline)
 	{ 
@@ -45,18 +47,26 @@ private:
 		uint32_t binding;
 		std::shared_ptr<Texture> tex;
 		VkSampler sampler;
+		std::vector<uint32_t> versions; // 每帧描述符写入时纹理的 version，纹理被碎片整理搬动后不一致
 	};
 
 	struct UniformData
 	{
 		uint32_t binding;
-		std::vector<VkBuffer> buffers;
 		VkDeviceSize range;
+		uint32_t offset; // 本帧数据在 uniform 环里的动态偏移
+		uint64_t frameSerial; // 写入 offset 时环的帧序号，不是当前帧说明这一帧没有 updateUniform，旧偏移指向的数据已经被覆盖
 	};
 
 	std::map<uint32_t, TextureData> m_textures;
 	std::map<uint32_t, UniformData> m_uniformBuffers;
 
+	UniformRing* m_uniformRing = nullptr;
+	// 按 binding 顺序排列，第 0 个是全局 UBO；提前分配好，绑定时不再申请内存
+	std::vector<uint32_t> m_dynamicOffsets;
+	//本帧的描述符集已经不被 GPU 使用，可以安全地换成搬动后的 imageView
+	void refreshTextureDescriptor(uint32_t currentFrame, TextureData& data);
+
 };
 
 
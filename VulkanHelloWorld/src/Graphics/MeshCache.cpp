@@ -0,0 +1,220 @@
+﻿#include "MeshCache.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr char kMagic[8] = { 'V', 'K', 'M', 'E', 'S', 'H', 0, 0 };
+	constexpr uint64_t kPageSize = 4096;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexStride;
+		uint64_t sourceTime;
+		uint64_t sourceSize;
+		uint64_t contentHash;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t fileSize;
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t pathLength; // 紧跟在头部后面的源路径，用来排除文件名哈希冲突
+		uint32_t lodCount;   // 源路径后面紧跟着的 LOD 表
+		uint32_t meshletCount; // LOD 表后面紧跟着的 meshlet 表
+	};
+
+	uint64_t alignPage(uint64_t value)
+	{
+		return (value + kPageSize - 1) / kPageSize * kPageSize;
+	}
+
+	//按 8 字节一组混合，比逐字节的 FNV 快得多，源文件再大也只占加载时间的一小部分
+	uint64_t hashBytes(const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+		size_t words = size / 8;
+		for (size_t i = 0; i < words; i++)
+		{
+			uint64_t word;
+			memcpy(&word, p + i * 8, 8);
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 32;
+		}
+		uint64_t tail = 0;
+		memcpy(&tail, p + words * 8, size - words * 8);
+		hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	uint64_t hashFile(const std::string& path)
+	{
+		MappedFile file(path);
+		return hashBytes(file.getData(), file.getSize());
+	}
+
+	uint64_t sourceTime(const std::string& path)
+	{
+		return static_cast<uint64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+	}
+}
+
+std::string MeshCache::getCachePath(const std::string& sourcePath)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(hashBytes(sourcePath.data(), sourcePath.size())));
+	return "cache/meshes/" + std::string(name);
+}
+
+std::unique_ptr<MeshCacheView> MeshCache::open(const std::string& sourcePath, uint32_t vertexStride)
+{
+	std::string cachePath = getCachePath(sourcePath);
+	std::error_code error;
+	if (!std::filesystem::exists(cachePath, error))
+	{
+		return nullptr;
+	}
+
+	std::unique_ptr<MeshCacheView> view;
+	try
+	{
+		view = std::make_unique<MeshCacheView>(cachePath);
+	}
+	catch (const std::exception&)
+	{
+		return nullptr;
+	}
+	const char* data = view->m_file.getData();
+	size_t size = view->m_file.getSize();
+	if (size < sizeof(Header))
+	{
+		return nullptr;
+	}
+
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.vertexStride != vertexStride
+		|| header.fileSize != size
+		|| sizeof(Header) + header.pathLength + uint64_t(header.lodCount) * sizeof(MeshLod) + uint64_t(header.meshletCount) * sizeof(Meshlet) > size
+		|| sourcePath.compare(0, std::string::npos, data + sizeof(Header), header.pathLength) != 0)
+	{
+		return nullptr;
+	}
+
+	//修改时间和大小都一样就直接信任；时间变了但大小没变，再比一次内容
+	uint64_t sourceSize = std::filesystem::file_size(sourcePath);
+	if (sourceSize != header.sourceSize)
+	{
+		return nullptr;
+	}
+	if (sourceTime(sourcePath) != header.sourceTime && hashFile(sourcePath) != header.contentHash)
+	{
+		return nullptr;
+	}
+
+	if (header.vertexOffset + uint64_t(header.vertexCount) * vertexStride > size
+		|| header.indexOffset + uint64_t(header.indexCount) * sizeof(uint32_t) > size)
+	{
+		return nullptr;
+	}
+
+	view->m_vertices = data + header.vertexOffset;
+	view->m_indices = reinterpret_cast<const uint32_t*>(data + header.indexOffset);
+	view->m_vertexCount = header.vertexCount;
+	view->m_indexCount = header.indexCount;
+	view->m_bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	view->m_bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	view->m_lods.resize(header.lodCount);
+	memcpy(view->m_lods.data(), data + sizeof(Header) + header.pathLength, header.lodCount * sizeof(MeshLod));
+	for (const MeshLod& lod : view->m_lods)
+	{
+		if (uint64_t(lod.indexOffset) + lod.indexCount > header.indexCount || lod.vertexCount > header.vertexCount)
+		{
+			return nullptr;
+		}
+	}
+	view->m_meshlets.resize(header.meshletCount);
+	memcpy(view->m_meshlets.data(), data + sizeof(Header) + header.pathLength + header.lodCount * sizeof(MeshLod), header.meshletCount * sizeof(Meshlet));
+	for (const Meshlet& meshlet : view->m_meshlets)
+	{
+		if (uint64_t(meshlet.indexOffset) + meshlet.indexCount > header.indexCount)
+		{
+			return nullptr;
+		}
+	}
+	return view;
+}
+
+void MeshCache::write(const std::string& sourcePath, const void* vertices, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* indices, uint32_t indexCount, const MeshBounds& bounds, const std::vector<MeshLod>& lods,
+	const std::vector<Meshlet>& meshlets)
+{
+	Header header{};
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.vertexStride = vertexStride;
+	header.sourceTime = sourceTime(sourcePath);
+	header.sourceSize = std::filesystem::file_size(sourcePath);
+	header.contentHash = hashFile(sourcePath);
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.pathLength = static_cast<uint32_t>(sourcePath.size());
+	header.lodCount = static_cast<uint32_t>(lods.size());
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+	header.vertexOffset = alignPage(sizeof(Header) + header.pathLength + lods.size() * sizeof(MeshLod) + meshlets.size() * sizeof(Meshlet));
+	header.indexOffset = alignPage(header.vertexOffset + uint64_t(vertexCount) * vertexStride);
+	header.fileSize = header.indexOffset + uint64_t(indexCount) * sizeof(uint32_t);
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = bounds.min[i];
+		header.boundsMax[i] = bounds.max[i];
+	}
+
+	std::string cachePath = getCachePath(sourcePath);
+	//临时文件名带上线程号，几个线程同时写同一份缓存也不会写进同一个临时文件，最后改名的那份生效
+	std::string tempPath = cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		const std::vector<char> padding(kPageSize, 0);
+		auto pad = [&](uint64_t target) {
+			uint64_t position = static_cast<uint64_t>(out.tellp());
+			out.write(padding.data(), static_cast<std::streamsize>(target - position));
+		};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		out.write(sourcePath.data(), static_cast<std::streamsize>(sourcePath.size()));
+		out.write(reinterpret_cast<const char*>(lods.data()), static_cast<std::streamsize>(lods.size() * sizeof(MeshLod)));
+		out.write(reinterpret_cast<const char*>(meshlets.data()), static_cast<std::streamsize>(meshlets.size() * sizeof(Meshlet)));
+		pad(header.vertexOffset);
+		out.write(static_cast<const char*>(vertices), static_cast<std::streamsize>(uint64_t(vertexCount) * vertexStride));
+		pad(header.indexOffset);
+		out.write(reinterpret_cast<const char*>(indices), static_cast<std::streamsize>(uint64_t(indexCount) * sizeof(uint32_t)));
+		if (!out)
+		{
+			std::cerr << "failed to write mesh cache: " << cachePath << std::endl;
+			//先关掉再删，Windows 上删不掉还开着的文件
+			out.close();
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+
+	//先写临时文件再改名，中途崩溃也不会留下半个缓存
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::cerr << "failed to write mesh cache: " << cachePath << " (" << error.message() << ")" << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../Core/MappedFile.h"
+#include "Meshlet.h"
+
+struct MeshBounds
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+};
+
+// 一级 LOD 在模型索引里的区间，error 是相对原始网格的几何误差（模型空间的距离），第 0 级是原始网格
+// 顶点按第一次被哪一级（从最粗的开始）用到排序，每一级只用到前 vertexCount 个顶点，可以从粗到细分批上传；0 表示用到全部顶点
+struct MeshLod
+{
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	float error = 0.0f;
+	uint32_t vertexCount = 0;
+};
+
+// 一份映射好的网格缓存，顶点和索引直接指向映射内存，可以原样拷进 staging
+class MeshCacheView
+{
+public:
+	explicit MeshCacheView(const std::string& cachePath) : m_file(cachePath) {}
+
+	const void* getVertices() const { return m_vertices; }
+	const uint32_t* getIndices() const { return m_indices; }
+	uint32_t getVertexCount() const { return m_vertexCount; }
+	uint32_t getIndexCount() const { return m_indexCount; }
+	const MeshBounds& getBounds() const { return m_bounds; }
+	const std::vector<MeshLod>& getLods() const { return m_lods; }
+	const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+
+private:
+	friend class MeshCache;
+	MappedFile m_file;
+	const void* m_vertices = nullptr;
+	const uint32_t* m_indices = nullptr;
+	uint32_t m_vertexCount = 0;
+	uint32_t m_indexCount = 0;
+	MeshBounds m_bounds;
+	std::vector<MeshLod> m_lods;
+	std::vector<Meshlet> m_meshlets;
+};
+
+// 二进制网格缓存：存最终的（焊接、优化后的）顶点、所有 LOD 的索引、LOD 表、meshlet 表和包围盒，顶点和索引各从一个 4KB 页边界开始
+// 缓存文件放在 cache/meshes 下，文件名由源路径的哈希得到；头部记录源文件的修改时间、大小和内容哈希，
+// 修改时间对不上时再比内容哈希，只是被 touch 过的文件仍然可以用缓存
+// 顶点格式、文件布局或加载时的优化变化时增加 kVersion，旧缓存自动失效
+class MeshCache
+{
+public:
+	static constexpr uint32_t kVersion = 6;
+
+	//缓存存在且和源文件一致时返回映射，否则返回空
+	static std::unique_ptr<MeshCacheView> open(const std::string& sourcePath, uint32_t vertexStride);
+	//写失败只打印警告，不影响这次加载
+	static void write(const std::string& sourcePath, const void* vertices, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* indices, uint32_t indexCount, const MeshBounds& bounds, const std::vector<MeshLod>& lods,
+		const std::vector<Meshlet>& meshlets);
+
+	static std::string getCachePath(const std::string& sourcePath);
+};
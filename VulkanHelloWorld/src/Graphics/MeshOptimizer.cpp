@@ -0,0 +1,286 @@
+﻿#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+	//每个顶点相邻的三角形，CSR 形式存放
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+		std::vector<uint32_t> counts;   // 还没输出的相邻三角形数（Tipsify 里的 live）
+	};
+
+	void buildAdjacency(Adjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		adjacency.counts.assign(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			adjacency.counts[indices[i]]++;
+		}
+
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacency.offsets[v + 1] = adjacency.offsets[v] + adjacency.counts[v];
+		}
+
+		adjacency.triangles.resize(indexCount);
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	if (indexCount == 0 || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	//FIFO：时间戳离当前超过 cacheSize 就已经被挤出去了
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (time - cacheTime[v] > cacheSize)
+		{
+			cacheTime[v] = time++;
+			stats.transforms++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(stats.transforms) / static_cast<float>(indexCount / 3);
+	stats.atvr = static_cast<float>(stats.transforms) / static_cast<float>(vertexCount);
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters, uint32_t cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (clusters)
+	{
+		clusters->assign(1, 0);
+	}
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	Adjacency adjacency;
+	buildAdjacency(adjacency, indices, indexCount, vertexCount);
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;      // 最近用过的顶点，候选都用完时从这里找还有剩余三角形的
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output(indexCount);
+	size_t outputTriangles = 0;
+	uint32_t time = cacheSize + 1;
+	uint32_t cursor = 0;                // 顺序扫描的位置，死路时兜底
+
+	//从第一个有三角形的顶点开始
+	int64_t fanning = 0;
+	while (fanning < static_cast<int64_t>(vertexCount) && adjacency.counts[fanning] == 0)
+	{
+		fanning++;
+	}
+
+	while (fanning >= 0 && fanning < static_cast<int64_t>(vertexCount))
+	{
+		uint32_t f = static_cast<uint32_t>(fanning);
+		candidates.clear();
+
+		//把扇心顶点周围还没输出的三角形全部输出
+		for (uint32_t k = adjacency.offsets[f]; k < adjacency.offsets[f + 1]; k++)
+		{
+			uint32_t triangle = adjacency.triangles[k];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t v = indices[triangle * 3 + corner];
+				output[outputTriangles * 3 + corner] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				adjacency.counts[v]--;
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[triangle] = true;
+			outputTriangles++;
+		}
+
+		//候选里挑一个：扇完之后还在缓存里的、越早进缓存的越优先（它最快被挤出去）
+		int64_t best = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (adjacency.counts[v] == 0)
+			{
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * adjacency.counts[v] <= cacheSize)
+			{
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		if (best < 0)
+		{
+			//死路：先回头找最近用过的，再不行就顺序扫；这种情况缓存基本已经失效，作为簇边界
+			while (!deadEnd.empty() && best < 0)
+			{
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (adjacency.counts[v] > 0)
+				{
+					best = v;
+				}
+			}
+			while (best < 0 && cursor < vertexCount)
+			{
+				if (adjacency.counts[cursor] > 0)
+				{
+					best = cursor;
+				}
+				cursor++;
+			}
+			if (best >= 0 && clusters && time - cacheTime[best] > cacheSize && outputTriangles < triangleCount)
+			{
+				clusters->push_back(static_cast<uint32_t>(outputTriangles));
+			}
+		}
+		fanning = best;
+	}
+
+	memcpy(indices, output.data(), outputTriangles * 3 * sizeof(uint32_t));
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, const std::vector<uint32_t>& clusters)
+{
+	size_t triangleCount = indexCount / 3;
+	if (clusters.size() < 2 || triangleCount == 0)
+	{
+		return;
+	}
+
+	auto position = [&](uint32_t v) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+	};
+
+	//整个网格的中心，用来判断簇是朝外还是朝里
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = position(static_cast<uint32_t>(v));
+		meshCenter[0] += p[0];
+		meshCenter[1] += p[1];
+		meshCenter[2] += p[2];
+	}
+	for (float& c : meshCenter)
+	{
+		c /= static_cast<float>(vertexCount);
+	}
+
+	//每个簇按面积加权的中心和法线；中心越靠外、法线越朝外，越可能挡住别的簇，越先画
+	size_t clusterCount = clusters.size();
+	std::vector<float> sortKey(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (size_t t = begin; t < end; t++)
+		{
+			const float* a = position(indices[t * 3 + 0]);
+			const float* b = position(indices[t * 3 + 1]);
+			const float* d = position(indices[t * 3 + 2]);
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float w = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int i = 0; i < 3; i++)
+			{
+				center[i] += (a[i] + b[i] + d[i]) / 3.0f * w;
+				normal[i] += n[i];
+			}
+			area += w;
+		}
+
+		if (area <= 0.0f)
+		{
+			sortKey[c] = 0.0f;
+			continue;
+		}
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			key += (center[i] / area - meshCenter[i]) * (length > 0.0f ? normal[i] / length : 0.0f);
+		}
+		sortKey[c] = key;
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indexCount);
+	for (uint32_t c : order)
+	{
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+		output.insert(output.end(), indices + begin * 3, indices + end * 3);
+	}
+	memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount)
+{
+	constexpr uint32_t kUnused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, kUnused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t& target = remap[indices[i]];
+		if (target == kUnused)
+		{
+			target = next++;
+		}
+		indices[i] = target;
+	}
+
+	//先拷一份原始顶点再按新顺序写回
+	std::vector<char> original(static_cast<const char*>(vertices), static_cast<const char*>(vertices) + vertexCount * vertexSize);
+	char* out = static_cast<char*>(vertices);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != kUnused)
+		{
+			memcpy(out + remap[v] * vertexSize, original.data() + v * vertexSize, vertexSize);
+		}
+	}
+	return next;
+}
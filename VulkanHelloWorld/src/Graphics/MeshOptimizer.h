@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 后变换顶点缓存的模拟结果：FIFO 缓存，未命中一次算一次顶点着色
+// ACMR = 变换次数 / 三角形数（越接近 0.5 越好），ATVR = 变换次数 / 顶点数（1.0 是最优）
+struct VertexCacheStats
+{
+	uint32_t transforms = 0;
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+// 加载期的网格优化，全部在 CPU 上完成，不依赖 GPU：
+// 1. optimizeVertexCache：Tipsify 三角形重排，提高后变换缓存命中率，并给出缓存被清空处的簇边界
+// 2. optimizeOverdraw（可选）：按簇的朝向把朝外、靠外的簇排到前面，减少 overdraw，簇内顺序不变所以 ACMR 基本不受影响
+// 3. optimizeVertexFetch：按索引里第一次出现的顺序重排顶点，让顶点读取尽量顺序访问
+class MeshOptimizer
+{
+public:
+	static constexpr uint32_t kCacheSize = 16;
+
+	static VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = kCacheSize);
+
+	//clusters 非空时输出每个簇第一个三角形的序号（第 0 个簇从 0 开始）
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr, uint32_t cacheSize = kCacheSize);
+	//positions 指向第一个顶点的位置，positionStride 是相邻两个顶点位置之间的字节数
+	static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, const std::vector<uint32_t>& clusters);
+	//原地重排顶点并改写索引，返回重排后的顶点数（没被引用的顶点会被丢掉）
+	static size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount);
+};
@@ -0,0 +1,337 @@
+﻿#include "MeshSimplifier.h"
+#include "VertexWeld.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace
+{
+	//边界上的约束平面比三角形平面权重高，防止边界被收缩进去
+	constexpr double kBorderWeight = 10.0;
+	//折叠后三角形法线转过的角度超过这个余弦值就认为是翻面
+	constexpr double kFlipThreshold = 0.25;
+
+	// 对称矩阵 A、向量 b、常数 c，误差为 pᵀAp + 2bᵀp + c；weight 用来把误差归一化成距离的平方
+	struct Quadric
+	{
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void addPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+			a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22; a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c; weight += q.weight;
+		}
+
+		//归一化之后的误差：到各平面距离平方的加权平均
+		double error(const glm::dvec3& p) const
+		{
+			double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+			double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+			double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+			double value = p.x * rx + p.y * ry + p.z * rz + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return weight > 0.0 ? std::abs(value) / weight : 0.0;
+		}
+	};
+
+	// 一轮折叠用到的拓扑：每个位置相邻的三角形（CSR）
+	struct Topology
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	void buildTopology(Topology& topology, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionOf, size_t positionCount)
+	{
+		topology.offsets.assign(positionCount + 1, 0);
+		for (uint32_t v : indices)
+		{
+			topology.offsets[positionOf[v] + 1]++;
+		}
+		for (size_t p = 0; p < positionCount; p++)
+		{
+			topology.offsets[p + 1] += topology.offsets[p];
+		}
+		topology.triangles.resize(indices.size());
+		std::vector<uint32_t> fill(topology.offsets.begin(), topology.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			topology.triangles[fill[positionOf[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(const uint32_t* sourceIndices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float& error)
+{
+	error = 0.0f;
+	std::vector<uint32_t> indices(sourceIndices, sourceIndices + indexCount);
+	if (indexCount <= targetIndexCount)
+	{
+		return indices;
+	}
+
+	//位置相同的顶点（接缝两侧）合成一个位置，拓扑和误差都按位置算
+	std::vector<glm::vec3> uniquePositions;
+	std::vector<uint32_t> positionOf(vertexCount);
+	VertexWeldTable<glm::vec3> weldTable(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+		positionOf[v] = weldTable.weld(glm::vec3(p[0], p[1], p[2]), uniquePositions);
+	}
+	size_t positionCount = uniquePositions.size();
+	auto pos = [&](uint32_t p) { return glm::dvec3(uniquePositions[p]); };
+
+	Topology topology;
+	auto corner = [&](uint32_t triangle, uint32_t k) { return positionOf[indices[triangle * 3 + k]]; };
+	//a->b 这条有向边是否存在（属于某个三角形）
+	auto hasEdge = [&](uint32_t a, uint32_t b) {
+		for (uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1]; i++)
+		{
+			uint32_t t = topology.triangles[i];
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				if (corner(t, k) == a && corner(t, (k + 1) % 3) == b)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	};
+
+	//初始误差：三角形平面按面积加权，边界边再加一个垂直于三角形的约束平面
+	buildTopology(topology, indices, positionOf, positionCount);
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t t = 0; t < indices.size() / 3; t++)
+	{
+		uint32_t p[3] = { corner(t, 0), corner(t, 1), corner(t, 2) };
+		glm::dvec3 normal = glm::cross(pos(p[1]) - pos(p[0]), pos(p[2]) - pos(p[0]));
+		double length = glm::length(normal);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		normal /= length;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			quadrics[p[k]].addPlane(normal, -glm::dot(normal, pos(p[0])), length * 0.5);
+		}
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t a = p[k];
+			uint32_t b = p[(k + 1) % 3];
+			if (hasEdge(b, a))
+			{
+				continue;
+			}
+			glm::dvec3 edge = pos(b) - pos(a);
+			glm::dvec3 plane = glm::cross(edge, normal);
+			double planeLength = glm::length(plane);
+			if (planeLength <= 0.0)
+			{
+				continue;
+			}
+			plane /= planeLength;
+			double weight = glm::dot(edge, edge) * kBorderWeight;
+			quadrics[a].addPlane(plane, -glm::dot(plane, pos(a)), weight);
+			quadrics[b].addPlane(plane, -glm::dot(plane, pos(a)), weight);
+		}
+	}
+
+	double maxError = static_cast<double>(targetError) * targetError;
+	double resultError = 0.0;
+	std::vector<uint8_t> border(positionCount);
+	std::vector<uint8_t> locked(positionCount);
+	std::vector<uint32_t> bestTarget(positionCount);
+	std::vector<double> bestCost(positionCount);
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<std::pair<uint32_t, uint32_t>> wedges;
+
+	//每一轮：重建拓扑，给每个位置挑误差最小的折叠目标，按误差从小到大折叠；同一轮里互相影响的折叠只做第一个
+	while (indices.size() > targetIndexCount)
+	{
+		buildTopology(topology, indices, positionOf, positionCount);
+		std::fill(border.begin(), border.end(), uint8_t(0));
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t a = corner(static_cast<uint32_t>(t), k);
+				uint32_t b = corner(static_cast<uint32_t>(t), (k + 1) % 3);
+				if (!hasEdge(b, a))
+				{
+					border[a] = border[b] = 1;
+				}
+			}
+		}
+
+		order.clear();
+		for (uint32_t a = 0; a < positionCount; a++)
+		{
+			bestCost[a] = maxError;
+			bestTarget[a] = ~0u;
+			for (uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1]; i++)
+			{
+				uint32_t t = topology.triangles[i];
+				uint32_t k = corner(t, 0) == a ? 0 : corner(t, 1) == a ? 1 : 2;
+				uint32_t next = corner(t, (k + 1) % 3);
+				uint32_t prev = corner(t, (k + 2) % 3);
+				for (uint32_t b : { next, prev })
+				{
+					if (b == a)
+					{
+						continue;
+					}
+					//边界上的点只能沿边界边移动
+					if (border[a])
+					{
+						bool borderEdge = b == next ? !hasEdge(next, a) : !hasEdge(a, prev);
+						if (!borderEdge)
+						{
+							continue;
+						}
+					}
+					double cost = quadrics[a].error(pos(b));
+					if (cost <= bestCost[a])
+					{
+						bestCost[a] = cost;
+						bestTarget[a] = b;
+					}
+				}
+			}
+			if (bestTarget[a] != ~0u)
+			{
+				order.push_back(a);
+			}
+		}
+		if (order.empty())
+		{
+			break;
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) { return bestCost[x] < bestCost[y]; });
+
+		std::fill(locked.begin(), locked.end(), uint8_t(0));
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = static_cast<uint32_t>(v);
+		}
+
+		size_t triangleCount = indices.size() / 3;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t collapses = 0;
+		for (uint32_t a : order)
+		{
+			if (triangleCount <= targetTriangles)
+			{
+				break;
+			}
+			uint32_t b = bestTarget[a];
+			if (locked[a] || locked[b])
+			{
+				continue;
+			}
+
+			//a 的每个顶点（接缝两侧各一个）都要在某个同时含 a、b 的三角形里找到对应的 b 顶点，否则折叠会撕开接缝
+			wedges.clear();
+			bool flipped = false;
+			size_t removed = 0;
+			for (uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1]; i++)
+			{
+				uint32_t t = topology.triangles[i];
+				uint32_t k = corner(t, 0) == a ? 0 : corner(t, 1) == a ? 1 : 2;
+				uint32_t va = indices[t * 3 + k];
+				uint32_t p1 = corner(t, (k + 1) % 3);
+				uint32_t p2 = corner(t, (k + 2) % 3);
+				if (p1 == b || p2 == b)
+				{
+					uint32_t vb = indices[t * 3 + (p1 == b ? (k + 1) % 3 : (k + 2) % 3)];
+					wedges.push_back({ va, vb });
+					removed++;
+					continue;
+				}
+				glm::dvec3 before = glm::cross(pos(p1) - pos(a), pos(p2) - pos(a));
+				glm::dvec3 after = glm::cross(pos(p1) - pos(b), pos(p2) - pos(b));
+				if (glm::dot(before, after) <= kFlipThreshold * glm::length(before) * glm::length(after))
+				{
+					flipped = true;
+					break;
+				}
+			}
+			if (flipped || removed == 0)
+			{
+				continue;
+			}
+
+			bool torn = false;
+			for (uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1] && !torn; i++)
+			{
+				uint32_t t = topology.triangles[i];
+				uint32_t k = corner(t, 0) == a ? 0 : corner(t, 1) == a ? 1 : 2;
+				uint32_t va = indices[t * 3 + k];
+				torn = std::none_of(wedges.begin(), wedges.end(), [va](const std::pair<uint32_t, uint32_t>& w) { return w.first == va; });
+			}
+			if (torn)
+			{
+				continue;
+			}
+
+			for (const auto& wedge : wedges)
+			{
+				remap[wedge.first] = wedge.second;
+			}
+			quadrics[b].add(quadrics[a]);
+			resultError = std::max(resultError, bestCost[a]);
+			triangleCount -= removed;
+			collapses++;
+
+			//a 的一圈邻居这一轮都不再动，保证上面的翻面检查用到的位置是最新的
+			locked[a] = locked[b] = 1;
+			for (uint32_t i = topology.offsets[a]; i < topology.offsets[a + 1]; i++)
+			{
+				uint32_t t = topology.triangles[i];
+				locked[corner(t, 0)] = locked[corner(t, 1)] = locked[corner(t, 2)] = 1;
+			}
+		}
+		if (collapses == 0)
+		{
+			break;
+		}
+
+		//改写索引，去掉退化成线的三角形
+		size_t write = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t v0 = remap[indices[i + 0]];
+			uint32_t v1 = remap[indices[i + 1]];
+			uint32_t v2 = remap[indices[i + 2]];
+			uint32_t p0 = positionOf[v0];
+			uint32_t p1 = positionOf[v1];
+			uint32_t p2 = positionOf[v2];
+			if (p0 == p1 || p1 == p2 || p0 == p2)
+			{
+				continue;
+			}
+			indices[write++] = v0;
+			indices[write++] = v1;
+			indices[write++] = v2;
+		}
+		indices.resize(write);
+	}
+
+	error = static_cast<float>(std::sqrt(resultError));
+	return indices;
+}
@@ -0,0 +1,16 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 基于二次误差（QEM）的网格简化：半边折叠，顶点只会折叠到已有的顶点上，所以结果仍然引用原来的顶点数组，
+// 各级 LOD 可以和原始网格共用同一段顶点，只需要各自的索引
+// 按位置合并 UV/法线接缝两侧的顶点来判断拓扑，接缝上的顶点只能沿接缝折叠，网格边界的顶点只能沿边界折叠
+class MeshSimplifier
+{
+public:
+	//targetIndexCount 是希望的索引数，误差超过 targetError（模型空间的距离）就提前停下
+	//error 输出简化后的几何误差（模型空间的距离），选 LOD 时换算成屏幕像素
+	static std::vector<uint32_t> simplify(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount,
+		size_t targetIndexCount, float targetError, float& error);
+};
@@ -0,0 +1,593 @@
+﻿#include "MeshStreamer.h"
+#include "../Core/MappedFile.h"
+#include "ObjParser.h"
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr char kMagic[8] = { 'V', 'K', 'S', 'T', 'R', 'M', 0, 0 };
+	constexpr uint64_t kPageSize = 4096;
+	//每个桶大约这么多三角形；桶越小块内的空间局部性越好，但分桶的缓冲也越多
+	constexpr uint64_t kTrianglesPerBucket = 64 * 1024;
+	constexpr size_t kMinBucketBuffer = 64 * 1024;
+
+	struct PageHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t chunkCount;
+		uint64_t sourceTime;
+		uint64_t sourceSize;
+		uint64_t fileSize;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	// 每块从一个页边界开始，头后面紧跟顶点和 16 位索引
+	struct ChunkHeader
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	// 拆好的三角形，分桶和回读都以它为单位
+	struct Triangle
+	{
+		ObjIndex corners[3];
+	};
+
+	// 溢出文件里属于某个桶的一段
+	struct SpillBlock
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct ScanResult
+	{
+		uint64_t positionCount = 0; // 以顶点为单位，下同
+		uint64_t texcoordCount = 0;
+		uint64_t normalCount = 0;
+		uint64_t faceCount = 0;
+		uint64_t triangleCount = 0;
+		MeshBounds bounds;
+	};
+
+	uint64_t alignPage(uint64_t value)
+	{
+		return (value + kPageSize - 1) / kPageSize * kPageSize;
+	}
+
+	uint64_t sourceTime(const std::string& path)
+	{
+		return static_cast<uint64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+	}
+
+	// 导入用到的临时文件，析构时删掉，中途抛异常也不会留下几十 GB 的垃圾
+	class TempFiles
+	{
+	public:
+		explicit TempFiles(const std::string& prefix) : m_prefix(prefix) {}
+		~TempFiles()
+		{
+			std::error_code error;
+			for (const std::string& path : m_paths)
+			{
+				std::filesystem::remove(path, error);
+			}
+		}
+
+		std::string add(const std::string& name)
+		{
+			m_paths.push_back(m_prefix + "." + name);
+			return m_paths.back();
+		}
+
+	private:
+		std::string m_prefix;
+		std::vector<std::string> m_paths;
+	};
+
+	std::ofstream openWrite(const std::string& path)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			throw std::runtime_error("failed to create file: " + path);
+		}
+		return out;
+	}
+
+	void write(std::ofstream& out, const void* data, size_t size)
+	{
+		out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		if (!out)
+		{
+			throw std::runtime_error("failed to write streaming ingest data!");
+		}
+	}
+
+	void read(std::ifstream& in, void* data, size_t size)
+	{
+		in.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+		if (static_cast<size_t>(in.gcount()) != size)
+		{
+			throw std::runtime_error("failed to read streaming ingest data!");
+		}
+	}
+
+	// 和 Model::makeVertex 的规则一致，只是属性来自映射的临时文件
+	Vertex makeVertex(const float* positions, const float* texcoords, const float* normals, const ObjIndex& index)
+	{
+		Vertex vertex{};
+		vertex.pos = { positions[3 * size_t(index.vertex) + 0], positions[3 * size_t(index.vertex) + 1], positions[3 * size_t(index.vertex) + 2] };
+		if (index.texcoord >= 0)
+		{
+			vertex.texCoord = { texcoords[2 * size_t(index.texcoord) + 0], 1.0f - texcoords[2 * size_t(index.texcoord) + 1] };
+		}
+		if (index.normal >= 0)
+		{
+			vertex.normal = { normals[3 * size_t(index.normal) + 0], normals[3 * size_t(index.normal) + 1], normals[3 * size_t(index.normal) + 2] };
+		}
+		vertex.color = { 1.0f, 1.0f, 1.0f };
+		return vertex;
+	}
+
+	glm::vec3 position(const float* positions, int32_t index)
+	{
+		return glm::vec3(positions[3 * size_t(index) + 0], positions[3 * size_t(index) + 1], positions[3 * size_t(index) + 2]);
+	}
+
+	//第 1 步：按 readSize 分块读源文件，只解析到块里最后一个换行，剩下的半行和下一块拼起来
+	ScanResult scanSource(const std::string& sourcePath, size_t readSize, const std::string& positionPath, const std::string& texcoordPath,
+		const std::string& normalPath, const std::string& facePath, const std::string& cornerPath)
+	{
+		std::ifstream source(sourcePath, std::ios::binary);
+		if (!source)
+		{
+			throw std::runtime_error("failed to open file: " + sourcePath);
+		}
+		std::ofstream positions = openWrite(positionPath);
+		std::ofstream texcoords = openWrite(texcoordPath);
+		std::ofstream normals = openWrite(normalPath);
+		std::ofstream faces = openWrite(facePath);
+		std::ofstream corners = openWrite(cornerPath);
+
+		ScanResult scan;
+		std::vector<char> buffer(readSize);
+		ObjBlock block;
+		size_t carry = 0;
+		while (true)
+		{
+			source.read(buffer.data() + carry, static_cast<std::streamsize>(readSize - carry));
+			size_t size = carry + static_cast<size_t>(source.gcount());
+			bool last = !source;
+			size_t end = size;
+			if (!last)
+			{
+				while (end > 0 && buffer[end - 1] != '\n')
+				{
+					end--;
+				}
+				if (end == 0)
+				{
+					throw std::runtime_error("failed to stream obj: line longer than the read buffer!");
+				}
+			}
+
+			try
+			{
+				ObjParser::parseBlock(buffer.data(), end, scan.positionCount, scan.texcoordCount, scan.normalCount, block);
+			}
+			catch (const std::exception& e)
+			{
+				throw std::runtime_error(sourcePath + ": " + e.what());
+			}
+
+			for (size_t i = 0; i < block.positions.size(); i += 3)
+			{
+				glm::vec3 p(block.positions[i], block.positions[i + 1], block.positions[i + 2]);
+				bool first = scan.positionCount == 0 && i == 0;
+				scan.bounds.min = first ? p : glm::min(scan.bounds.min, p);
+				scan.bounds.max = first ? p : glm::max(scan.bounds.max, p);
+			}
+			for (uint32_t faceSize : block.faceSizes)
+			{
+				scan.triangleCount += faceSize >= 3 ? faceSize - 2 : 0;
+			}
+			write(positions, block.positions.data(), block.positions.size() * sizeof(float));
+			write(texcoords, block.texcoords.data(), block.texcoords.size() * sizeof(float));
+			write(normals, block.normals.data(), block.normals.size() * sizeof(float));
+			write(faces, block.faceSizes.data(), block.faceSizes.size() * sizeof(uint32_t));
+			write(corners, block.corners.data(), block.corners.size() * sizeof(ObjIndex));
+			scan.positionCount += block.positions.size() / 3;
+			scan.texcoordCount += block.texcoords.size() / 2;
+			scan.normalCount += block.normals.size() / 3;
+			scan.faceCount += block.faceSizes.size();
+
+			carry = size - end;
+			memmove(buffer.data(), buffer.data() + end, carry);
+			if (last)
+			{
+				break;
+			}
+		}
+		return scan;
+	}
+
+	//分页文件存在且和源文件一致时按块回放；返回是否用上了分页文件，completed 表示有没有被回调中止
+	bool replay(const std::string& sourcePath, const std::string& pagePath, const MeshStreamer::ChunkCallback& onChunk, bool& completed)
+	{
+		std::error_code error;
+		if (!std::filesystem::exists(pagePath, error))
+		{
+			return false;
+		}
+		std::unique_ptr<MappedFile> file;
+		try
+		{
+			file = std::make_unique<MappedFile>(pagePath);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+		const char* data = file->getData();
+		uint64_t size = file->getSize();
+		if (size < sizeof(PageHeader))
+		{
+			return false;
+		}
+
+		PageHeader header;
+		memcpy(&header, data, sizeof(PageHeader));
+		if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != MeshStreamer::kVersion || header.fileSize != size
+			|| header.sourceSize != std::filesystem::file_size(sourcePath) || header.sourceTime != sourceTime(sourcePath))
+		{
+			return false;
+		}
+
+		//先把所有块头都检查一遍，坏文件不能回放到一半才发现
+		std::vector<uint64_t> offsets(header.chunkCount);
+		uint64_t offset = alignPage(sizeof(PageHeader));
+		for (uint32_t i = 0; i < header.chunkCount; i++)
+		{
+			if (offset + sizeof(ChunkHeader) > size)
+			{
+				return false;
+			}
+			ChunkHeader chunk;
+			memcpy(&chunk, data + offset, sizeof(ChunkHeader));
+			uint64_t end = offset + sizeof(ChunkHeader) + uint64_t(chunk.vertexCount) * sizeof(PackedVertex) + uint64_t(chunk.indexCount) * sizeof(uint16_t);
+			if (chunk.vertexCount > MeshStreamer::kMaxChunkVertices || end > size)
+			{
+				return false;
+			}
+			offsets[i] = offset;
+			offset = alignPage(end);
+		}
+
+		MeshBounds bounds;
+		bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+		completed = true;
+		for (uint64_t chunkOffset : offsets)
+		{
+			ChunkHeader chunkHeader;
+			memcpy(&chunkHeader, data + chunkOffset, sizeof(ChunkHeader));
+			const char* payload = data + chunkOffset + sizeof(ChunkHeader);
+			StreamedChunk chunk;
+			chunk.vertices = reinterpret_cast<const PackedVertex*>(payload);
+			chunk.vertexCount = chunkHeader.vertexCount;
+			chunk.indices = reinterpret_cast<const uint16_t*>(payload + uint64_t(chunkHeader.vertexCount) * sizeof(PackedVertex));
+			chunk.indexCount = chunkHeader.indexCount;
+			if (!onChunk(bounds, chunk))
+			{
+				completed = false;
+				break;
+			}
+		}
+		return true;
+	}
+}
+
+std::string MeshStreamer::getPagePath(const std::string& sourcePath)
+{
+	std::string path = MeshCache::getCachePath(sourcePath);
+	return path.substr(0, path.size() - std::string(".mesh").size()) + ".pages";
+}
+
+bool MeshStreamer::ingest(const std::string& sourcePath, size_t memoryBudget, const ChunkCallback& onChunk)
+{
+	std::string pagePath = getPagePath(sourcePath);
+	bool completed = false;
+	if (replay(sourcePath, pagePath, onChunk, completed))
+	{
+		return completed;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	memoryBudget = std::max(memoryBudget, kMinMemoryBudget);
+	//预算的分配：读缓冲 1/16（解析出来的一段和它差不多大），分桶缓冲 1/4，
+	//剩下的留给块内焊接（固定几 MB）、调用方排队等上传的块和系统缓存的页
+	size_t readSize = memoryBudget / 16;
+	size_t bucketMemory = memoryBudget / 4;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(pagePath).parent_path(), error);
+	//临时文件名带上线程号，同时导入几个模型也不会冲突
+	TempFiles temp(pagePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())));
+	std::string positionPath = temp.add("positions");
+	std::string texcoordPath = temp.add("texcoords");
+	std::string normalPath = temp.add("normals");
+	std::string facePath = temp.add("faces");
+	std::string cornerPath = temp.add("corners");
+	std::string spillPath = temp.add("buckets");
+	std::string tempPagePath = temp.add("tmp");
+
+	ScanResult scan = scanSource(sourcePath, readSize, positionPath, texcoordPath, normalPath, facePath, cornerPath);
+
+	//格子是立方体，边长按最长的轴切；扫描件基本是曲面，占用的格子数大约是最长轴格数的平方，按这个估每个桶的三角形数
+	//很薄的轴只有一格，不会把一张起伏的曲面切成好几层；格子总数受分桶缓冲限制
+	glm::vec3 extent = glm::max(scan.bounds.max - scan.bounds.min, glm::vec3(1e-20f));
+	float longest = std::max(std::max(extent.x, extent.y), extent.z);
+	uint32_t maxBuckets = static_cast<uint32_t>(std::max<size_t>(1, bucketMemory / kMinBucketBuffer));
+	uint32_t cellsOnLongest = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(double(scan.triangleCount) / kTrianglesPerBucket))));
+	glm::uvec3 cells;
+	while (true)
+	{
+		float cellSize = longest / float(cellsOnLongest);
+		cells = glm::uvec3(glm::max(glm::ceil(extent / cellSize - 1e-3f), glm::vec3(1.0f)));
+		if (cellsOnLongest == 1 || uint64_t(cells.x) * cells.y * cells.z <= maxBuckets)
+		{
+			break;
+		}
+		cellsOnLongest--;
+	}
+	uint32_t bucketCount = cells.x * cells.y * cells.z;
+	size_t bucketCapacity = std::max<size_t>(1, bucketMemory / bucketCount / sizeof(Triangle));
+
+	MappedFile positionFile(positionPath);
+	MappedFile texcoordFile(texcoordPath);
+	MappedFile normalFile(normalPath);
+	const float* positions = reinterpret_cast<const float*>(positionFile.getData());
+	const float* texcoords = reinterpret_cast<const float*>(texcoordFile.getData());
+	const float* normals = reinterpret_cast<const float*>(normalFile.getData());
+
+	//第 2 步：拆三角形并按重心分桶，桶缓冲满了就作为一段追加进溢出文件
+	std::vector<std::vector<SpillBlock>> spillBlocks(bucketCount);
+	{
+		std::ifstream faces(facePath, std::ios::binary);
+		std::ifstream corners(cornerPath, std::ios::binary);
+		std::ofstream spill = openWrite(spillPath);
+		uint64_t spillSize = 0;
+		std::vector<std::vector<Triangle>> buckets(bucketCount);
+		auto flushBucket = [&](uint32_t bucket) {
+			std::vector<Triangle>& triangles = buckets[bucket];
+			uint64_t bytes = triangles.size() * sizeof(Triangle);
+			write(spill, triangles.data(), static_cast<size_t>(bytes));
+			spillBlocks[bucket].push_back({ spillSize, bytes });
+			spillSize += bytes;
+			triangles.clear();
+		};
+
+		float cellSize = longest / float(cellsOnLongest);
+		auto cellOf = [&](const glm::vec3& p) {
+			glm::vec3 t = (p - scan.bounds.min) / cellSize;
+			uint32_t x = std::min(cells.x - 1, static_cast<uint32_t>(std::max(t.x, 0.0f)));
+			uint32_t y = std::min(cells.y - 1, static_cast<uint32_t>(std::max(t.y, 0.0f)));
+			uint32_t z = std::min(cells.z - 1, static_cast<uint32_t>(std::max(t.z, 0.0f)));
+			return (z * cells.y + y) * cells.x + x;
+		};
+		auto emit = [&](const ObjIndex& a, const ObjIndex& b, const ObjIndex& c) {
+			glm::vec3 centroid = (position(positions, a.vertex) + position(positions, b.vertex) + position(positions, c.vertex)) / 3.0f;
+			uint32_t bucket = cellOf(centroid);
+			std::vector<Triangle>& triangles = buckets[bucket];
+			if (triangles.capacity() == 0)
+			{
+				triangles.reserve(bucketCapacity);
+			}
+			triangles.push_back({ { a, b, c } });
+			if (triangles.size() == bucketCapacity)
+			{
+				flushBucket(bucket);
+			}
+		};
+
+		const size_t faceBatch = readSize / sizeof(uint32_t) / 4;
+		std::vector<uint32_t> faceSizes;
+		std::vector<ObjIndex> faceCorners;
+		uint64_t remaining = scan.faceCount;
+		while (remaining > 0)
+		{
+			size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, faceBatch));
+			faceSizes.resize(count);
+			read(faces, faceSizes.data(), count * sizeof(uint32_t));
+			size_t cornerCount = 0;
+			for (uint32_t faceSize : faceSizes)
+			{
+				cornerCount += faceSize;
+			}
+			faceCorners.resize(cornerCount);
+			read(corners, faceCorners.data(), cornerCount * sizeof(ObjIndex));
+			remaining -= count;
+
+			//下标范围只有在属性全部读完之后才能检查
+			for (const ObjIndex& index : faceCorners)
+			{
+				if (index.vertex < 0 || uint64_t(index.vertex) >= scan.positionCount || index.texcoord < -1 || (index.texcoord >= 0 && uint64_t(index.texcoord) >= scan.texcoordCount)
+					|| index.normal < -1 || (index.normal >= 0 && uint64_t(index.normal) >= scan.normalCount))
+				{
+					throw std::runtime_error(sourcePath + ": failed to parse obj: face index out of range!");
+				}
+			}
+
+			const ObjIndex* face = faceCorners.data();
+			for (uint32_t faceSize : faceSizes)
+			{
+				//和 ObjParser 一样：四边形沿较短的对角线切开，更多边的按扇形拆
+				if (faceSize == 4)
+				{
+					float d02 = glm::length(position(positions, face[2].vertex) - position(positions, face[0].vertex));
+					float d13 = glm::length(position(positions, face[3].vertex) - position(positions, face[1].vertex));
+					if (d02 < d13)
+					{
+						emit(face[0], face[1], face[2]);
+						emit(face[0], face[2], face[3]);
+					}
+					else
+					{
+						emit(face[0], face[1], face[3]);
+						emit(face[1], face[2], face[3]);
+					}
+				}
+				else
+				{
+					for (uint32_t k = 2; k < faceSize; k++)
+					{
+						emit(face[0], face[k - 1], face[k]);
+					}
+				}
+				face += faceSize;
+			}
+		}
+		for (uint32_t bucket = 0; bucket < bucketCount; bucket++)
+		{
+			if (!buckets[bucket].empty())
+			{
+				flushBucket(bucket);
+			}
+		}
+	}
+
+	//第 3 步：逐桶读回，凑满一块就焊接、优化、压缩，写进分页文件再交给回调
+	VertexQuantization quantization = VertexQuantization::fromBounds(scan.bounds.min, scan.bounds.max);
+	PageHeader header{};
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.sourceTime = sourceTime(sourcePath);
+	header.sourceSize = std::filesystem::file_size(sourcePath);
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = scan.bounds.min[i];
+		header.boundsMax[i] = scan.bounds.max[i];
+	}
+
+	std::ofstream pages = openWrite(tempPagePath);
+	const std::vector<char> padding(kPageSize, 0);
+	auto pad = [&]() {
+		uint64_t position = static_cast<uint64_t>(pages.tellp());
+		write(pages, padding.data(), static_cast<size_t>(alignPage(position) - position));
+	};
+	write(pages, &header, sizeof(PageHeader));
+
+	VertexWeldTable<Vertex> weldTable(kMaxChunkVertices);
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<PackedVertex> packed;
+	std::vector<uint16_t> narrowed;
+	vertices.reserve(kMaxChunkVertices);
+	bool aborted = false;
+	auto emitChunk = [&]() {
+		if (indices.empty() || aborted)
+		{
+			return;
+		}
+		MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		vertices.resize(MeshOptimizer::optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+		packed.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			packed[i] = PackedVertex::pack(vertices[i], quantization);
+		}
+		narrowed.assign(indices.begin(), indices.end());
+
+		ChunkHeader chunkHeader{ static_cast<uint32_t>(packed.size()), static_cast<uint32_t>(narrowed.size()) };
+		pad();
+		write(pages, &chunkHeader, sizeof(ChunkHeader));
+		write(pages, packed.data(), packed.size() * sizeof(PackedVertex));
+		write(pages, narrowed.data(), narrowed.size() * sizeof(uint16_t));
+		header.chunkCount++;
+
+		StreamedChunk chunk;
+		chunk.vertices = packed.data();
+		chunk.vertexCount = chunkHeader.vertexCount;
+		chunk.indices = narrowed.data();
+		chunk.indexCount = chunkHeader.indexCount;
+		aborted = !onChunk(scan.bounds, chunk);
+
+		vertices.clear();
+		indices.clear();
+		weldTable.clear();
+	};
+
+	{
+		std::ifstream spill(spillPath, std::ios::binary);
+		std::vector<Triangle> triangles;
+		triangles.reserve(bucketCapacity);
+		for (uint32_t bucket = 0; bucket < bucketCount && !aborted; bucket++)
+		{
+			for (size_t i = 0; i < spillBlocks[bucket].size() && !aborted; i++)
+			{
+				const SpillBlock& block = spillBlocks[bucket][i];
+				triangles.resize(static_cast<size_t>(block.size / sizeof(Triangle)));
+				spill.seekg(static_cast<std::streamoff>(block.offset));
+				read(spill, triangles.data(), static_cast<size_t>(block.size));
+				for (const Triangle& triangle : triangles)
+				{
+					//块满了就先交出去，保证每块的顶点放得进 16 位索引
+					if (vertices.size() + 3 > kMaxChunkVertices)
+					{
+						emitChunk();
+						if (aborted)
+						{
+							break;
+						}
+					}
+					for (const ObjIndex& corner : triangle.corners)
+					{
+						indices.push_back(weldTable.weld(makeVertex(positions, texcoords, normals, corner), vertices));
+					}
+				}
+			}
+		}
+		emitChunk();
+	}
+
+	if (aborted)
+	{
+		return false;
+	}
+
+	//块数和文件大小最后才知道，回头补写头部，再改名成正式的分页文件
+	pad();
+	header.fileSize = static_cast<uint64_t>(pages.tellp());
+	pages.seekp(0);
+	write(pages, &header, sizeof(PageHeader));
+	pages.close();
+	std::filesystem::rename(tempPagePath, pagePath, error);
+	if (error)
+	{
+		std::cerr << "failed to write mesh pages: " << pagePath << " (" << error.message() << ")" << std::endl;
+	}
+
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::ostringstream log;
+	log << "streamed " << sourcePath << " in " << ms << " ms: " << scan.triangleCount << " triangles in " << header.chunkCount << " chunks, "
+		<< bucketCount << " buckets, budget " << memoryBudget / (1024 * 1024) << " MB\n";
+	std::cout << log.str() << std::flush;
+	return true;
+}
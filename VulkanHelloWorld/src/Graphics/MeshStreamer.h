@@ -0,0 +1,38 @@
+﻿#pragma once
+#include "../Vertex.h"
+#include "MeshCache.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 流式导入产出的一块几何：已经焊接、优化、压缩，顶点数不超过 MeshStreamer::kMaxChunkVertices，索引是 16 位的
+// 指针只在回调期间有效
+struct StreamedChunk
+{
+	const PackedVertex* vertices = nullptr;
+	uint32_t vertexCount = 0;
+	const uint16_t* indices = nullptr;
+	uint32_t indexCount = 0;
+};
+
+// 比内存还大的 OBJ（摄影测量扫描之类）的流式导入，内存占用由 memoryBudget 封顶，和网格大小无关：
+// 1. 按块读源文件，属性和面原样追加进磁盘上的临时文件，顺便算包围盒
+// 2. 映射属性文件，逐个面拆三角形，按重心所在的空间格子分桶，每个桶攒满一个缓冲就作为一段写进溢出文件
+// 3. 逐桶读回，凑满一块就焊接、优化、压缩，写进分页文件并交给回调，调用方可以立刻上传
+// 焊接只在块内做，块边界上的顶点会重复；只有第 0 级，不生成 LOD 和 meshlet
+// 分页文件放在 cache/meshes 下，源文件大小和修改时间都没变时直接按块回放（几十 GB 的源文件不再算内容哈希）
+class MeshStreamer
+{
+public:
+	static constexpr uint32_t kMaxChunkVertices = 65536;
+	static constexpr uint32_t kVersion = 1;
+	//预算再小也按这个算，低于它分桶和读缓冲都小得没有意义
+	static constexpr size_t kMinMemoryBudget = 64ull * 1024 * 1024;
+
+	//bounds 是整个网格的包围盒（量化用），每块都一样；返回 false 时中止导入
+	using ChunkCallback = std::function<bool(const MeshBounds& bounds, const StreamedChunk& chunk)>;
+	//onChunk 在当前线程上按块完成的顺序回调；被回调中止时返回 false，不留下分页文件
+	static bool ingest(const std::string& sourcePath, size_t memoryBudget, const ChunkCallback& onChunk);
+
+	static std::string getPagePath(const std::string& sourcePath);
+};
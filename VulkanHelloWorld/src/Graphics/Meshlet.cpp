@@ -0,0 +1,166 @@
+﻿#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//法线锥最小夹角余弦低于这个值时，锥太宽，剔除几乎不会成功，直接不剔除
+	constexpr float kMinConeSpread = 0.1f;
+
+	void computeBounds(Meshlet& meshlet, const uint32_t* indices, const float* positions, size_t positionStride)
+	{
+		auto position = [&](uint32_t v) {
+			const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+
+		const uint32_t* begin = indices + meshlet.indexOffset;
+		glm::vec3 min = position(begin[0]);
+		glm::vec3 max = min;
+		for (uint32_t i = 0; i < meshlet.indexCount; i++)
+		{
+			min = glm::min(min, position(begin[i]));
+			max = glm::max(max, position(begin[i]));
+		}
+		meshlet.center = (min + max) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.indexCount; i++)
+		{
+			meshlet.radius = std::max(meshlet.radius, glm::length(position(begin[i]) - meshlet.center));
+		}
+
+		//法线锥：轴是各三角形法线的平均，张角由偏得最远的法线决定
+		glm::vec3 axis(0.0f);
+		uint32_t triangleCount = meshlet.indexCount / 3;
+		std::vector<glm::vec3> normals(triangleCount, glm::vec3(0.0f));
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			glm::vec3 p0 = position(begin[t * 3 + 0]);
+			glm::vec3 normal = glm::cross(position(begin[t * 3 + 1]) - p0, position(begin[t * 3 + 2]) - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals[t] = normal / length;
+				axis += normals[t];
+			}
+		}
+
+		meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneCutoff = 1.0f;
+		float axisLength = glm::length(axis);
+		if (axisLength <= 0.0f)
+		{
+			return;
+		}
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals)
+		{
+			if (normal != glm::vec3(0.0f))
+			{
+				minDot = std::min(minDot, glm::dot(axis, normal));
+			}
+		}
+		meshlet.coneAxis = axis;
+		if (minDot <= kMinConeSpread)
+		{
+			return;
+		}
+
+		//锥顶沿轴往后退，保证每个三角形所在的平面都在锥顶前面，用锥顶代替簇里任意一点做背面判断是保守的
+		float maxT = 0.0f;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			if (normals[t] == glm::vec3(0.0f))
+			{
+				continue;
+			}
+			glm::vec3 p0 = position(begin[t * 3 + 0]);
+			float t0 = glm::dot(meshlet.center - p0, normals[t]) / glm::dot(axis, normals[t]);
+			maxT = std::max(maxT, t0);
+		}
+		meshlet.coneApex = meshlet.center - axis * maxT;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> MeshletBuilder::build(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount)
+{
+	std::vector<Meshlet> meshlets;
+	//记录每个顶点最后一次被哪个簇用到，判断是不是新顶点不需要清空
+	std::vector<uint32_t> lastMeshlet(vertexCount, ~0u);
+	Meshlet current;
+	uint32_t currentVertices = 0;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32_t meshletId = static_cast<uint32_t>(meshlets.size());
+		uint32_t newVertices = 0;
+		for (size_t k = 0; k < 3; k++)
+		{
+			//同一个三角形里重复的顶点只算一次
+			bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+			if (!repeated && lastMeshlet[indices[i + k]] != meshletId)
+			{
+				newVertices++;
+			}
+		}
+
+		if (current.indexCount > 0 && (currentVertices + newVertices > kMaxVertices || current.indexCount / 3 + 1 > kMaxTriangles))
+		{
+			meshlets.push_back(current);
+			meshletId++;
+			current = Meshlet{};
+			current.indexOffset = static_cast<uint32_t>(i);
+			currentVertices = 0;
+		}
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			if (lastMeshlet[indices[i + k]] != meshletId)
+			{
+				lastMeshlet[indices[i + k]] = meshletId;
+				currentVertices++;
+			}
+		}
+		current.indexCount += 3;
+	}
+	if (current.indexCount > 0)
+	{
+		meshlets.push_back(current);
+	}
+
+	for (Meshlet& meshlet : meshlets)
+	{
+		computeBounds(meshlet, indices, positions, positionStride);
+	}
+	return meshlets;
+}
+
+uint32_t MeshletBuilder::cull(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces,
+	std::vector<uint32_t>& visible)
+{
+	visible.clear();
+	for (uint32_t i = 0; i < meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		if (!frustum.intersectsSphere(meshlet.center, meshlet.radius))
+		{
+			continue;
+		}
+		//从锥顶看过去，视线和轴的夹角足够小时簇里所有三角形都是背面
+		if (cullBackfaces && meshlet.coneCutoff < 1.0f)
+		{
+			glm::vec3 view = meshlet.coneApex - cameraPosition;
+			float length = glm::length(view);
+			if (length > 0.0f && glm::dot(view / length, meshlet.coneAxis) >= meshlet.coneCutoff)
+			{
+				continue;
+			}
+		}
+		visible.push_back(i);
+	}
+	return static_cast<uint32_t>(visible.size());
+}
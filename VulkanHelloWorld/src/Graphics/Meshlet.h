@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+// 一个簇：第 0 级 LOD 索引里连续的一段三角形，顶点数和三角形数都有上限
+// 包围球用来做视锥剔除，法线锥用来整簇剔除背面（coneCutoff 为 1 表示法线太分散，不能剔除）
+struct Meshlet
+{
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	glm::vec3 coneApex = glm::vec3(0.0f);
+	float coneCutoff = 1.0f;
+	glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+};
+
+// 构建和剔除都是纯 CPU、确定性的代码，不依赖 Vulkan
+class MeshletBuilder
+{
+public:
+	//和 NVIDIA 推荐的 mesh shader 上限一致，以后接 mesh shader 时可以直接用
+	static constexpr uint32_t kMaxVertices = 64;
+	static constexpr uint32_t kMaxTriangles = 124;
+
+	//按索引顺序切分，不重排三角形：索引最好先做过顶点缓存优化，相邻的三角形在空间上也相邻
+	static std::vector<Meshlet> build(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount);
+
+	//frustum 和 cameraPosition 都是模型空间的；把可见簇的下标按顺序写进 visible，返回可见簇的数量
+	static uint32_t cull(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces,
+		std::vector<uint32_t>& visible);
+};
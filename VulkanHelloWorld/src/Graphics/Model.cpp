@@ -1,154 +1,420 @@
 #include "Model.h"
-#include <tiny_obj_loader.h>
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "GlbLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
 #include <stdexcept>
-#include "../Buffer.h"
 
-Model::Model(Devices& device, const std::string path) : m_device(device)
+Model::Model(Devices& device, std::shared_ptr<GeometryPool> pool, const std::string path) : m_device(device), m_pool(pool)
 {
-	this->loadModel(path);
-	createVertexBuffer();
-	createIndexBuffer();
-	m_vertices.clear();
-	m_vertices.shrink_to_fit();
-	m_indexCount = static_cast<uint32_t>(m_indices.size());
-	m_indices.clear();
-	m_indices.shrink_to_fit();
+	std::unique_ptr<ModelData> data = load(path);
+	uint32_t part = allocate(*data);
+	//顶点和索引在几何池里各切一段，一起提交上传；数据已经拷进staging环，CPU侧不用等GPU就可以丢掉
+	UploadBatch batch(m_device);
+	upload(batch, *data, part);
+	setReady(batch.submit());
 }
 
-void Model::bind(VkCommandBuffer cmdbuff)
+Model::Model(Devices& device, std::shared_ptr<GeometryPool> pool) : m_device(device), m_pool(pool)
 {
-	std::vector<VkBuffer> vertexbuffers = { m_vertexBuffer };
-	std::vector<VkDeviceSize> offsets = { 0 };
+}
 
-	vkCmdBindVertexBuffers(cmdbuff, 0, 1, vertexbuffers.data(), offsets.data());
+std::unique_ptr<ModelData> Model::load(const std::string& path)
+{
+	auto start = std::chrono::high_resolution_clock::now();
 
-	vkCmdBindIndexBuffer(cmdbuff, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	std::unique_ptr<ModelData> data = std::make_unique<ModelData>();
+	data->path = path;
+	//GLB 本身就是二进制的，不经过网格缓存
+	if (GlbLoader::isGlb(path))
+	{
+		GlbLoader::load(path, *data);
+	}
+	else
+	{
+		//有缓存时直接从映射内存拷进 staging，不解析、不经过中间的 vector
+		data->cache = MeshCache::open(path, sizeof(PackedVertex));
+		if (data->cache)
+		{
+			data->bounds = data->cache->getBounds();
+			data->quantization = VertexQuantization::fromBounds(data->bounds.min, data->bounds.max);
+			data->lods = data->cache->getLods();
+			data->meshlets = data->cache->getMeshlets();
+			if (data->lods.empty())
+			{
+				data->lods.push_back({ 0, data->cache->getIndexCount(), 0.0f });
+			}
+		}
+		else
+		{
+			loadModel(*data);
+		}
+	}
+
+	//可能在后台线程里，整行拼好再一次输出，免得和别的线程交错
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::ostringstream log;
+	log << "loaded " << path << (data->cache ? " from mesh cache" : "") << " in " << ms << " ms, " << data->lods.size() << " LODs:";
+	for (const MeshLod& lod : data->lods)
+	{
+		log << " " << lod.indexCount / 3;
+	}
+	log << " triangles, " << data->meshlets.size() << " meshlets";
+	if (!data->submeshes.empty())
+	{
+		log << ", " << data->submeshes.size() << " submeshes";
+	}
+	log << "\n";
+	std::cout << log.str() << std::flush;
+	return data;
 }
 
-void Model::draw(VkCommandBuffer cmdbuff)
+uint32_t Model::allocate(const ModelData& data)
 {
-	vkCmdDrawIndexed(cmdbuff, m_indexCount, 1, 0, 0, 0);
+	//GLB 的索引类型取决于最大的子网格，不是整个模型的顶点数
+	if (!data.submeshes.empty())
+	{
+		m_parts.push_back(m_pool->allocate(data.getVertexCount(), data.getIndexCount(), data.indexType));
+	}
+	else
+	{
+		m_parts.push_back(m_pool->allocate(data.getVertexCount(), data.getIndexCount()));
+	}
+	return static_cast<uint32_t>(m_parts.size() - 1);
 }
 
-void Model::loadModel(const std::string path)
+void Model::upload(UploadBatch& batch, const ModelData& data, uint32_t part)
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
-
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
-		throw std::runtime_error(warn + err);
+	setMetadata(data);
+	if (!data.submeshes.empty())
+	{
+		//和引擎布局一致的 GLB，sources 指向映射的文件，整段拷进 staging
+		for (size_t i = 0; i < data.submeshes.size(); i++)
+		{
+			const Submesh& submesh = data.submeshes[i];
+			m_pool->writeVertices(batch, m_parts[part], static_cast<uint32_t>(submesh.vertexOffset), data.sources[i].vertices, submesh.vertexCount);
+			m_pool->writeIndices(batch, m_parts[part], submesh.firstIndex, data.sources[i].indices, submesh.indexCount);
+		}
+		return;
 	}
+	m_pool->write(batch, m_parts[part], data.getVertices(), data.getIndices());
+	if (data.chunk)
+	{
+		//分块只累加第 0 级的索引数，用来统计三角形
+		if (m_lods.empty())
+		{
+			m_lods.push_back({ 0, 0, 0.0f });
+		}
+		m_lods[0].indexCount += data.getIndexCount();
+	}
+}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
+void Model::uploadLod(UploadBatch& batch, const ModelData& data, uint32_t part, uint32_t lod)
+{
+	if (lod + 1 == data.lods.size())
+	{
+		setMetadata(data);
+	}
+	else
+	{
+		//补传发生在分配之后的某一帧，期间池可能被碎片整理搬过
+		m_pool->settleRelocation();
+	}
+	//这一级用到的顶点是前 vertexCount 个，更粗的几级已经传了前面一段，只补上新增的部分；第 0 级把剩下的全部补齐
+	auto levelVertices = [&](uint32_t level) {
+		return level == 0 || data.lods[level].vertexCount == 0 ? data.getVertexCount() : data.lods[level].vertexCount;
+	};
+	uint32_t firstVertex = lod + 1 < data.lods.size() ? levelVertices(lod + 1) : 0;
+	uint32_t vertexEnd = levelVertices(lod);
+	const MeshLod& level = data.lods[lod];
+	const PackedVertex* vertices = static_cast<const PackedVertex*>(data.getVertices());
+	if (vertexEnd > firstVertex)
+	{
+		m_pool->writeVertices(batch, m_parts[part], firstVertex, vertices + firstVertex, vertexEnd - firstVertex);
+	}
+	m_pool->writeNarrowedIndices(batch, m_parts[part], level.indexOffset, data.getIndices() + level.indexOffset, level.indexCount);
+	m_availableLod = lod;
+}
 
-			// 1. ץȡλ (XYZ)
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+void Model::setMetadata(const ModelData& data)
+{
+	m_path = data.path;
+	m_bounds = data.bounds;
+	m_quantization = data.quantization;
+	m_availableLod = 0;
+	if (data.chunk)
+	{
+		return;
+	}
+	m_lods = data.lods;
+	m_meshlets = data.meshlets;
+	m_submeshes = data.submeshes;
+	m_materials = data.materials;
+}
 
-			// 2. ץȡ UV  (ע⣺Vulkan  V  OBJ ʽµߵģ)
-			if (index.texcoord_index >= 0) {
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
-			}
+void Model::setReady(UploadToken token)
+{
+	//上传和之后的绘制在同一个图形队列上按提交顺序执行，不用等 token 完成就可以画
+	m_uploadToken = token;
+	m_pool->trackUpload(token);
+	m_ready = true;
+}
 
-			// 3. ץȡ 
-			if (index.normal_index >= 0) {
-				vertex.normal = {
-					attrib.normals[3 * index.normal_index + 0],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 2]
-				};
-			}
+void Model::unload()
+{
+	m_ready = false;
+	releaseParts();
+}
 
-			// 4. ɫ 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
+void Model::draw(VkCommandBuffer cmdbuff, uint32_t lod)
+{
+	if (!m_submeshes.empty())
+	{
+		for (uint32_t i = 0; i < m_submeshes.size(); i++)
+		{
+			drawSubmesh(cmdbuff, i);
+		}
+		return;
+	}
+	//流式导入的模型只有第 0 级，各块整块依次画
+	if (m_parts.size() > 1)
+	{
+		for (const GeometryRange& part : m_parts)
+		{
+			vkCmdDrawIndexed(cmdbuff, part.indexCount, 1, part.firstIndex, part.vertexOffset, 0);
+		}
+		return;
+	}
+	//几何池已经在 pass 开头绑定过，这里只用偏移区分模型和 LOD；还没传上来的细节退到已有的最细一级
+	const GeometryRange& range = m_parts[0];
+	const MeshLod& level = m_lods[std::min(std::max(lod, m_availableLod), getLodCount() - 1)];
+	vkCmdDrawIndexed(cmdbuff, level.indexCount, 1, range.firstIndex + level.indexOffset, range.vertexOffset, 0);
+}
 
-			// 5. ϣȥУ
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-				m_vertices.push_back(vertex);
-			}
+void Model::drawSubmesh(VkCommandBuffer cmdbuff, uint32_t submesh)
+{
+	const GeometryRange& range = m_parts[0];
+	const Submesh& part = m_submeshes[submesh];
+	vkCmdDrawIndexed(cmdbuff, part.indexCount, 1, range.firstIndex + part.firstIndex, range.vertexOffset + part.vertexOffset, 0);
+}
 
-			m_indices.push_back(uniqueVertices[vertex]);
+uint32_t Model::drawMeshlets(VkCommandBuffer cmdbuff, const std::vector<uint32_t>& visible)
+{
+	uint32_t indexCount = 0;
+	size_t i = 0;
+	while (i < visible.size())
+	{
+		const Meshlet& first = m_meshlets[visible[i]];
+		uint32_t runCount = first.indexCount;
+		size_t next = i + 1;
+		//簇在索引里是首尾相接的，下标连续的可见簇就是一段连续的索引
+		while (next < visible.size() && visible[next] == visible[next - 1] + 1)
+		{
+			runCount += m_meshlets[visible[next]].indexCount;
+			next++;
 		}
+		vkCmdDrawIndexed(cmdbuff, runCount, 1, m_parts[0].firstIndex + first.indexOffset, m_parts[0].vertexOffset, 0);
+		indexCount += runCount;
+		i = next;
 	}
+	return indexCount / 3;
 }
 
-void Model::createVertexBuffer()
+void Model::loadModel(ModelData& data)
 {
-	VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
+	//内存映射 + 多线程解析，面已经拆成三角形
+	ObjMesh mesh = ObjParser::load(data.path);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	//焊接表按角点数预留，整个过程不会扩容；每个角点只探测一次
+	VertexWeldTable<Vertex> weldTable(mesh.indices.size());
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t>& indices = data.indices;
+	vertices.reserve(mesh.indices.size() / 4);
+	indices.reserve(mesh.indices.size());
+	for (const ObjIndex& index : mesh.indices) {
+		indices.push_back(weldTable.weld(makeVertex(mesh, index), vertices));
+	}
 
-	//buffer
-	Buffer::createBuffer(m_device.getLogicalDevice(), m_device.getPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	optimizeMesh(data.path, vertices, indices);
 
-	void* data;
-	vkMapMemory(m_device.getLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_device.getLogicalDevice(), stagingBufferMemory);
+	MeshBounds& bounds = data.bounds;
+	if (!vertices.empty())
+	{
+		bounds.min = bounds.max = vertices[0].pos;
+	}
+	for (const Vertex& vertex : vertices)
+	{
+		bounds.min = glm::min(bounds.min, vertex.pos);
+		bounds.max = glm::max(bounds.max, vertex.pos);
+	}
 
-	//vertex buffer
-	Buffer::createBuffer(m_device.getLogicalDevice(), m_device.getPhysicalDevice(),bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
+	generateLods(vertices, bounds, indices, data.lods);
+	orderVerticesByLod(vertices, indices, data.lods);
 
-	Buffer::copyBuffer(m_device.getLogicalDevice(), m_device.getCommandPool(), m_device.getGraphicsQueue(), stagingBuffer, m_vertexBuffer, bufferSize);
-	vkDestroyBuffer(m_device.getLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(m_device.getLogicalDevice(), stagingBufferMemory, nullptr);
+	//第 0 级是原始网格（已经按顶点缓存排过序），按顺序切成簇；三角形太少的模型整体剔除就够了
+	constexpr uint32_t kMinMeshletTriangles = 1024;
+	if (data.lods[0].indexCount / 3 >= kMinMeshletTriangles)
+	{
+		data.meshlets = MeshletBuilder::build(indices.data(), data.lods[0].indexCount, &vertices[0].pos.x, sizeof(Vertex), vertices.size());
+	}
+
+	//按包围盒量化成 20 字节的顶点，缓存里存的也是压缩后的
+	data.quantization = VertexQuantization::fromBounds(bounds.min, bounds.max);
+	data.vertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		data.vertices[i] = PackedVertex::pack(vertices[i], data.quantization);
+	}
+
+	MeshCache::write(data.path, data.vertices.data(), sizeof(PackedVertex), static_cast<uint32_t>(data.vertices.size()),
+		indices.data(), static_cast<uint32_t>(indices.size()), bounds, data.lods, data.meshlets);
 }
 
-void Model::createIndexBuffer()
+void Model::optimizeMesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
 {
-	VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
+	//焊接后、写缓存前做一次，优化过的顺序会进网格缓存，缓存命中时不用再算
+	if (indices.empty())
+	{
+		return;
+	}
+	VertexCacheStats before = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	std::vector<uint32_t> clusters;
+	MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertices.size(), &clusters);
+	MeshOptimizer::optimizeOverdraw(indices.data(), indices.size(), &vertices[0].pos.x, sizeof(Vertex), vertices.size(), clusters);
+	vertices.resize(MeshOptimizer::optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
 
-	//buffer
-	Buffer::createBuffer(m_device.getLogicalDevice(), m_device.getPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	VertexCacheStats after = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	std::ostringstream log;
+	log << "mesh optimized " << path << ": ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << " (" << clusters.size() << " clusters)\n";
+	std::cout << log.str() << std::flush;
+}
 
-	void* data;
-	vkMapMemory(m_device.getLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_device.getLogicalDevice(), stagingBufferMemory);
+void Model::generateLods(const std::vector<Vertex>& vertices, const MeshBounds& bounds, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+	//每一级目标是上一级的一半，误差上限是包围盒对角线的 5%；三角形太少或者简化不动了就停
+	constexpr uint32_t kMaxLods = 6;
+	constexpr size_t kMinTriangles = 64;
+	constexpr float kMaxRelativeError = 0.05f;
 
-	Buffer::createBuffer(m_device.getLogicalDevice(), m_device.getPhysicalDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
-	Buffer::copyBuffer(m_device.getLogicalDevice(), m_device.getCommandPool(), m_device.getGraphicsQueue(), stagingBuffer, m_indexBuffer, bufferSize);
-	vkDestroyBuffer(m_device.getLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(m_device.getLogicalDevice(), stagingBufferMemory, nullptr);
-}
+	uint32_t baseCount = static_cast<uint32_t>(indices.size());
+	lods.assign(1, { 0, baseCount, 0.0f });
+	if (vertices.empty())
+	{
+		return;
+	}
 
+	float maxError = glm::length(bounds.max - bounds.min) * kMaxRelativeError;
+	size_t targetCount = baseCount;
+	while (lods.size() < kMaxLods && lods.back().indexCount / 3 > kMinTriangles)
+	{
+		//都从原始网格简化，误差是相对原始网格的，不会一级一级累积
+		targetCount = targetCount / 2 / 3 * 3;
+		float error = 0.0f;
+		std::vector<uint32_t> lod = MeshSimplifier::simplify(indices.data(), baseCount, &vertices[0].pos.x, sizeof(Vertex), vertices.size(),
+			targetCount, maxError, error);
+		if (lod.size() > lods.back().indexCount * 9 / 10)
+		{
+			break;
+		}
 
-Model::~Model()
+		MeshOptimizer::optimizeVertexCache(lod.data(), lod.size(), vertices.size());
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()), std::max(error, lods.back().error) });
+		indices.insert(indices.end(), lod.begin(), lod.end());
+	}
+}
+
+void Model::orderVerticesByLod(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
 {
-	if (m_indexBuffer != VK_NULL_HANDLE)
+	//从最粗的一级开始按首次使用编号，每一级新用到的顶点接在前面几级后面；级内保持首次使用的顺序，顶点读取的局部性不变
+	constexpr uint32_t kUnassigned = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), kUnassigned);
+	uint32_t next = 0;
+	for (size_t level = lods.size(); level-- > 0;)
 	{
-		vkDestroyBuffer(m_device.getLogicalDevice(), m_indexBuffer, nullptr);
+		MeshLod& lod = lods[level];
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i++)
+		{
+			if (remap[indices[i]] == kUnassigned)
+			{
+				remap[indices[i]] = next++;
+			}
+			indices[i] = remap[indices[i]];
+		}
+		lod.vertexCount = next;
 	}
 
-	if (m_indexBufferMemory != VK_NULL_HANDLE)
+	//第 0 级没用到的顶点（优化时已经删掉了，理论上没有）放在最后
+	std::vector<Vertex> ordered(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
 	{
-		vkFreeMemory(m_device.getLogicalDevice(), m_indexBufferMemory, nullptr);
+		if (remap[i] == kUnassigned)
+		{
+			remap[i] = next++;
+		}
+		ordered[remap[i]] = vertices[i];
 	}
+	vertices.swap(ordered);
+}
 
-	if (m_vertexBuffer != VK_NULL_HANDLE)
-	{
-		vkDestroyBuffer(m_device.getLogicalDevice(), m_vertexBuffer, nullptr);
+Vertex Model::makeVertex(const ObjMesh& mesh, const ObjIndex& index)
+{
+	Vertex vertex{};
+
+	// 1. 抓取位置 (XYZ)
+	vertex.pos = {
+		mesh.positions[3 * index.vertex + 0],
+		mesh.positions[3 * index.vertex + 1],
+		mesh.positions[3 * index.vertex + 2]
+	};
+
+	// 2. 抓取 UV 坐标 (注意：Vulkan 的 V 轴和 OBJ 格式是上下颠倒的！)
+	if (index.texcoord >= 0) {
+		vertex.texCoord = {
+			mesh.texcoords[2 * index.texcoord + 0],
+			1.0f - mesh.texcoords[2 * index.texcoord + 1]
+		};
+	}
+
+	// 3. 抓取法线 
+	if (index.normal >= 0) {
+		vertex.normal = {
+			mesh.normals[3 * index.normal + 0],
+			mesh.normals[3 * index.normal + 1],
+			mesh.normals[3 * index.normal + 2]
+		};
 	}
 
-	if (m_vertexBufferMemory != VK_NULL_HANDLE)
+	// 4. 颜色 
+	vertex.color = { 1.0f, 1.0f, 1.0f };
+	return vertex;
+}
+
+Model::~Model()
+{
+	releaseParts();
+}
+
+void Model::releaseParts()
+{
+	//在途的帧可能还在读这段顶点/索引，延迟到这些帧结束再把区间还给几何池
+	if (m_parts.empty())
 	{
-		vkFreeMemory(m_device.getLogicalDevice(), m_vertexBufferMemory, nullptr);
+		return;
 	}
+	std::shared_ptr<GeometryPool> pool = m_pool;
+	std::vector<GeometryRange> parts = std::move(m_parts);
+	m_parts.clear();
+	m_device.getDeletionQueue().push([pool, parts]() {
+		for (const GeometryRange& part : parts)
+		{
+			pool->free(part);
+		}
+	});
 }
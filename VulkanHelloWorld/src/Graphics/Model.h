@@ -1,37 +1,164 @@
-#pragma once
+﻿#pragma once
 #include "../Vertex.h"
 #include "../Core/Devices.h"
+#include "GeometryPool.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
 #include <vector>
 #include <string>
+#include <memory>
 #include <vulkan/vulkan.h>
 
+// 一个子网格（GLB 的一个图元）在模型区间里的位置，索引相对 vertexOffset；material 是 ModelData::materials 的下标
+struct Submesh
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	int32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t material = 0;
+};
+
+// 子网格的数据从哪拷：直接指向映射的文件，或者指向 ModelData 里转换好的数组；索引已经是模型的索引类型
+struct SubmeshSource
+{
+	const void* vertices = nullptr;
+	const void* indices = nullptr;
+};
+
+// 模型文件自带的材质（目前只有 GLB 有）：基础色贴图是原样的 PNG/JPG 字节，没有贴图时用 baseColor
+struct ModelMaterial
+{
+	glm::vec4 baseColor = glm::vec4(1.0f);
+	std::vector<unsigned char> image;
+};
+
+// 一个模型在 CPU 端准备好的全部数据，不碰任何 Vulkan 对象，可以在后台线程里生成
+// 有缓存时顶点和索引直接指向映射内存，否则指向刚解析、优化、压缩好的数组
+struct ModelData
+{
+	std::string path;
+	std::unique_ptr<MeshCacheView> cache;
+	std::vector<PackedVertex> vertices;
+	std::vector<uint32_t> indices;
+	MeshBounds bounds;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	VertexQuantization quantization; // 顶点位置的量化参数，一般由 bounds 得到，GLB 直接拷贝时来自节点变换
+	bool chunk = false; // 流式导入的一块：追加成模型的一个分块，bounds 是整个模型的
+
+	//GLB：每个图元一个子网格，按 sources 逐个拷贝；16 位的模型转换出来的索引放在 indices16 里
+	std::vector<Submesh> submeshes;
+	std::vector<SubmeshSource> sources;
+	std::vector<uint16_t> indices16;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+	std::vector<ModelMaterial> materials;
+	std::unique_ptr<MappedFile> file; // sources 可能指向这里，要活到上传完成
+
+	const void* getVertices() const { return cache ? cache->getVertices() : vertices.data(); }
+	const uint32_t* getIndices() const { return cache ? cache->getIndices() : indices.data(); }
+	uint32_t getVertexCount() const
+	{
+		if (!submeshes.empty())
+		{
+			return static_cast<uint32_t>(submeshes.back().vertexOffset) + submeshes.back().vertexCount;
+		}
+		return cache ? cache->getVertexCount() : static_cast<uint32_t>(vertices.size());
+	}
+	uint32_t getIndexCount() const
+	{
+		if (!submeshes.empty())
+		{
+			return submeshes.back().firstIndex + submeshes.back().indexCount;
+		}
+		return cache ? cache->getIndexCount() : static_cast<uint32_t>(indices.size());
+	}
+};
+
+// 顶点和索引放在场景共用的几何池里，Model 只记录自己的区间
+// 加载时用 QEM 生成一串 LOD，所有 LOD 共用同一段顶点，索引依次排在模型自己的索引区间里
+// 三角形够多的模型还会把第 0 级切成 meshlet，画第 0 级时可以按簇剔除
+// 渐进加载：先只传最粗的一级（它用到的顶点在最前面），之后每次 uploadLod 补上更细的一级，draw 总是画已经传上去的最细的一级
+// 加载分成两半：load 只做 CPU 的活，可以放在后台线程；allocate/upload 在主线程把数据放进几何池，之后 isReady 才为真
+// GLB 模型由若干子网格组成（共用一段区间，各有自己的材质），没有 LOD 和 meshlet，draw 依次画所有子网格
+// 流式导入的模型由很多分块组成（每块一段区间，都是 16 位索引），只有第 0 级，第一块传完就开始画，之后的块陆续补上
 class Model
 {
 public:
-	Model(Devices& device, const std::string path);
+	//同步加载，返回时已经可以绘制
+	Model(Devices& device, std::shared_ptr<GeometryPool> pool, const std::string path);
+	//只占个位置，数据由后台加载好后交给 allocate/upload
+	Model(Devices& device, std::shared_ptr<GeometryPool> pool);
 	~Model();
 
 	Model(const Model&) = delete;
 	Model& operator=(const Model&) = delete;
-	uint32_t getIndexCnt()  const { return m_indexCount; }
+	bool isReady() const { return m_ready; }
+	//加载时的源文件路径，静态合批据此重新读出 CPU 端的顶点
+	const std::string& getPath() const { return m_path; }
+	uint32_t getIndexCnt()  const { return m_lods[0].indexCount; }
+	//流式导入的模型返回第一块的，各块的索引类型相同
+	const GeometryRange& getRange() const { return m_parts[0]; }
+	uint32_t getPartCount() const { return static_cast<uint32_t>(m_parts.size()); }
+	UploadToken getUploadToken() const { return m_uploadToken; }
+	const MeshBounds& getBounds() const { return m_bounds; }
+	//顶点位置是按包围盒量化过的，绘制时乘在模型矩阵右边
+	glm::mat4 getDequantMatrix() const { return m_quantization.getDequantMatrix(); }
 
-	void bind(VkCommandBuffer cmdbuff);
-	void draw(VkCommandBuffer cmdbuff);
+	const std::vector<MeshLod>& getLods() const { return m_lods; }
+	uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+	//已经上传的最细的一级，渐进加载完成（或者一次性上传）时是 0；比它更细的 LOD 画的时候会退到这一级
+	uint32_t getAvailableLod() const { return m_availableLod; }
+	const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+	const std::vector<Submesh>& getSubmeshes() const { return m_submeshes; }
+	const std::vector<ModelMaterial>& getMaterials() const { return m_materials; }
 
-private:
-	std::vector<Vertex> m_vertices;
-	std::vector<uint32_t> m_indices;
-	uint32_t m_indexCount;
-	Devices& m_device;
+	void draw(VkCommandBuffer cmdbuff, uint32_t lod = 0);
+	void drawSubmesh(VkCommandBuffer cmdbuff, uint32_t submesh);
+	//只画 visible 里的簇（第 0 级），下标要升序，相邻的簇合并成一次 draw；返回画了多少三角形
+	uint32_t drawMeshlets(VkCommandBuffer cmdbuff, const std::vector<uint32_t>& visible);
+
+	//读缓存或者解析 OBJ、焊接、优化、生成 LOD 和 meshlet、压缩顶点，没有缓存时顺手写出缓存；.glb 交给 GlbLoader；线程安全
+	static std::unique_ptr<ModelData> load(const std::string& path);
+	//主线程调用：先在几何池里切区间，再把数据录进 batch；一批里有多个模型时要先全部 allocate 再逐个 upload
+	//allocate 返回分块的下标，upload 时原样传回
+	uint32_t allocate(const ModelData& data);
+	void upload(UploadBatch& batch, const ModelData& data, uint32_t part);
+	//渐进加载：只上传第 lod 级新用到的顶点和它的索引，要从最粗的一级开始、每次细一级；区间在 allocate 时已经按完整模型切好
+	void uploadLod(UploadBatch& batch, const ModelData& data, uint32_t part, uint32_t lod);
+	//batch 提交之后调用，从这一帧开始参与绘制
+	void setReady(UploadToken token);
+	//流式导入中途失败时调用：不再参与绘制，已经切好的区间等在途的帧结束后还给几何池
+	void unload();
 
-	VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+	//OBJ 的一个角点展开成完整顶点，焊接前的形式
+	static Vertex makeVertex(const ObjMesh& mesh, const ObjIndex& index);
 
-	VkBuffer m_indexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
+private:
+	Devices& m_device;
+	std::shared_ptr<GeometryPool> m_pool;
+	std::string m_path;
+	std::vector<GeometryRange> m_parts; // 普通模型只有一块
+	bool m_ready = false;
+	UploadToken m_uploadToken = 0;
+	MeshBounds m_bounds;
+	VertexQuantization m_quantization;
+	std::vector<MeshLod> m_lods;
+	uint32_t m_availableLod = 0;
+	std::vector<Meshlet> m_meshlets;
+	std::vector<Submesh> m_submeshes;
+	std::vector<ModelMaterial> m_materials;
 
-	void loadModel(const std::string path);
-	void createVertexBuffer();
-	void createIndexBuffer();
+	//没有可用缓存时走这里：解析 OBJ、焊接顶点、优化、压缩成 PackedVertex，并顺手写出缓存
+	static void loadModel(ModelData& data);
+	//三角形按顶点缓存重排、按簇朝向减少 overdraw、顶点按首次使用重排，并打印前后的 ACMR/ATVR
+	static void optimizeMesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	//在优化过的原始网格后面依次追加各级简化后的索引，填好 lods
+	static void generateLods(const std::vector<Vertex>& vertices, const MeshBounds& bounds, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+	//顶点按最早被哪一级用到重排（粗的在前），填好每一级的 vertexCount
+	static void orderVerticesByLod(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+	//渐进上传第一级之前，把模型级的数据（包围盒、LOD 表、meshlet）记下来
+	void setMetadata(const ModelData& data);
+	void releaseParts();
 
 };
@@ -0,0 +1,436 @@
+﻿#include "ObjParser.h"
+#include "../Core/MappedFile.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OBJ_PARSER_SSE2 1
+#endif
+
+namespace
+{
+	//每块至少这么大，小文件开线程反而更慢
+	constexpr size_t kMinChunkSize = 1024 * 1024;
+
+	//块内的角点：负数（相对）下标解析时还不知道前面各块有多少属性，先记成块内位置（可能是负数），
+	//relativeMask 对应位置 1，合并时再加上前面各块的数量
+	struct RawIndex
+	{
+		int32_t value[3] = { -1, -1, -1 };
+		uint8_t relativeMask = 0;
+	};
+
+	const char* findNewline(const char* p, const char* end)
+	{
+#ifdef OBJ_PARSER_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		while (end - p >= 16)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+			if (mask != 0)
+			{
+				return p + std::countr_zero(mask);
+			}
+			p += 16;
+		}
+#endif
+		const void* found = memchr(p, '\n', static_cast<size_t>(end - p));
+		return found ? static_cast<const char*>(found) : end;
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+		std::vector<float> positions;
+		std::vector<float> texcoords;
+		std::vector<float> normals;
+		std::vector<RawIndex> corners;   // 所有面的角点连续存放
+		std::vector<uint32_t> faceSizes; // 每个面的角点数
+		size_t triangleCount = 0;
+		std::string error;
+	};
+
+	class ChunkParser
+	{
+	public:
+		explicit ChunkParser(Chunk& chunk) : m_chunk(chunk) {}
+
+		void run()
+		{
+			const char* p = m_chunk.begin;
+			while (p < m_chunk.end)
+			{
+				const char* lineEnd = findNewline(p, m_chunk.end);
+				parseLine(p, lineEnd);
+				p = lineEnd + 1;
+			}
+		}
+
+	private:
+		Chunk& m_chunk;
+
+		void fail(const char* where)
+		{
+			throw std::runtime_error("failed to parse obj: unexpected \"" + std::string(where, std::min<size_t>(32, m_chunk.end - where)) + "\"");
+		}
+
+		const char* parseFloats(const char* p, const char* end, std::vector<float>& out, int count)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				p = skipSpaces(p, end);
+				if (p < end && *p == '+')
+				{
+					p++;
+				}
+				float value = 0.0f;
+				auto result = std::from_chars(p, end, value);
+				if (result.ec != std::errc())
+				{
+					fail(p);
+				}
+				out.push_back(value);
+				p = result.ptr;
+			}
+			return p;
+		}
+
+		//OBJ 下标从 1 开始，负数表示相对当前已有的属性个数
+		const char* parseIndex(const char* p, const char* end, RawIndex& out, int attribute, size_t localCount)
+		{
+			int32_t value = 0;
+			auto result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || value == 0)
+			{
+				fail(p);
+			}
+			if (value > 0)
+			{
+				out.value[attribute] = value - 1;
+			}
+			else
+			{
+				out.value[attribute] = static_cast<int32_t>(localCount) + value;
+				out.relativeMask |= 1 << attribute;
+			}
+			return result.ptr;
+		}
+
+		//面先原样记下，拆三角形要用到顶点位置，而相对下标可能指到前面的块，所以放到合并之后做
+		void parseFace(const char* p, const char* end)
+		{
+			uint32_t count = 0;
+			while (true)
+			{
+				p = skipSpaces(p, end);
+				if (p >= end || *p == '\r')
+				{
+					break;
+				}
+
+				RawIndex corner;
+				p = parseIndex(p, end, corner, 0, m_chunk.positions.size() / 3);
+				if (p < end && *p == '/')
+				{
+					p++;
+					if (p < end && *p != '/')
+					{
+						p = parseIndex(p, end, corner, 1, m_chunk.texcoords.size() / 2);
+					}
+					if (p < end && *p == '/')
+					{
+						p++;
+						p = parseIndex(p, end, corner, 2, m_chunk.normals.size() / 3);
+					}
+				}
+				m_chunk.corners.push_back(corner);
+				count++;
+			}
+
+			m_chunk.faceSizes.push_back(count);
+			if (count >= 3)
+			{
+				m_chunk.triangleCount += count - 2;
+			}
+		}
+
+		void parseLine(const char* p, const char* end)
+		{
+			p = skipSpaces(p, end);
+			if (end - p < 2)
+			{
+				return;
+			}
+
+			if (p[0] == 'v')
+			{
+				if (p[1] == ' ' || p[1] == '\t')
+				{
+					parseFloats(p + 2, end, m_chunk.positions, 3);
+				}
+				else if (p[1] == 't')
+				{
+					parseFloats(p + 2, end, m_chunk.texcoords, 2);
+				}
+				else if (p[1] == 'n')
+				{
+					parseFloats(p + 2, end, m_chunk.normals, 3);
+				}
+			}
+			else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				parseFace(p + 2, end);
+			}
+		}
+	};
+
+	int32_t globalize(const RawIndex& index, int attribute, size_t base)
+	{
+		int32_t value = index.value[attribute];
+		return (index.relativeMask & (1 << attribute)) ? static_cast<int32_t>(base) + value : value;
+	}
+
+	float distanceSquared(const std::vector<float>& positions, int32_t a, int32_t b)
+	{
+		float dx = positions[b * 3 + 0] - positions[a * 3 + 0];
+		float dy = positions[b * 3 + 1] - positions[a * 3 + 1];
+		float dz = positions[b * 3 + 2] - positions[a * 3 + 2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	bool isValid(const ObjIndex& index, int32_t vertexLimit, int32_t texcoordLimit, int32_t normalLimit)
+	{
+		return index.vertex >= 0 && index.vertex < vertexLimit && index.texcoord >= -1 && index.texcoord < texcoordLimit
+			&& index.normal >= -1 && index.normal < normalLimit;
+	}
+}
+
+ObjMesh ObjParser::load(const std::string& path, uint32_t threadCount)
+{
+	MappedFile file(path);
+	try
+	{
+		return parse(file.getData(), file.getSize(), threadCount);
+	}
+	catch (const std::exception& e)
+	{
+		throw std::runtime_error(path + ": " + e.what());
+	}
+}
+
+ObjMesh ObjParser::parse(const char* data, size_t size, uint32_t threadCount)
+{
+	ObjMesh mesh;
+	if (size == 0)
+	{
+		return mesh;
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	size_t chunkCount = std::clamp<size_t>(size / kMinChunkSize, 1, threadCount);
+
+	//按字节均分，再把每个切点挪到下一行开头，保证每行完整地落在一个块里
+	std::vector<Chunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* begin = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = std::max(begin, data + size / chunkCount * (i + 1));
+			chunkEnd = std::min(end, findNewline(chunkEnd, end) + 1);
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = chunkEnd;
+		begin = chunkEnd;
+	}
+
+	//每块一个线程，第 0 块在当前线程上做
+	auto runParallel = [&](auto&& func) {
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++)
+		{
+			workers.emplace_back(func, i);
+		}
+		func(0);
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	};
+
+	runParallel([&](size_t i) {
+		try
+		{
+			ChunkParser(chunks[i]).run();
+		}
+		catch (const std::exception& e)
+		{
+			chunks[i].error = e.what();
+		}
+	});
+	for (const Chunk& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			throw std::runtime_error(chunk.error);
+		}
+	}
+
+	//按块顺序合并，前缀和就是每块在全局数组里的起点
+	std::vector<size_t> positionBase(chunkCount), texcoordBase(chunkCount), normalBase(chunkCount), indexBase(chunkCount);
+	size_t positionCount = 0, texcoordCount = 0, normalCount = 0, indexCount = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positionBase[i] = positionCount;
+		texcoordBase[i] = texcoordCount;
+		normalBase[i] = normalCount;
+		indexBase[i] = indexCount;
+		positionCount += chunks[i].positions.size();
+		texcoordCount += chunks[i].texcoords.size();
+		normalCount += chunks[i].normals.size();
+		indexCount += chunks[i].triangleCount * 3;
+	}
+	mesh.positions.resize(positionCount);
+	mesh.texcoords.resize(texcoordCount);
+	mesh.normals.resize(normalCount);
+	mesh.indices.resize(indexCount);
+
+	auto copyAttributes = [&](size_t i) {
+		Chunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + positionBase[i]);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh.texcoords.begin() + texcoordBase[i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + normalBase[i]);
+	};
+
+	//拆三角形要读全局的顶点位置，所以属性全部拷完之后再做
+	int32_t vertexLimit = static_cast<int32_t>(positionCount / 3);
+	int32_t texcoordLimit = static_cast<int32_t>(texcoordCount / 2);
+	int32_t normalLimit = static_cast<int32_t>(normalCount / 3);
+	auto triangulate = [&](size_t i) {
+		Chunk& chunk = chunks[i];
+		ObjIndex* out = mesh.indices.data() + indexBase[i];
+		ObjIndex polygon[4];
+		const RawIndex* corner = chunk.corners.data();
+		for (uint32_t faceSize : chunk.faceSizes)
+		{
+			const RawIndex* face = corner;
+			corner += faceSize;
+			if (faceSize < 3)
+			{
+				continue;
+			}
+
+			auto resolve = [&](uint32_t k) {
+				ObjIndex index;
+				index.vertex = globalize(face[k], 0, positionBase[i] / 3);
+				index.texcoord = globalize(face[k], 1, texcoordBase[i] / 2);
+				index.normal = globalize(face[k], 2, normalBase[i] / 3);
+				//坏文件不能让后面建顶点时读越界
+				if (!isValid(index, vertexLimit, texcoordLimit, normalLimit))
+				{
+					chunk.error = "failed to parse obj: face index out of range!";
+				}
+				return index;
+			};
+
+			if (faceSize == 4)
+			{
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					polygon[k] = resolve(k);
+				}
+				if (!chunk.error.empty())
+				{
+					return;
+				}
+				//四边形沿较短的对角线切开，和 tinyobj 一致
+				if (distanceSquared(mesh.positions, polygon[0].vertex, polygon[2].vertex) < distanceSquared(mesh.positions, polygon[1].vertex, polygon[3].vertex))
+				{
+					*out++ = polygon[0]; *out++ = polygon[1]; *out++ = polygon[2];
+					*out++ = polygon[0]; *out++ = polygon[2]; *out++ = polygon[3];
+				}
+				else
+				{
+					*out++ = polygon[0]; *out++ = polygon[1]; *out++ = polygon[3];
+					*out++ = polygon[1]; *out++ = polygon[2]; *out++ = polygon[3];
+				}
+				continue;
+			}
+
+			//三角形原样输出，更多边的多边形按扇形拆（只适用于凸多边形）
+			ObjIndex first = resolve(0);
+			ObjIndex previous = resolve(1);
+			for (uint32_t k = 2; k < faceSize; k++)
+			{
+				ObjIndex current = resolve(k);
+				*out++ = first;
+				*out++ = previous;
+				*out++ = current;
+				previous = current;
+			}
+			if (!chunk.error.empty())
+			{
+				return;
+			}
+		}
+	};
+
+	runParallel(copyAttributes);
+	runParallel(triangulate);
+	for (const Chunk& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			throw std::runtime_error(chunk.error);
+		}
+	}
+	return mesh;
+}
+
+void ObjParser::parseBlock(const char* data, size_t size, size_t positionBase, size_t texcoordBase, size_t normalBase, ObjBlock& block)
+{
+	Chunk chunk;
+	chunk.begin = data;
+	chunk.end = data + size;
+	//接着上一段的数组解析，上一段用过的容量可以复用
+	chunk.positions = std::move(block.positions);
+	chunk.texcoords = std::move(block.texcoords);
+	chunk.normals = std::move(block.normals);
+	chunk.positions.clear();
+	chunk.texcoords.clear();
+	chunk.normals.clear();
+	ChunkParser(chunk).run();
+
+	block.positions = std::move(chunk.positions);
+	block.texcoords = std::move(chunk.texcoords);
+	block.normals = std::move(chunk.normals);
+	block.faceSizes = std::move(chunk.faceSizes);
+	block.corners.resize(chunk.corners.size());
+	for (size_t i = 0; i < chunk.corners.size(); i++)
+	{
+		block.corners[i].vertex = globalize(chunk.corners[i], 0, positionBase);
+		block.corners[i].texcoord = globalize(chunk.corners[i], 1, texcoordBase);
+		block.corners[i].normal = globalize(chunk.corners[i], 2, normalBase);
+	}
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 一个三角形角点引用的属性下标，从 0 开始，没有对应属性时为 -1（和 tinyobj::index_t 一致）
+struct ObjIndex
+{
+	int32_t vertex = -1;
+	int32_t texcoord = -1;
+	int32_t normal = -1;
+};
+
+// 解析结果：属性按出现顺序平铺，面已经按扇形拆成三角形，每 3 个 ObjIndex 一个三角形
+struct ObjMesh
+{
+	std::vector<float> positions; // xyz
+	std::vector<float> texcoords; // uv
+	std::vector<float> normals;   // xyz
+	std::vector<ObjIndex> indices;
+};
+
+// 流式解析的一段：属性按出现顺序平铺，面没有拆三角形（拆四边形要用到的顶点可能还没读到），
+// faceSizes 是每个面的角点数，corners 是所有面的角点连续存放，下标已经是全局的
+struct ObjBlock
+{
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	std::vector<uint32_t> faceSizes;
+	std::vector<ObjIndex> corners;
+};
+
+// 多线程 OBJ 解析：内存映射整个文件，按行边界切成若干块并行解析（SIMD 找换行，std::from_chars 解析数字），
+// 最后按块的顺序合并，结果和单线程逐行解析完全一致
+// 只处理几何（v/vt/vn/f），材质、分组、平滑组等语句直接跳过
+class ObjParser
+{
+public:
+	//threadCount 为 0 时按硬件线程数和文件大小自动决定
+	static ObjMesh load(const std::string& path, uint32_t threadCount = 0);
+	static ObjMesh parse(const char* data, size_t size, uint32_t threadCount = 0);
+	//单线程解析一段完整的行，base 是之前各段已有的属性个数（负数下标相对它们解析）；不检查下标范围
+	static void parseBlock(const char* data, size_t size, size_t positionBase, size_t texcoordBase, size_t normalBase, ObjBlock& block);
+};
@@ -10,15 +10,15 @@ PipelineBuilder::PipelineBuilder()
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	//falseǱ׼ trueĻгԶƽƬζѹΪƽϵֵͨӰͼҪGPU
+	//false是标准做法。 true的话会把所有超出近远平面的片段都挤压为近平面上的值，通常用于阴影贴图，需要开启GPU特性
 	rasterizer.depthClampEnable = VK_FALSE;
-	//trueʱ崦궥ֱ֮Ӷ.ֻ GPU Ķɫѧ㣨Transform FeedbackֻҪͼҪɫʱá
+	//true时几何体处理完顶点之后，直接丢掉.当只想利用 GPU 的顶点着色器做数学计算（Transform Feedback），或者只想要深度图不需要颜色时用。
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	//䷽ʽ׼
+	//三角形填充方式，这里是填满（标准做法）
 	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 	rasterizer.lineWidth = 1.0f;
 	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	//жζ㰴˳ʱ뷽Ϊ
+	//正面判定，三角形顶点按顺时针方向排列为正面
 	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	rasterizer.depthBiasEnable = VK_FALSE;
 	rasterizer.depthBiasConstantFactor = 0.0f;
@@ -88,14 +88,14 @@ VkPipeline PipelineBuilder::build(VkDevice device, VkRenderPass pass)
 	return pipieline;
 }
 
-void PipelineBuilder::setVertexInput(const VkVertexInputBindingDescription& binding, const std::vector<VkVertexInputAttributeDescription>& attributes)
+void PipelineBuilder::setVertexInput(const std::vector<VkVertexInputBindingDescription>& bindings, const std::vector<VkVertexInputAttributeDescription>& attributes)
 {
-	_bindingDescription = binding;
+	_bindingDescriptions = bindings;
 	_attributeDescriptions = attributes;
 
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &_bindingDescription;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(_bindingDescriptions.size());
+	vertexInputInfo.pVertexBindingDescriptions = _bindingDescriptions.data();
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(_attributeDescriptions.size());
 	vertexInputInfo.pVertexAttributeDescriptions = _attributeDescriptions.data();
 }
@@ -107,29 +107,29 @@ void PipelineBuilder::enableDepthTest()
 {
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 
-	// 1. ȲԣÿλʱҪõǰȺȻֵȽ
+	// 1. 开启深度测试：每次画像素时，都要拿当前的深度和深度缓冲里的值做比较
 	depthStencil.depthTestEnable = VK_TRUE;
 
-	// 2. д룺ͨˣǰ棩ͰԼдס
+	// 2. 开启深度写入：如果测试通过了（它在最前面），就把它自己的深度写进缓冲里，挡住后面的
 	depthStencil.depthWriteEnable = VK_TRUE;
 
-	// 3. ȽVK_COMPARE_OP_LESS ʾֵСȡ
+	// 3. 比较运算符：VK_COMPARE_OP_LESS 表示“深度值更小（离相机更近）的优先”
 	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
 
-	// 4. Щ߼ʱãص
+	// 4. 下面这些高级特性暂时不用，关掉
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.0f; // Optional
 	depthStencil.maxDepthBounds = 1.0f; // Optional
-	depthStencil.stencilTestEnable = VK_FALSE; // ģҲȹ
+	depthStencil.stencilTestEnable = VK_FALSE; // 模板测试也先关着
 }
 
 PipelineLayout::PipelineLayout(const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
 	:m_device(device)
 {
 	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // ׶
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // 顶点阶段用
 	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(glm::mat4); // һ mat4  64 ֽ
+	pushConstantRange.size = sizeof(glm::mat4); // 一个 mat4 是 64 字节
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -155,7 +155,7 @@ PipelineLayout::~PipelineLayout()
 
 
 
-Pipeline::Pipeline(VkDevice device, VkPipeline pipeline):
+Pipeline::Pipeline(Devices& device, VkPipeline pipeline):
 	m_device(device), m_graphicsPipeline(pipeline)
 {
 
@@ -163,11 +163,17 @@ Pipeline::Pipeline(VkDevice device, VkPipeline pipeline):
 
 Pipeline::~Pipeline()
 {
-	if (m_graphicsPipeline != VK_NULL_HANDLE) {
-		vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-	}
-
-	if (m_deslayout != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(m_device, m_deslayout, nullptr);
-	}
+	//在途的命令缓冲可能还绑定着这个管线，连同它的布局一起延迟销毁
+	VkDevice device = m_device.getLogicalDevice();
+	VkPipeline pipeline = m_graphicsPipeline;
+	VkDescriptorSetLayout deslayout = m_deslayout;
+	std::shared_ptr<PipelineLayout> layout = std::move(m_pipelineLayout);
+	m_device.getDeletionQueue().push([device, pipeline, deslayout, layout]() {
+		if (pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		if (deslayout != VK_NULL_HANDLE) {
+			vkDestroyDescriptorSetLayout(device, deslayout, nullptr);
+		}
+	});
 }
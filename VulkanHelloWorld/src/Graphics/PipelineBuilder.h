@@ -1,7 +1,8 @@
-#pragma once
+﻿#pragma once
 #include<vector>
 #include <vulkan/vulkan.h>
 #include <memory>
+#include "../Core/Devices.h"
 
 class PipelineBuilder
 {
@@ -18,7 +19,7 @@ public:
 	VkPipelineColorBlendStateCreateInfo colorBlending;
 	VkGraphicsPipelineCreateInfo pipelineInfo;
 	VkPipelineLayout pipelineLayout;
-	VkVertexInputBindingDescription _bindingDescription{};
+	std::vector<VkVertexInputBindingDescription> _bindingDescriptions{};
 	std::vector<VkVertexInputAttributeDescription> _attributeDescriptions{};
 	VkPipelineDepthStencilStateCreateInfo depthStencil{};
 	VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -26,7 +27,8 @@ public:
 
 	PipelineBuilder();
 	VkPipeline build(VkDevice device, VkRenderPass pass);
-	void setVertexInput(const VkVertexInputBindingDescription& binding,
+	//每个 binding 一条顶点流，可以有多条
+	void setVertexInput(const std::vector<VkVertexInputBindingDescription>& bindings,
 		const std::vector<VkVertexInputAttributeDescription>& attributes);
 	PipelineBuilder& setPipelineLayout(VkPipelineLayout layout)
 	{
@@ -67,18 +69,22 @@ public:
 	Pipeline(const Pipeline&) = delete;
 	Pipeline& operator=(const Pipeline&) = delete;
 
-	Pipeline(VkDevice device, VkPipeline pipeline);
+	Pipeline(Devices& device, VkPipeline pipeline);
 	~Pipeline();
 
 	VkPipeline& getPipeline() { return m_graphicsPipeline; }
 	void setPipelineLayout(std::unique_ptr<PipelineLayout> layout) { m_pipelineLayout = std::move(layout); }
 	void setDescriptorSetLayout(VkDescriptorSetLayout layout) { m_deslayout = layout; }
+	//记录光栅化的剔除模式，CPU 端整簇剔除背面时要知道这条管线本来会不会画背面
+	void setCullMode(VkCullModeFlags cullMode) { m_cullMode = cullMode; }
+	VkCullModeFlags getCullMode() const { return m_cullMode; }
 
 	VkDescriptorSetLayout getDescriptorSetLayout() const { return m_deslayout; }
 	PipelineLayout& getPipelineLayout() const { return *m_pipelineLayout; }
 private:
+	Devices& m_device;
 	VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
-	VkDevice m_device = VK_NULL_HANDLE;
 	std::unique_ptr<PipelineLayout> m_pipelineLayout;
 	VkDescriptorSetLayout m_deslayout = VK_NULL_HANDLE;
+	VkCullModeFlags m_cullMode = VK_CULL_MODE_NONE;
 };
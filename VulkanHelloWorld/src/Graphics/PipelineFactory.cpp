@@ -18,16 +18,13 @@ std::shared_ptr<Pipeline> PipelineFactory::createStandardPipeline(Devices& devic
 	/////////////////////////////////////////////////////////////////////////////////////
 
 
-	VertexLayout layout;
-	layout.push<glm::vec3>();//位置
-	layout.push<glm::vec3>();//颜色
-	layout.push<glm::vec2>();//UV
-	layout.push<glm::vec3>();//法线
+	//几何池里存的是压缩顶点，着色器读到的仍然是 float；位置和其它属性是两条流
+	VertexLayout layout = PackedVertex::getLayout();
 
 	PipelineBuilder builder;
 	builder.shaderStages.push_back(vertShader.getStageInfo());
 	builder.shaderStages.push_back(fragShader.getStageInfo());
-	builder.setVertexInput(layout.getBindingDescription(), layout.getAttributeDescriptions());
+	builder.setVertexInput(layout.getBindingDescriptions(), layout.getAttributeDescriptions());
 	builder.viewport = { 0.0f,0.0f,(float)extent.width ,(float)extent.height ,0.0f,1.0f };
 	builder.scissor = { {0,0}, extent };
 	builder.enableDepthTest();
@@ -40,9 +37,10 @@ std::shared_ptr<Pipeline> PipelineFactory::createStandardPipeline(Devices& devic
 	if (rawPipeline == VK_NULL_HANDLE) {
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
-	std::shared_ptr<Pipeline> pipeline = std::make_shared<Pipeline>(device.getLogicalDevice(), rawPipeline);
+	std::shared_ptr<Pipeline> pipeline = std::make_shared<Pipeline>(device, rawPipeline);
 	pipeline->setPipelineLayout(std::move(pipelineLayout));
 	pipeline->setDescriptorSetLayout(descripLayout);
+	pipeline->setCullMode(builder.rasterizer.cullMode);
 	return pipeline;
 }
 
@@ -54,14 +52,11 @@ std::shared_ptr<Pipeline> PipelineFactory::createStandardPipeline(Devices& devic
 		PipelineBuilder builder;
 		builder.shaderStages = { vertShader.getStageInfo() };
 
-		VertexLayout layout;
-		layout.push<glm::vec3>();//位置
-		layout.push<glm::vec3>();//颜色
-		layout.push<glm::vec2>();//UV
-		layout.push<glm::vec3>();//法线
+		//只绑位置流，每个顶点读 8 字节而不是 20 字节
+		VertexLayout layout = PackedVertex::getPositionLayout();
 
 		// 2. 顶点输入
-		builder.setVertexInput(layout.getBindingDescription(), layout.getAttributeDescriptions());
+		builder.setVertexInput(layout.getBindingDescriptions(), layout.getAttributeDescriptions());
 	
 		VkExtent2D shadowExtent = { 2048, 2048 };
 		builder.viewport = { 0.0f, 0.0f, (float)shadowExtent.width, (float)shadowExtent.height, 0.0f, 1.0f };
@@ -105,9 +100,10 @@ std::shared_ptr<Pipeline> PipelineFactory::createStandardPipeline(Devices& devic
 		VkPipeline rawPipeline = builder.build(device.getLogicalDevice(), renderPass);
 
 		// 10. 打包进你的 Pipeline 包装类并返回
-		auto pipeline = std::make_shared<Pipeline>(device.getLogicalDevice(), rawPipeline);
+		auto pipeline = std::make_shared<Pipeline>(device, rawPipeline);
 		pipeline->setPipelineLayout(std::move(pipelineLayout));
 		pipeline->setDescriptorSetLayout(descripLayout);
+		pipeline->setCullMode(builder.rasterizer.cullMode);
 
 		return pipeline;
 	}
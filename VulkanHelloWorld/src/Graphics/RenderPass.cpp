@@ -1,6 +1,6 @@
 #include "RenderPass.h"
 #include <stdexcept>
-RenderPass::RenderPass(VkDevice device) : m_device(device), m_renderpass(VK_NULL_HANDLE)
+RenderPass::RenderPass(Devices& device) : m_device(device), m_renderpass(VK_NULL_HANDLE)
 {
 
 }
@@ -30,7 +30,7 @@ void RenderPass::addDependency(const DependencyConfig& config)
 	depend.dstAccessMask = config.dstAccessMask;
 	depend.srcStageMask = config.srcStageMask;
 	depend.dstStageMask = config.dstStageMask;
-	depend.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;//Ĭֵ
+	depend.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;//默认值
 	m_dependencies.push_back(depend);
 }
 
@@ -103,7 +103,7 @@ void RenderPass::create()
 	renderPassInfo.pSubpasses = descs.data();
 
 
-	if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderpass) != VK_SUCCESS)
+	if (vkCreateRenderPass(m_device.getLogicalDevice(), &renderPassInfo, nullptr, &m_renderpass) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create render pass!");
 	}
@@ -112,7 +112,9 @@ void RenderPass::create()
 RenderPass::~RenderPass()
 {
 	if (m_renderpass != VK_NULL_HANDLE) {
-		vkDestroyRenderPass(m_device, m_renderpass, nullptr);
+		VkDevice device = m_device.getLogicalDevice();
+		VkRenderPass handle = m_renderpass;
+		m_device.getDeletionQueue().push([device, handle]() { vkDestroyRenderPass(device, handle, nullptr); });
 	}
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include "../Core/Devices.h"
 
 struct AttachmentConfig
 {
@@ -24,15 +25,15 @@ struct DependencyConfig
 
 struct SubpassConfig {
 	VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	std::vector<uint32_t> colorAttachmentIndices;  // Щɫд
-	int depthAttachmentIndex = -1;                 // ĸȸд-1 ʾã
-	std::vector<uint32_t> inputAttachmentIndices;  // ЩSubpass ͨŵĺģ
+	std::vector<uint32_t> colorAttachmentIndices;  // 往哪些颜色附件里写
+	int depthAttachmentIndex = -1;                 // 往哪个深度附件里写（-1 表示不用）
+	std::vector<uint32_t> inputAttachmentIndices;  // 从哪些附件里读（Subpass 间通信的核心）
 };
 
 class RenderPass
 {
 public:
-	RenderPass(VkDevice device);
+	RenderPass(Devices& device);
 	~RenderPass();
 
 	RenderPass(const RenderPass&) = delete;
@@ -46,7 +47,7 @@ public:
 	const VkRenderPass& getHandle() const { return m_renderpass; }
 	const std::vector<VkClearValue>& getClearValues() const { return m_clearValues; }
 private:
-	VkDevice m_device;
+	Devices& m_device;
 	std::vector<VkAttachmentDescription> m_descriptions;
 	std::vector<SubpassConfig> m_configs;
 	std::vector<VkSubpassDependency> m_dependencies;
@@ -20,8 +20,8 @@ VkPipelineShaderStageCreateInfo Shader::getStageInfo()
 
 std::vector<char> Shader::readFile(const std::string& filePath)
 {
-	//ԶƷʽ򿪣Ұļָƶļĩβ
-	//ͿͨtellgֱӻȡļС
+	//以二进制方式打开，并且把文件指针移动到文件末尾
+	//这样就可以通过tellg直接获取文件大小
 	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 	if (!file.is_open())
 	{
@@ -29,7 +29,7 @@ std::vector<char> Shader::readFile(const std::string& filePath)
 	}
 	size_t fileSize = (size_t)file.tellg();
 	std::vector<char> buffer(fileSize);
-	//°ļָƶļͷȡ
+	//重新把文件指针移动到文件开头，读取所有数据
 	file.seekg(0);
 	file.read(buffer.data(), fileSize);
 	file.close();
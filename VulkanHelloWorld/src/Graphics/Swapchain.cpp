@@ -1,44 +1,44 @@
 #include "Swapchain.h"
 #include "../Core/ValidationLayerAssist.h"
 
-SwapChain::SwapChain(Devices& deviceRef, VkExtent2D windowExtent) : m_device(deviceRef), m_windowExtent(windowExtent)
+SwapChain::SwapChain(Devices& deviceRef, VkExtent2D windowExtent, VkSwapchainKHR oldSwapChain) : m_device(deviceRef), m_windowExtent(windowExtent)
 {
-	createSwapChain();
+	createSwapChain(oldSwapChain);
 	createImageViews();
 }
 
-void SwapChain::createSwapChain()
+void SwapChain::createSwapChain(VkSwapchainKHR oldSwapChain)
 {
-	// --- ׶ 1: Э (ίи) ---
-		// ѯ豸Խ֧ (ʲô)
+	// --- 阶段 1: 协商 (委托给辅助类) ---
+		// 查询物理设备对交换链的支持情况 (它能做什么？)
 	SwapChainSupportDetails swapChainSupport = m_device.getSwapChainSupportDetails(m_device.getPhysicalDevice());
 
-	// ݲѯĽЭ̡Ҫѹ
+	// 根据查询到的结果，“协商”出我们想要的最佳规格
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-	// --- ׶ 2: ͼ ---
-	// ҪǡС֧ + 1Կػ壩
+	// --- 阶段 2: 决定图像数量 ---
+	// 我们想要的数量是“最小支持数 + 1”（尝试开启三重缓冲）
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 
-	//maxImageCountΪ0ʾû
-	//ҪimageCountѾӲֵ֧ޣͱò
+	//maxImageCount为0表示没有上限
+	//或者我们想要的imageCount已经超过了硬件支持的上限，就必须让步
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 	{
 		imageCount = swapChainSupport.capabilities.maxImageCount;
 	}
 
-	// (ЩЭ̺õĽ洴ImageViewʱõ)
+	// (保存这些协商好的结果，后面创建ImageView时会用到)
 	m_swapChainImageFormat = surfaceFormat.format;
 	m_swapChainExtent = extent;
 
-	// --- ׶ 3:  CreateInfo ṹ () ---
+	// --- 阶段 3: 填充 CreateInfo 结构体 (核心) ---
 	VkSwapchainCreateInfoKHR createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	createInfo.surface = m_device.getSurface();
 
-	//ֻ߽飬֤һܵõôimageпܸ࣬滹Ҫ²ѯһ
+	//只是请求或者建议，并不保证一定能得到这么多的image，有可能更多，所以在下面还要重新查询一次
 	createInfo.minImageCount = imageCount;
 	createInfo.imageFormat = surfaceFormat.format;
 	createInfo.imageColorSpace = surfaceFormat.colorSpace;
@@ -66,14 +66,14 @@ void SwapChain::createSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapChain;
 
 	if (vkCreateSwapchainKHR(m_device.getLogicalDevice(), &createInfo, nullptr, &m_swapChain) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create swap-chain!");
 	}
 
-	//²ѯһΣõʵʵimage
+	//再重新查询一次，得到实际的image数量
 	vkGetSwapchainImagesKHR(m_device.getLogicalDevice(), m_swapChain, &imageCount, nullptr);
 	m_swapChainImages.resize(imageCount);
 	vkGetSwapchainImagesKHR(m_device.getLogicalDevice(), m_swapChain, &imageCount, m_swapChainImages.data());
@@ -83,7 +83,7 @@ void SwapChain::createImageViews()
 {
 	m_swapChainImageViews.resize(m_swapChainImages.size());
 
-	//ÿһͼ񣬴ӦImageView
+	//遍历交换链里的每一张图像，创建对应的ImageView
 	for (size_t i = 0; i < m_swapChainImages.size(); i++)
 	{
 		m_swapChainImageViews[i] = createImageView(m_swapChainImages[i], m_swapChainImageFormat);
@@ -113,12 +113,12 @@ VkImageView SwapChain::createImageView(VkImage image, VkFormat format)
 
 VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
-	//ûرָʽҪĸʽ
+	//如果交换链没有特别指定格式，就用我们想要的格式
 	if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED)
 	{
 		return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 	}
-	//ڿõĸʽѰҪĸʽ
+	//否则在可用的格式中寻找我们想要的格式
 	for (const auto& availableFormat : availableFormats)
 	{
 		if (availableFormat.format == VK_FORMAT_B8G8R8A8_UNORM &&
@@ -127,7 +127,7 @@ VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfac
 			return availableFormat;
 		}
 	}
-	//ҲҪĸʽͷصһõĸʽ
+	//如果找不到我们想要的格式，就返回第一个可用的格式
 	return availableFormats[0];
 }
 
@@ -135,7 +135,7 @@ VkPresentModeKHR SwapChain::chooseSwapPresentMode(const std::vector<VkPresentMod
 {
 	if (!enableValidationLayers)
 	{
-		//Ѱmailboxģʽһֵӳ˺ѵʾģʽ
+		//首先寻找mailbox模式，这是一种低延迟且无撕裂的显示模式
 		for (const auto& availablePresentMode : availablePresentModes)
 		{
 			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
@@ -145,16 +145,16 @@ VkPresentModeKHR SwapChain::chooseSwapPresentMode(const std::vector<VkPresentMod
 		}
 	}
 
-	//ҲmailboxģʽʹFIFOģʽһǿƴֱͬʾģʽ
+	//如果找不到mailbox模式，就使用FIFO模式，这是一种强制垂直同步的显示模式
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 VkExtent2D SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
 {
-	//Ѿָ˷ֱʣֱʹ
-	//ʹôڵķֱʣҪȷڽֵ֧ķΧ
-	//UINT32_MAXһֵʾûֱָ
-	//ҪԼֱ
+	//如果交换链已经指定了分辨率，就直接使用
+	//否则就使用窗口的分辨率，但要确保在交换链支持的范围内
+	//UINT32_MAX是一个特殊值，表示交换链没有指定分辨率
+	//我们需要自己决定分辨率
 	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
 	{
 		return capabilities.currentExtent;
@@ -175,15 +175,24 @@ VkExtent2D SwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilit
 
 SwapChain::~SwapChain()
 {
-	// 1.  ImageViews (Ϊ SwapChain Images)
-	for (auto imageView : m_swapChainImageViews)
-	{
-		vkDestroyImageView(m_device.getLogicalDevice(), imageView, nullptr);
-	}
+	// 重建时旧交换链的图像可能还在被在途的帧渲染/呈现，交给删除队列等这些帧结束
+	// 帧的 fence 只覆盖提交的命令，不覆盖 vkQueuePresentKHR，旧交换链上排着的呈现可能比 fence 晚完成
+	// 所以再多等一整圈帧：那时新交换链已经获取、呈现过好几次，同一个呈现队列上更早的呈现都已经处理完
+	VkDevice device = m_device.getLogicalDevice();
+	VkSwapchainKHR swapChain = m_swapChain;
+	std::vector<VkImageView> imageViews = std::move(m_swapChainImageViews);
+	uint64_t extraFrames = static_cast<uint64_t>(m_device.getMaxFramesInFlight());
+	m_device.getDeletionQueue().push([device, swapChain, imageViews]() {
+		// 1. 先销毁 ImageViews (因为它们依赖于 SwapChain Images)
+		for (auto imageView : imageViews)
+		{
+			vkDestroyImageView(device, imageView, nullptr);
+		}
 
-	// 2.  SwapChain (Images ֮Զ٣Ҫֶ destroy Image)
-	if (m_swapChain != VK_NULL_HANDLE)
-	{
-		vkDestroySwapchainKHR(m_device.getLogicalDevice(), m_swapChain, nullptr);
-	}
+		// 2. 最后销毁 SwapChain (Images 会随之自动销毁，不需要手动 destroy Image)
+		if (swapChain != VK_NULL_HANDLE)
+		{
+			vkDestroySwapchainKHR(device, swapChain, nullptr);
+		}
+	}, extraFrames);
 }
@@ -1,10 +1,11 @@
-#pragma once
+﻿#pragma once
 #include "../Core/Devices.h"
 
 class SwapChain
 {
 public:
-	SwapChain(Devices& deviceRef, VkExtent2D windowExtent);
+	//oldSwapChain 非空时新交换链从旧的那里接手，旧的由析构函数交给删除队列
+	SwapChain(Devices& deviceRef, VkExtent2D windowExtent, VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 	~SwapChain();
 	SwapChain(const SwapChain&) = delete;
 	SwapChain& operator=(const SwapChain&) = delete;
@@ -27,7 +28,7 @@ private:
 	std::vector<VkImageView> m_swapChainImageViews;
 	//std::vector<VkFramebuffer> m_swapChainFramebuffers;
 
-	void createSwapChain();
+	void createSwapChain(VkSwapchainKHR oldSwapChain);
 	void createImageViews();
 	VkImageView createImageView(VkImage image, VkFormat format);
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
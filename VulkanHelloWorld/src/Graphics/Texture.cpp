@@ -1,64 +1,40 @@
 #include "Texture.h"
 #include <stb_image.h>
 #include "../Buffer.h"       
+#include "../Core/UploadBatch.h"
 
-Texture::Texture(Devices& device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageAspectFlags aspectFlags)
-	:m_device(device), m_format(format)
+Texture::Texture(Devices& device, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImageAspectFlags aspectFlags, MemoryUsage memoryUsage)
+	:m_device(device), m_format(format), m_width(width), m_height(height), m_tiling(tiling), m_usage(usage),
+	m_properties(properties), m_aspectFlags(aspectFlags), m_memoryUsage(memoryUsage)
 {
-	createImage(width, height, tiling, usage, properties);
-	createImageView(aspectFlags);
+	createImage(m_image, m_allocation);
+	m_imageView = createImageView(m_image);
+
+	//只有采样纹理可以搬：它们上传完之后一直处于 SHADER_READ_ONLY 布局，渲染目标被帧缓冲引用着，不搬
+	m_relocatable = memoryUsage == MemoryUsage::Texture && (usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	if (m_relocatable)
+	{
+		m_device.getDefragmenter().registerResource(this);
+	}
 }
 
 std::shared_ptr<Texture> Texture::createPureColorTexture(Devices& device, uint32_t color)
 {
-	VkDeviceSize imageSize = 4; // 1 * 4ͨ
-
-	// 2.  Staging Buffer 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	Buffer::createBuffer(
-		device.getLogicalDevice(),
-		device.getPhysicalDevice(),
-		imageSize,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer,
-		stagingBufferMemory
-	);
-
-	void* data;
-	vkMapMemory(device.getLogicalDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, &color, 4);
-	vkUnmapMemory(device.getLogicalDevice(), stagingBufferMemory);
-
-	// 3. ʵ Texture (1x1)
+	// 1. 实例化 Texture (1x1)
 	std::shared_ptr<Texture> texture = std::make_shared<Texture>(
 		device,
-		1, 1, // 
+		1, 1, // 宽高
 		VK_FORMAT_R8G8B8A8_UNORM,
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		VK_IMAGE_ASPECT_COLOR_BIT
 	);
 
-	// 4. תֲ
-	texture->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-	Buffer::copyBufferToImage(
-		device.getLogicalDevice(),
-		device.getCommandPool(),
-		device.getGraphicsQueue(),
-		stagingBuffer,
-		texture->getImage(),
-		1, 1
-	);
-
-	texture->transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	
-	vkDestroyBuffer(device.getLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(device.getLogicalDevice(), stagingBufferMemory, nullptr);
+	// 2. 转换布局并通过 staging 环拷贝 (1像素 * 4通道)，一次提交，不等待
+	UploadBatch batch(device);
+	batch.uploadImage(texture->getImage(), 1, 1, 4, &color);
+	texture->m_uploadToken = batch.submit();
 
 	return texture;
 }
@@ -71,28 +47,32 @@ std::shared_ptr<Texture> Texture::loadFromFile(Devices& device, const std::strin
 	{
 		throw std::runtime_error("failed to load texture image!");
 	}
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	Buffer::createBuffer(device.getLogicalDevice(), device.getPhysicalDevice(), imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-	void* data;
-	vkMapMemory(device.getLogicalDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device.getLogicalDevice(), stagingBufferMemory);
-	stbi_image_free(pixels);
+	return createFromPixels(device, texWidth, texHeight, pixels);
+}
 
-	std::shared_ptr<Texture> texture = std::make_unique<Texture>(device, texWidth, texHeight,
-		VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+std::shared_ptr<Texture> Texture::loadFromMemory(Devices& device, const unsigned char* data, size_t size)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		throw std::runtime_error("failed to load texture image!");
+	}
+	return createFromPixels(device, texWidth, texHeight, pixels);
+}
 
+std::shared_ptr<Texture> Texture::createFromPixels(Devices& device, int width, int height, unsigned char* pixels)
+{
+	std::shared_ptr<Texture> texture = std::make_unique<Texture>(device, width, height,
+		VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
 
-	texture->transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	Buffer::copyBufferToImage(device.getLogicalDevice(), device.getCommandPool(), device.getGraphicsQueue(), stagingBuffer, texture->getImage(), static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-	texture->transitionImageLayout( VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-	vkDestroyBuffer(device.getLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(device.getLogicalDevice(), stagingBufferMemory, nullptr);
+	//像素直接写进staging环，大图会按行自动切块；memcpy完成后像素就可以释放，不用等GPU
+	UploadBatch batch(device);
+	batch.uploadImage(texture->getImage(), static_cast<uint32_t>(width), static_cast<uint32_t>(height), 4, pixels);
+	texture->m_uploadToken = batch.submit();
+	stbi_image_free(pixels);
 
 	return texture;
 }
@@ -103,142 +83,156 @@ std::shared_ptr<Texture> Texture::createDepthTexture(Devices& device, uint32_t w
 		device,
 		width,
 		height,
-		VK_FORMAT_D32_SFLOAT,                             // ǿ 32 λȸʽ
+		VK_FORMAT_D32_SFLOAT,                             // 强制 32 位浮点深度格式
 		VK_IMAGE_TILING_OPTIMAL,
-		usage,      // רΪȸ
+		usage,      // 专门作为深度附件
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		VK_IMAGE_ASPECT_DEPTH_BIT                         // ӽ
+		VK_IMAGE_ASPECT_DEPTH_BIT,                        // 深度视角
+		MemoryUsage::RenderTarget
 	);
 }
 
-void Texture::createImage(uint32_t width, uint32_t height, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties)
+void Texture::createImage(VkImage& image, Allocation& allocation)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = width;
-	imageInfo.extent.height = height;
+	imageInfo.extent.width = m_width;
+	imageInfo.extent.height = m_height;
 	imageInfo.extent.depth = 1;
 	imageInfo.mipLevels = 1;
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = m_format;
-	imageInfo.tiling = tiling;
+	imageInfo.tiling = m_tiling;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = usage;
+	imageInfo.usage = m_usage;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	if (vkCreateImage(m_device.getLogicalDevice(), &imageInfo, nullptr, &m_image) != VK_SUCCESS)
+	if (vkCreateImage(m_device.getLogicalDevice(), &imageInfo, nullptr, &image) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create image!");
 	}
 
 	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(m_device.getLogicalDevice(), m_image, &memRequirements);
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-	if (vkAllocateMemory(m_device.getLogicalDevice(), &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to allocate image memory!");
-	}
-	vkBindImageMemory(m_device.getLogicalDevice(), m_image, m_imageMemory, 0);
+	vkGetImageMemoryRequirements(m_device.getLogicalDevice(), image, &memRequirements);
+	allocation = m_device.getAllocator().allocate(memRequirements, m_properties, m_tiling == VK_IMAGE_TILING_LINEAR, m_memoryUsage);
+	vkBindImageMemory(m_device.getLogicalDevice(), image, allocation.memory, allocation.offset);
 }
 
-void Texture::createImageView(VkImageAspectFlags aspectFlags)
+VkImageView Texture::createImageView(VkImage image)
 {
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image = m_image;
+	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = m_format;
-	viewInfo.subresourceRange.aspectMask = aspectFlags;
+	viewInfo.subresourceRange.aspectMask = m_aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = 1;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
-	if (vkCreateImageView(m_device.getLogicalDevice(), &viewInfo, nullptr, &m_imageView) != VK_SUCCESS)
+	VkImageView imageView;
+	if (vkCreateImageView(m_device.getLogicalDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create texture image view!");
 	}
+	return imageView;
 }
 
-void Texture::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout)
+bool Texture::beginRelocation(uint32_t slot, VkCommandBuffer commandBuffer)
 {
-	VkCommandBuffer commandBuffer = CommandBuffer::beginSingleTimeCommands(m_device.getLogicalDevice(), m_device.getCommandPool());
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-
-	//ԴݶȨVK_QUEUE_FAMILY_IGNOREDʾ
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = m_image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.srcAccessMask = 0; // TODO
-	barrier.dstAccessMask = 0; // TODO
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	//像素还没传完的话旧 image 里还不是完整数据
+	if (!m_device.getStagingRing().isComplete(m_uploadToken))
 	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		return false;
 	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else
+
+	createImage(m_newImage, m_newAllocation);
+
+	VkImageMemoryBarrier barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : barriers)
 	{
-		throw std::invalid_argument("unsupported layout transition!");
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = m_aspectFlags;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
 	}
 
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		sourceStage, destinationStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier
-	);
-
-	CommandBuffer::endSingleTimeCommands(m_device.getLogicalDevice(), m_device.getCommandPool(), m_device.getGraphicsQueue(), commandBuffer);
+	//旧 image：之前帧的采样结束后再转成拷贝源；新 image：丢弃旧内容转成拷贝目标
+	barriers[0].image = m_image;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].image = m_newImage;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	VkImageCopy region{};
+	region.srcSubresource.aspectMask = m_aspectFlags;
+	region.srcSubresource.mipLevel = 0;
+	region.srcSubresource.baseArrayLayer = 0;
+	region.srcSubresource.layerCount = 1;
+	region.dstSubresource = region.srcSubresource;
+	region.extent = { m_width, m_height, 1 };
+	vkCmdCopyImage(commandBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	//两个都回到 SHADER_READ_ONLY：旧的在换句柄之前还会被采样，新的之后被采样
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 2, barriers);
+	return true;
 }
 
-uint32_t Texture::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+RelocatedResource Texture::endRelocation(uint32_t slot)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_device.getPhysicalDevice(), &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-	{
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
-	}
-	throw std::runtime_error("failed to find suitable memory type!");
+	RelocatedResource old;
+	old.image = m_image;
+	old.imageView = m_imageView;
+	old.allocation = m_allocation;
+
+	m_image = m_newImage;
+	m_allocation = m_newAllocation;
+	m_imageView = createImageView(m_image);
+	m_newImage = VK_NULL_HANDLE;
+	m_newAllocation = Allocation{};
+	m_version++;
+	return old;
 }
 
 Texture::~Texture()
 {
-	if (m_imageView != VK_NULL_HANDLE) {
-		vkDestroyImageView(m_device.getLogicalDevice(), m_imageView, nullptr);
-	}
-	if (m_image != VK_NULL_HANDLE) {
-		vkDestroyImage(m_device.getLogicalDevice(), m_image, nullptr);
-	}
-	if (m_imageMemory != VK_NULL_HANDLE) {
-		vkFreeMemory(m_device.getLogicalDevice(), m_imageMemory, nullptr);
+	if (m_relocatable)
+	{
+		m_device.getDefragmenter().unregisterResource(this);
 	}
+	//描述符和帧缓冲里可能还引用着，等在途的帧结束再销毁
+	Devices& device = m_device;
+	VkImageView imageView = m_imageView;
+	VkImage image = m_image;
+	Allocation allocation = m_allocation;
+	m_device.getDeletionQueue().push([&device, imageView, image, allocation]() mutable {
+		if (imageView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device.getLogicalDevice(), imageView, nullptr);
+		}
+		if (image != VK_NULL_HANDLE) {
+			vkDestroyImage(device.getLogicalDevice(), image, nullptr);
+		}
+		device.getAllocator().free(allocation);
+	});
 }
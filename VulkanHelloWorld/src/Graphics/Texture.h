@@ -5,7 +5,8 @@
 #include <memory>
 #include "../Core/Devices.h"
 
-class Texture
+// 带 TRANSFER_SRC 用途的采样纹理会注册到碎片整理器，被搬动后 image/imageView 都会换掉，version 加一
+class Texture : public Relocatable
 {
 public:
 	Texture(Devices& device,
@@ -15,7 +16,8 @@ public:
 		VkImageTiling tiling,
 		VkImageUsageFlags usage,
 		VkMemoryPropertyFlags properties,
-		VkImageAspectFlags aspectFlags);
+		VkImageAspectFlags aspectFlags,
+		MemoryUsage memoryUsage = MemoryUsage::Texture);
 	~Texture();
 
 	Texture(const Texture&) = delete;
@@ -24,20 +26,46 @@ public:
 	const VkImage& getImage() const { return m_image; }
 	const VkImageView& getImageView() const { return m_imageView; }
 	const VkFormat& getFormat() const { return m_format; }
+	UploadToken getUploadToken() const { return m_uploadToken; }
+	//每次被碎片整理搬动后加一，Material 据此重写描述符
+	uint32_t getVersion() const { return m_version; }
+
+	uint32_t getSlotCount() const override { return 1; }
+	const Allocation& getSlotAllocation(uint32_t slot) const override { return m_allocation; }
+	bool beginRelocation(uint32_t slot, VkCommandBuffer commandBuffer) override;
+	RelocatedResource endRelocation(uint32_t slot) override;
 
 	static std::shared_ptr<Texture> createPureColorTexture(Devices& device, uint32_t color);
 
 	static std::shared_ptr<Texture> loadFromFile(Devices& device, const std::string& path);
+	//内存里的 PNG/JPG 等编码后的图片，比如 GLB 内嵌的贴图
+	static std::shared_ptr<Texture> loadFromMemory(Devices& device, const unsigned char* data, size_t size);
 	static std::shared_ptr<Texture> createDepthTexture(Devices& device, uint32_t width, uint32_t height, VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
 private:
-	Devices& m_device; // Devices ࣬ȡ߼豸
+	Devices& m_device; // 引用Devices 类，方便获取物理和逻辑设备
 	VkImage m_image = VK_NULL_HANDLE;
-	VkDeviceMemory m_imageMemory = VK_NULL_HANDLE;
+	Allocation m_allocation;
 	VkImageView m_imageView = VK_NULL_HANDLE;
 	VkFormat m_format;
+	UploadToken m_uploadToken = 0; // 像素上传的凭证，非上传的纹理为 0
+	uint32_t m_version = 0;
+
+	//搬动时要用同样的参数重建 image
+	uint32_t m_width;
+	uint32_t m_height;
+	VkImageTiling m_tiling;
+	VkImageUsageFlags m_usage;
+	VkMemoryPropertyFlags m_properties;
+	VkImageAspectFlags m_aspectFlags;
+	MemoryUsage m_memoryUsage;
+	bool m_relocatable = false;
+
+	//已经录了拷贝、等 GPU 完成的新 image
+	VkImage m_newImage = VK_NULL_HANDLE;
+	Allocation m_newAllocation;
 
-	void createImage(uint32_t width, uint32_t height, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties);
-	void createImageView(VkImageAspectFlags aspectFlags);
-	void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	//接管 stbi 解码出来的 RGBA 像素，上传后释放
+	static std::shared_ptr<Texture> createFromPixels(Devices& device, int width, int height, unsigned char* pixels);
+	void createImage(VkImage& image, Allocation& allocation);
+	VkImageView createImageView(VkImage image);
 };
@@ -0,0 +1,128 @@
+﻿#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// 顶点焊接用的开放寻址哈希表：一块连续的槽数组，线性探测，不为每个顶点单独分配节点
+// 按顶点的原始字节做哈希和比较（以 32 位为单位，-0.0 和 0.0 视为相同，和按 float 比较的结果一致），
+// 一次探测就能得到已有顶点的下标或者插入新顶点，不需要先 count 再 operator[]
+template<typename V>
+class VertexWeldTable
+{
+	static_assert(std::is_trivially_copyable_v<V>, "VertexWeldTable needs a trivially copyable vertex");
+	static_assert(sizeof(V) % sizeof(uint32_t) == 0, "VertexWeldTable hashes vertices as 32-bit words");
+
+public:
+	//expectedVertices 是去重前的角点数，唯一顶点不会比它多，按它预留就不会扩容
+	explicit VertexWeldTable(size_t expectedVertices)
+	{
+		size_t capacity = 16;
+		while (capacity < expectedVertices * 2)
+		{
+			capacity *= 2;
+		}
+		m_slots.assign(capacity, Slot{});
+		m_mask = capacity - 1;
+	}
+
+	//清空所有槽，容量不变，可以接着焊下一批顶点
+	void clear()
+	{
+		std::fill(m_slots.begin(), m_slots.end(), Slot{});
+	}
+
+	//返回顶点在 vertices 里的下标，没见过的顶点追加到末尾
+	uint32_t weld(const V& vertex, std::vector<V>& vertices)
+	{
+		if ((vertices.size() + 1) * 2 > m_slots.size())
+		{
+			grow(vertices);
+		}
+
+		uint64_t hash = hashVertex(vertex);
+		uint32_t tag = static_cast<uint32_t>(hash >> 32) | 1; // 0 留给空槽
+		size_t slot = static_cast<size_t>(hash) & m_mask;
+		while (true)
+		{
+			Slot& s = m_slots[slot];
+			if (s.tag == 0)
+			{
+				s.tag = tag;
+				s.index = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+				return s.index;
+			}
+			if (s.tag == tag && equal(vertices[s.index], vertex))
+			{
+				return s.index;
+			}
+			slot = (slot + 1) & m_mask;
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t tag = 0;   // 哈希高位，先比它，绝大多数不相同的顶点不用逐字节比较
+		uint32_t index = 0;
+	};
+
+	std::vector<Slot> m_slots;
+	size_t m_mask = 0;
+
+	static uint32_t word(const V& vertex, size_t i)
+	{
+		uint32_t value;
+		memcpy(&value, reinterpret_cast<const char*>(&vertex) + i * sizeof(uint32_t), sizeof(uint32_t));
+		return value == 0x80000000u ? 0u : value;
+	}
+
+	static uint64_t hashVertex(const V& vertex)
+	{
+		uint64_t hash = 0x9E3779B97F4A7C15ull;
+		for (size_t i = 0; i < sizeof(V) / sizeof(uint32_t); i++)
+		{
+			hash = (hash ^ word(vertex, i)) * 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 32;
+		}
+		//murmur3 的 fmix64，让每一位都充分扩散，低位直接当槽号用
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	static bool equal(const V& a, const V& b)
+	{
+		for (size_t i = 0; i < sizeof(V) / sizeof(uint32_t); i++)
+		{
+			if (word(a, i) != word(b, i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void grow(const std::vector<V>& vertices)
+	{
+		std::vector<Slot> old = std::move(m_slots);
+		m_slots.assign(old.size() * 2, Slot{});
+		m_mask = m_slots.size() - 1;
+		for (const Slot& s : old)
+		{
+			if (s.tag == 0)
+			{
+				continue;
+			}
+			size_t slot = static_cast<size_t>(hashVertex(vertices[s.index])) & m_mask;
+			while (m_slots[slot].tag != 0)
+			{
+				slot = (slot + 1) & m_mask;
+			}
+			m_slots[slot] = s;
+		}
+	}
+};
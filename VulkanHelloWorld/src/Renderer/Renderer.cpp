@@ -2,12 +2,15 @@
 #include "Renderer.h"
 #include <stdexcept>
 #include <array>
+#include <cstddef>
+#include <algorithm>
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_vulkan.h>
 #include "../Buffer.h"
 #include "../Description.h"
 #include "../Graphics/PipelineFactory.h"
+#include "../Core/FrameAllocCheck.h"
 
 Renderer::Renderer(Devices& device, SwapChain* swapchain, Camera& cam, const int maxFrame)
 	:m_device(device), m_swapchain(swapchain), m_MAX_FRAMES_IN_FLIGHT(maxFrame), m_camera(cam)
@@ -15,7 +18,7 @@ Renderer::Renderer(Devices& device, SwapChain* swapchain, Camera& cam, const int
 	createRenderPass();
 	createSyncObjects();
 	createCommandBuffers();
-	createGlobalUniformBuffers();
+	createUniformRing();
 	createSamplers();
 	createDepthResource();
 	createSwapchainFrameBuffers();
@@ -26,7 +29,7 @@ Renderer::Renderer(Devices& device, SwapChain* swapchain, Camera& cam, const int
 void Renderer::createRenderPass()
 {
 	//////主renderpass
-	m_RenderPass = std::make_unique<RenderPass>(m_device.getLogicalDevice());
+	m_RenderPass = std::make_unique<RenderPass>(m_device);
 
 	AttachmentConfig colorAttachment = {};
 	colorAttachment.format = m_swapchain->getSwapChainImageFormat();
@@ -65,7 +68,7 @@ void Renderer::createRenderPass()
 	m_RenderPass->create();
 
 	//创建shadow map的renderpass
-	m_shadowRenderPass = std::make_unique<RenderPass>(m_device.getLogicalDevice());
+	m_shadowRenderPass = std::make_unique<RenderPass>(m_device);
 	depthAttachment = {};
 	depthAttachment.format = VK_FORMAT_D32_SFLOAT;
 	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -94,10 +97,20 @@ void Renderer::createRenderPass()
 VkCommandBuffer Renderer::beginFrame()
 {
 	vkWaitForFences(m_device.getLogicalDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	m_frameArena->beginFrame();
+	//这一槽上一次提交的帧已经结束，它之前入队的资源可以销毁了
+	m_device.getDeletionQueue().retire(m_frameSerials[m_currentFrame]);
+	m_device.getStagingRing().reclaim();
+	//碎片整理会新建图像/缓冲、往删除队列里塞回调，属于维护工作，放在检查窗口之前
+	m_device.getDefragmenter().update();
+	FrameAllocCheck::beginFrame();
+	m_uniformRing->beginFrame(static_cast<uint32_t>(m_currentFrame));
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(m_device.getLogicalDevice(), m_swapchain->getSwapChain(), std::numeric_limits<uint64_t>::max(), m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		//重建交换链不在帧循环里，不检查
+		FrameAllocCheck::abortFrame();
 		return VK_NULL_HANDLE;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
@@ -116,6 +129,7 @@ VkCommandBuffer Renderer::beginFrame()
 	{
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
+	flushTrackedBuffers(cmd);
 	return cmd;
 
 }
@@ -148,6 +162,7 @@ VkResult Renderer::endFrame()
 	{
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
+	m_frameSerials[m_currentFrame] = m_device.getDeletionQueue().submitFrame();
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -160,6 +175,7 @@ VkResult Renderer::endFrame()
 	presentInfo.pResults = nullptr;
 	VkResult result = vkQueuePresentKHR(m_device.getPresentQueue(), &presentInfo);
 	m_currentFrame = (m_currentFrame + 1) % m_MAX_FRAMES_IN_FLIGHT;
+	FrameAllocCheck::endFrame();
 
 	return result;
 }
@@ -207,7 +223,12 @@ void Renderer::updateGlbUBO()
 	ubo.view = m_camera.getViewMatrix();
 	ubo.proj = m_camera.getProjectionMatrix(m_swapchain->getSwapChainExtent().width / (float)m_swapchain->getSwapChainExtent().height);
 	ubo.time = static_cast<float>(glfwGetTime());
+	m_globalUboOffset = m_uniformRing->push(ubo);
+}
 
+void Renderer::updateLightUBO()
+{
+	LightUniformBufferObject light = {};
 	float yawRad = glm::radians(m_lightYaw);
 	float pitchRad = glm::radians(m_lightPitch);
 
@@ -218,8 +239,8 @@ void Renderer::updateGlbUBO()
 	dir = glm::normalize(dir);
 
 	// 计算旋转后的方向并归一化
-	ubo.lightDir = glm::vec4(dir, 0.0f);
-	ubo.lightColor = m_lightColor; 
+	light.lightDir = glm::vec4(dir, 0.0f);
+	light.lightColor = m_lightColor;
 
 	//生成光源出深度贴图的VP矩阵
 	float sceneRadius = 14.0f;
@@ -243,8 +264,22 @@ void Renderer::updateGlbUBO()
 	}
 
 	glm::mat4 lightView = glm::lookAt(lightPos, sceneCenter, upVector);
-	ubo.lightMat = lightProjection * lightView;
-	m_gblUniformBuffers[m_currentFrame]->update(&ubo);
+	light.lightMat = lightProjection * lightView;
+
+	//只写变了的字段，没动滑条的帧不产生任何拷贝
+	if (light.lightDir != m_light.lightDir)
+	{
+		m_lightBuffer->write(offsetof(LightUniformBufferObject, lightDir), light.lightDir);
+	}
+	if (light.lightColor != m_light.lightColor)
+	{
+		m_lightBuffer->write(offsetof(LightUniformBufferObject, lightColor), light.lightColor);
+	}
+	if (light.lightMat != m_light.lightMat)
+	{
+		m_lightBuffer->write(offsetof(LightUniformBufferObject, lightMat), light.lightMat);
+	}
+	m_light = light;
 }
 
 
@@ -279,6 +314,7 @@ void Renderer::createSyncObjects()
 	m_imageAvailableSemaphores.resize(n);
 	m_renderFinishedSemaphores.resize(n);
 	m_inFlightFences.resize(n);
+	m_frameSerials.assign(m_MAX_FRAMES_IN_FLIGHT, 0);
 
 	VkSemaphoreCreateInfo semaphoreInfo = {};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -320,14 +356,59 @@ void Renderer::createCommandBuffers()
 	}
 }
 
-void Renderer::createGlobalUniformBuffers()
+void Renderer::createUniformRing()
+{
+	//全局UBO和各材质每帧的uniform数据都从这里分，每帧1MB足够
+	m_uniformRing = std::make_unique<UniformRing>(m_device, 1024 * 1024, m_MAX_FRAMES_IN_FLIGHT);
+	m_frameArena = std::make_unique<FrameArena>(256 * 1024);
+	m_lightBuffer = createTrackedBuffer(sizeof(LightUniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Uniform);
+}
+
+std::shared_ptr<TrackedBuffer> Renderer::createTrackedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage)
 {
-	m_gblUniformBuffers.resize(m_MAX_FRAMES_IN_FLIGHT);
-	for (size_t i = 0; i < m_gblUniformBuffers.size(); i++)
+	std::shared_ptr<TrackedBuffer> buffer = std::make_shared<TrackedBuffer>(m_device, size, usage, m_MAX_FRAMES_IN_FLIGHT, memoryUsage);
+	m_trackedBuffers.push_back(buffer);
+	return buffer;
+}
+
+void Renderer::flushTrackedBuffers(VkCommandBuffer cmd)
+{
+	m_trackedStats.frameBytes = 0;
+	m_trackedStats.frameWrites = 0;
+	m_trackedStats.frameRegions = 0;
+	m_trackedStats.bufferCount = 0;
+
+	//顺手清掉已经销毁的
+	m_trackedBuffers.erase(std::remove_if(m_trackedBuffers.begin(), m_trackedBuffers.end(),
+		[](const std::weak_ptr<TrackedBuffer>& buffer) { return buffer.expired(); }), m_trackedBuffers.end());
+
+	bool dirty = false;
+	for (const auto& weak : m_trackedBuffers)
+	{
+		std::shared_ptr<TrackedBuffer> buffer = weak.lock();
+		dirty = dirty || buffer->isDirty();
+	}
+	if (!dirty)
+	{
+		m_trackedStats.bufferCount = static_cast<uint32_t>(m_trackedBuffers.size());
+		return;
+	}
+
+	//之前的帧可能还在读这些 buffer，拷贝要等它们的读取结束（只需要执行依赖）
+	VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	vkCmdPipelineBarrier(cmd, readStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	for (const auto& weak : m_trackedBuffers)
 	{
-		m_gblUniformBuffers[i] = std::make_unique<UniformBuffer>(m_device, sizeof(GlobalUniformBufferObject));
-		
+		weak.lock()->recordCopies(cmd, static_cast<uint32_t>(m_currentFrame), *m_frameArena, m_trackedStats);
 	}
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	m_trackedStats.totalBytes += m_trackedStats.frameBytes;
 }
 
 void Renderer::createSamplers()
@@ -399,7 +480,7 @@ void Renderer::createShadowMapFramebuffers()
 {
 	VkExtent2D extent = { 2048,2048 };
 	std::vector<VkImageView> attachs = { m_shadowDepthTex->getImageView() };
-	m_shadowPassframebuffer = std::make_unique<Framebuffer>(m_device.getLogicalDevice(),
+	m_shadowPassframebuffer = std::make_unique<Framebuffer>(m_device,
 			m_shadowRenderPass->getHandle(), extent, attachs);
 }
 
@@ -422,14 +503,14 @@ void Renderer::createShadowDepthResources()
 		throw std::runtime_error("failed to allocate shadow descriptor sets!");
 	}
 
-	// 3. 插线上电 (更新：我们只需要绑一个全局的 UBO 即可)
+	// 3. 插线上电 (更新：我们只需要绑一个光源的 UBO 即可)
 	for (size_t i = 0; i < m_MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		// 绑定你每帧的 Global UBO
-		VkDescriptorBufferInfo globalBufferInfo{};
-		globalBufferInfo.buffer = m_gblUniformBuffers[i]->getHandle(); // 取出你 renderer 里的 UBO buffer
-		globalBufferInfo.offset = 0;
-		globalBufferInfo.range = sizeof(GlobalUniformBufferObject);
+		// 阴影 pass 只需要光源矩阵，绑光源的 TrackedBuffer
+		VkDescriptorBufferInfo lightBufferInfo{};
+		lightBufferInfo.buffer = m_lightBuffer->getHandle();
+		lightBufferInfo.offset = 0;
+		lightBufferInfo.range = sizeof(LightUniformBufferObject);
 
 		VkWriteDescriptorSet descriptorWrite{};
 		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -438,7 +519,7 @@ void Renderer::createShadowDepthResources()
 		descriptorWrite.dstArrayElement = 0;
 		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &globalBufferInfo;
+		descriptorWrite.pBufferInfo = &lightBufferInfo;
 
 		// 提交写入
 		vkUpdateDescriptorSets(m_device.getLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
@@ -455,7 +536,7 @@ void Renderer::createSwapchainFrameBuffers()
 	{
 		std::vector<VkImageView> attachs = { swapchainImageViews[i], m_depthTex->getImageView() };
 
-		m_framebuffers.push_back(std::make_unique<Framebuffer>(m_device.getLogicalDevice(),
+		m_framebuffers.push_back(std::make_unique<Framebuffer>(m_device,
 			m_RenderPass->getHandle(), m_swapchain->getSwapChainExtent(), attachs));
 	}
 }
@@ -5,6 +5,9 @@
 #include "../Core/Devices.h"
 #include "../Graphics/Swapchain.h"
 #include "../Buffer.h"
+#include "../Core/UniformRing.h"
+#include "../Core/TrackedBuffer.h"
+#include "../Core/FrameArena.h"
 #include "../Graphics/Camera.h"
 #include "../Graphics/RenderPass.h"
 #include "../Graphics/Framebuffer.h"
@@ -14,10 +17,14 @@
 struct GlobalUniformBufferObject {
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
-	alignas(16) glm::vec4 lightDir;   
+	alignas(16) float time;
+};
+
+// 光源只在调节的时候才变，放在常驻显存的 TrackedBuffer 里，不变的帧不产生上传
+struct LightUniformBufferObject {
+	alignas(16) glm::vec4 lightDir;
 	alignas(16) glm::vec4 lightColor;
 	alignas(16) glm::mat4 lightMat;
-	alignas(16) float time;
 };
 
 class Renderer
@@ -37,6 +44,8 @@ public:
 	void beginRenderPass(VkCommandBuffer cmd, RenderPass& renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
 	void endRenderPass(VkCommandBuffer cmd);
 	void updateGlbUBO();
+	//只改 CPU 端的影子数据，要在 beginFrame 之前调用，这一帧开头录制的拷贝才能带上
+	void updateLightUBO();
 	void createRenderPass();
 	void createSwapchainFrameBuffers();
 	void cleanupSwapChainAssets();
@@ -53,7 +62,13 @@ public:
 	std::vector<std::unique_ptr<Framebuffer>>& getFrameBuffers() { return m_framebuffers; }
 	RenderPass& getRenderPass() { return *m_RenderPass; }
 	RenderPass& getShadowRenderPass() { return *m_shadowRenderPass; }
-	std::vector<std::unique_ptr<UniformBuffer>>& getGlbUniformBuffers() { return m_gblUniformBuffers; }
+	UniformRing& getUniformRing() { return *m_uniformRing; }
+	FrameArena& getFrameArena() { return *m_frameArena; } // 本帧的临时 CPU 内存，下一次 beginFrame 清空
+	//常驻显存、按脏区间增量更新的 buffer；Renderer 只持有弱引用，每帧开头统一录制拷贝
+	std::shared_ptr<TrackedBuffer> createTrackedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage = MemoryUsage::Other);
+	const TrackedUploadStats& getTrackedUploadStats() const { return m_trackedStats; }
+	uint32_t getGlobalUboOffset() const { return m_globalUboOffset; } // 本帧全局 UBO 在 uniform 环里的动态偏移
+	VkBuffer getLightBuffer() const { return m_lightBuffer->getHandle(); }
 	const std::shared_ptr<Texture> getshadowTexture() const { return m_shadowDepthTex; }
 	const std::shared_ptr<Pipeline> getShadowPipeline() const { return m_shadowPipeline; }
 	VkDescriptorSet getShadowDescriptorSet(uint32_t frameIndex) { return m_shadowDescriptorSets[frameIndex]; }
@@ -87,14 +102,22 @@ private:
 	std::vector<VkSemaphore> m_imageAvailableSemaphores;
 	std::vector<VkSemaphore> m_renderFinishedSemaphores;
 	std::vector<VkFence> m_inFlightFences;
+	std::vector<uint64_t> m_frameSerials; // 每个槽最近一次提交的帧序号，fence signal 后交给删除队列
 	
-	std::vector<std::unique_ptr<UniformBuffer>> m_gblUniformBuffers;
+	std::unique_ptr<UniformRing> m_uniformRing;
+	std::unique_ptr<FrameArena> m_frameArena;
+	uint32_t m_globalUboOffset = 0;
+	std::vector<std::weak_ptr<TrackedBuffer>> m_trackedBuffers;
+	TrackedUploadStats m_trackedStats;
+	std::shared_ptr<TrackedBuffer> m_lightBuffer;
+	LightUniformBufferObject m_light = {}; // 上一次写进 m_lightBuffer 的内容
 	std::vector<std::unique_ptr<Framebuffer>> m_framebuffers;
 	std::unique_ptr<Framebuffer> m_shadowPassframebuffer;
 	
 	void createSyncObjects();
 	void createCommandBuffers();
-	void createGlobalUniformBuffers();
+	void createUniformRing();
+	void flushTrackedBuffers(VkCommandBuffer cmd);
 	void createSamplers();
 	void createShadowMapFramebuffers();
 	void createShadowDepthResources();
@@ -0,0 +1,192 @@
+﻿#include "ModelLoader.h"
+#include "../Graphics/MeshStreamer.h"
+#include <algorithm>
+
+ModelLoader::ModelLoader(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::clamp(std::thread::hardware_concurrency(), 1u, 2u);
+	}
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back(&ModelLoader::workerLoop, this);
+	}
+}
+
+ModelLoader::~ModelLoader()
+{
+	//还在排队的直接丢掉，正在加载的等它做完
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_queue.clear();
+	}
+	m_workAvailable.notify_all();
+	m_spaceAvailable.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ModelLoader::enqueue(const std::string& path, size_t streamingBudget)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back({ path, streamingBudget });
+	}
+	m_workAvailable.notify_one();
+}
+
+void ModelLoader::collect(std::vector<Result>& finished)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Result& result : m_finished)
+		{
+			finished.push_back(std::move(result));
+		}
+		m_finished.clear();
+	}
+	m_spaceAvailable.notify_all();
+}
+
+ModelLoader::Result ModelLoader::wait(const std::string& path)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto queued = std::find_if(m_queue.begin(), m_queue.end(), [&](const Job& job) { return job.path == path; });
+	if (queued != m_queue.end() && queued->streamingBudget == 0)
+	{
+		//还没有工作线程拿到，与其等排在前面的任务，不如自己做
+		m_queue.erase(queued);
+		lock.unlock();
+		return run(path);
+	}
+
+	while (true)
+	{
+		auto done = std::find_if(m_finished.begin(), m_finished.end(), [&](const Result& result) { return result.path == path; });
+		if (done != m_finished.end())
+		{
+			Result result = std::move(*done);
+			m_finished.erase(done);
+			lock.unlock();
+			m_spaceAvailable.notify_all();
+			return result;
+		}
+		m_workDone.wait(lock);
+	}
+}
+
+uint32_t ModelLoader::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<uint32_t>(m_queue.size()) + m_running;
+}
+
+void ModelLoader::workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workAvailable.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+			if (m_stop)
+			{
+				return;
+			}
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+			m_running++;
+		}
+
+		if (job.streamingBudget > 0)
+		{
+			stream(job.path, job.streamingBudget);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running--;
+			continue;
+		}
+
+		Result result = run(job.path);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_finished.push_back(std::move(result));
+			m_running--;
+		}
+		m_workDone.notify_all();
+	}
+}
+
+ModelLoader::Result ModelLoader::run(const std::string& path)
+{
+	Result result;
+	result.path = path;
+	try
+	{
+		result.data = Model::load(path);
+	}
+	catch (...)
+	{
+		//异常不能跨线程抛，带回主线程再重新抛出
+		result.error = std::current_exception();
+	}
+	return result;
+}
+
+void ModelLoader::stream(const std::string& path, size_t memoryBudget)
+{
+	//排队等上传的块也算在预算里，最多占 1/8；主线程每帧都会取走，正常情况下不会堵住
+	constexpr size_t kChunkBytes = MeshStreamer::kMaxChunkVertices * (sizeof(PackedVertex) + 6 * sizeof(uint32_t));
+	size_t maxQueued = std::max<size_t>(2, std::max(memoryBudget, MeshStreamer::kMinMemoryBudget) / 8 / kChunkBytes);
+
+	Result last;
+	last.path = path;
+	try
+	{
+		MeshStreamer::ingest(path, memoryBudget, [&](const MeshBounds& bounds, const StreamedChunk& chunk) {
+			std::unique_ptr<ModelData> data = std::make_unique<ModelData>();
+			data->path = path;
+			data->chunk = true;
+			data->bounds = bounds;
+			data->quantization = VertexQuantization::fromBounds(bounds.min, bounds.max);
+			data->vertices.assign(chunk.vertices, chunk.vertices + chunk.vertexCount);
+			data->indices.assign(chunk.indices, chunk.indices + chunk.indexCount);
+			data->lods.push_back({ 0, chunk.indexCount, 0.0f });
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_spaceAvailable.wait(lock, [&]() { return m_stop || countFinished(path) < maxQueued; });
+				if (m_stop)
+				{
+					return false;
+				}
+				Result result;
+				result.path = path;
+				result.data = std::move(data);
+				result.partial = true;
+				m_finished.push_back(std::move(result));
+			}
+			m_workDone.notify_all();
+			return true;
+		});
+	}
+	catch (...)
+	{
+		last.error = std::current_exception();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_finished.push_back(std::move(last));
+	}
+	m_workDone.notify_all();
+}
+
+size_t ModelLoader::countFinished(const std::string& path) const
+{
+	return static_cast<size_t>(std::count_if(m_finished.begin(), m_finished.end(), [&](const Result& result) { return result.path == path; }));
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+#include "../Graphics/Model.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 后台模型加载：几个工作线程从队列里取路径，调 Model::load 做解析、焊接、优化这些 CPU 的活
+// 不碰 Vulkan，结果放进完成队列，由主线程在帧边界取走再统一上传
+// 流式导入的模型每完成一块就交出一个部分结果，排着等主线程取的块受内存预算限制，满了工作线程就停下来等
+// 同一个路径只应该入队一次，去重由 Scene 的模型缓存负责
+class ModelLoader
+{
+public:
+	// 一次加载的结果，失败时 data 为空、error 里是工作线程抛出的异常
+	// 流式导入时每块一个 partial 的结果，最后再来一个 data 为空、不是 partial 的结果表示结束
+	struct Result
+	{
+		std::string path;
+		std::unique_ptr<ModelData> data;
+		std::exception_ptr error;
+		bool partial = false;
+	};
+
+	//workerCount 为 0 时按硬件线程数取，最多 2 个：OBJ 解析本身已经是多线程的，再多只会互相抢
+	explicit ModelLoader(uint32_t workerCount = 0);
+	~ModelLoader();
+
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+
+	//streamingBudget 不为 0 时按流式导入处理，峰值内存不超过这个预算
+	void enqueue(const std::string& path, size_t streamingBudget = 0);
+	//非阻塞：把已经完成的结果全部移到 finished 末尾
+	void collect(std::vector<Result>& finished);
+	//阻塞直到 path 有结果并取走一个；还没开始的普通加载直接在当前线程做
+	Result wait(const std::string& path);
+
+	//排队中和正在加载的个数，不含已完成未取走的
+	uint32_t getPendingCount();
+
+private:
+	struct Job
+	{
+		std::string path;
+		size_t streamingBudget = 0;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_workAvailable;
+	std::condition_variable m_workDone;
+	std::condition_variable m_spaceAvailable; // 主线程取走结果后通知流式导入继续
+	std::deque<Job> m_queue;
+	std::vector<Result> m_finished;
+	uint32_t m_running = 0;
+	bool m_stop = false;
+
+	void workerLoop();
+	static Result run(const std::string& path);
+	//在工作线程上导入，每块直接放进完成队列
+	void stream(const std::string& path, size_t memoryBudget);
+	size_t countFinished(const std::string& path) const;
+};
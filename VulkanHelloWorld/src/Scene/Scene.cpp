@@ -1,25 +1,204 @@
-#include "Scene.h"
+﻿#include "Scene.h"
+#include "StaticBatcher.h"
+#include <algorithm>
+#include <iostream>
 
 
-Scene::Scene(Devices& device) : m_device(device)
+Scene::Scene(Devices& device) : m_device(device), m_startTime(Clock::now())
 {
-
+	m_geometryPool = std::make_shared<GeometryPool>(m_device, PackedVertex::getLayout());
+	m_loader = std::make_unique<ModelLoader>();
 }
 
 std::shared_ptr<Model> Scene::loadModel(const std::string& path)
+{
+	if (m_modelCache.contains(path))
+	{
+		std::shared_ptr<Model> mod = m_modelCache[path];
+		//后台还在加载的话等它做完；流式导入会陆续交出多个分块，一直等到最后一个
+		while (m_pendingModels.contains(path))
+		{
+			std::vector<ModelLoader::Result> results;
+			results.push_back(m_loader->wait(path));
+			installModels(results);
+		}
+		return mod;
+	}
+
+
+	std::shared_ptr<Model> mod = std::make_shared<Model>(m_device, m_geometryPool, path);
+	m_models.push_back(mod);
+	m_modelCache[path] = mod;
+	return mod;
+}
+
+std::shared_ptr<Model> Scene::loadModelAsync(const std::string& path)
 {
 	if (m_modelCache.contains(path))
 	{
 		return m_modelCache[path];
 	}
 
+	std::shared_ptr<Model> mod = std::make_shared<Model>(m_device, m_geometryPool);
+	m_models.push_back(mod);
+	m_modelCache[path] = mod;
+	m_pendingModels[path] = mod;
+	m_requestTimes[path] = Clock::now();
+	m_loader->enqueue(path);
+	return mod;
+}
+
+std::shared_ptr<Model> Scene::loadModelStreaming(const std::string& path, size_t memoryBudget)
+{
+	if (m_modelCache.contains(path))
+	{
+		return m_modelCache[path];
+	}
 
-	std::shared_ptr<Model> mod = std::make_shared<Model>(m_device, path);
+	std::shared_ptr<Model> mod = std::make_shared<Model>(m_device, m_geometryPool);
 	m_models.push_back(mod);
 	m_modelCache[path] = mod;
+	m_pendingModels[path] = mod;
+	m_requestTimes[path] = Clock::now();
+	m_loader->enqueue(path, memoryBudget);
 	return mod;
 }
 
+void Scene::update()
+{
+	//先补传已有模型的下一级，这一帧新到的模型只传最粗的一级，不和补传抢同一帧
+	refineModels();
+	if (m_pendingModels.empty())
+	{
+		return;
+	}
+	std::vector<ModelLoader::Result> results;
+	m_loader->collect(results);
+	installModels(results);
+}
+
+void Scene::refineModels()
+{
+	if (m_refinements.empty())
+	{
+		return;
+	}
+	UploadBatch batch(m_device);
+	for (Refinement& refinement : m_refinements)
+	{
+		refinement.model->uploadLod(batch, *refinement.data, 0, refinement.model->getAvailableLod() - 1);
+	}
+	UploadToken token = batch.submit();
+	for (Refinement& refinement : m_refinements)
+	{
+		refinement.model->setReady(token);
+		if (refinement.model->getAvailableLod() == 0)
+		{
+			std::cout << "progressive load: " << refinement.path << " coarsest level after " << refinement.firstLevelMs
+				<< " ms, full detail after " << elapsedMs(m_requestTimes[refinement.path]) << " ms" << std::endl;
+			m_requestTimes.erase(refinement.path);
+		}
+	}
+	//第 0 级传完的不再补传，CPU 端的数据随之释放
+	std::erase_if(m_refinements, [](const Refinement& refinement) { return refinement.model->getAvailableLod() == 0; });
+}
+
+void Scene::installModels(std::vector<ModelLoader::Result>& results)
+{
+	if (results.empty())
+	{
+		return;
+	}
+	//出错的结果先挑出来，同一批里成功的照常装上，最后再报第一个错误
+	std::exception_ptr error;
+	std::vector<std::string> failed;
+	std::erase_if(results, [&](const ModelLoader::Result& result) {
+		if (!result.error)
+		{
+			return false;
+		}
+		if (!error)
+		{
+			error = result.error;
+		}
+		failed.push_back(result.path);
+		return true;
+	});
+
+	//先给这一批的模型都切好区间，几何池扩容只会发生在这一步，之后录进同一批的写入不会落在旧 buffer 上
+	//流式导入结束的标记没有数据，只用来把模型移出等待列表
+	std::vector<uint32_t> parts(results.size());
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (results[i].data)
+		{
+			parts[i] = m_pendingModels[results[i].path]->allocate(*results[i].data);
+		}
+	}
+	//多级 LOD 的单个网格可以渐进加载：这一批只传最粗的一级，它的顶点排在最前面，之后每帧补一级
+	auto isProgressive = [this](const ModelLoader::Result& result) {
+		return m_progressiveLoading && result.data && !result.data->chunk && result.data->submeshes.empty() && result.data->lods.size() > 1;
+	};
+	UploadToken token = 0;
+	if (std::any_of(results.begin(), results.end(), [](const ModelLoader::Result& result) { return result.data != nullptr; }))
+	{
+		UploadBatch batch(m_device);
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			if (isProgressive(results[i]))
+			{
+				uint32_t coarsest = static_cast<uint32_t>(results[i].data->lods.size()) - 1;
+				m_pendingModels[results[i].path]->uploadLod(batch, *results[i].data, parts[i], coarsest);
+			}
+			else if (results[i].data)
+			{
+				m_pendingModels[results[i].path]->upload(batch, *results[i].data, parts[i]);
+			}
+		}
+		token = batch.submit();
+	}
+	for (ModelLoader::Result& result : results)
+	{
+		std::shared_ptr<Model> model = m_pendingModels[result.path];
+		if (result.data)
+		{
+			model->setReady(token);
+		}
+		if (result.partial)
+		{
+			continue;
+		}
+		m_pendingModels.erase(result.path);
+		if (isProgressive(result))
+		{
+			double firstLevelMs = elapsedMs(m_requestTimes[result.path]);
+			m_refinements.push_back({ result.path, model, std::move(result.data), firstLevelMs });
+			continue;
+		}
+		std::cout << "async load: " << result.path << " ready after " << elapsedMs(m_requestTimes[result.path]) << " ms" << std::endl;
+		m_requestTimes.erase(result.path);
+	}
+
+	//加载失败的占位模型从缓存里拿掉，之后再请求同一路径会重新加载
+	//流式导入可能已经装上了前几块，实体还引用着这个模型：标记为没准备好并归还区间，不再画出半个网格
+	for (const std::string& path : failed)
+	{
+		m_pendingModels.erase(path);
+		m_requestTimes.erase(path);
+		auto cached = m_modelCache.find(path);
+		if (cached != m_modelCache.end())
+		{
+			cached->second->unload();
+			std::erase(m_models, cached->second);
+			m_modelCache.erase(cached);
+		}
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
 std::shared_ptr<Texture> Scene::loadTexture(const std::string& path)
 {
 	if (m_textureCache.contains(path))
@@ -62,19 +241,137 @@ void Scene::addEntity(std::shared_ptr<Model> model, std::shared_ptr<Material> ma
 	m_entities.push_back(std::make_unique<Entity>(model, material));
 }
 
-void Scene::drawMain(VkCommandBuffer cmd, uint32_t currentFrame)
+std::vector<Entity*> Scene::addModelEntities(const std::shared_ptr<Model>& model,
+	const std::function<std::shared_ptr<Material>(std::shared_ptr<Texture>)>& makeMaterial)
 {
+	const std::vector<ModelMaterial>& materials = model->getMaterials();
+	std::vector<std::shared_ptr<Material>> created(materials.size());
+	std::vector<Entity*> entities;
+	for (uint32_t i = 0; i < model->getSubmeshes().size(); i++)
+	{
+		uint32_t index = model->getSubmeshes()[i].material;
+		//只给用到的材质建 Material
+		if (!created[index])
+		{
+			const ModelMaterial& material = materials[index];
+			std::shared_ptr<Texture> texture;
+			if (!material.image.empty())
+			{
+				texture = Texture::loadFromMemory(m_device, material.image.data(), material.image.size());
+				m_textures.push_back(texture);
+			}
+			else
+			{
+				//纯色贴图的像素按 RGBA 字节顺序存，小端的 uint32 里 R 在最低位
+				glm::uvec4 color = glm::uvec4(glm::round(glm::clamp(material.baseColor, 0.0f, 1.0f) * 255.0f));
+				texture = loadTexture(color.r | (color.g << 8) | (color.b << 16) | (color.a << 24));
+			}
+			created[index] = makeMaterial(texture);
+			addMaterial(created[index]);
+		}
+		m_entities.push_back(std::make_unique<Entity>(model, created[index], i));
+		entities.push_back(m_entities.back().get());
+	}
+	return entities;
+}
+
+uint32_t Scene::buildStaticBatches(float cellSize)
+{
+	std::vector<Entity*> sources;
+	for (const std::unique_ptr<Entity>& entity : m_entities)
+	{
+		if (StaticBatcher::canBatch(*entity))
+		{
+			sources.push_back(entity.get());
+		}
+	}
+	if (sources.empty())
+	{
+		return 0;
+	}
+	std::vector<StaticBatcher::Batch> batches = StaticBatcher::build(sources, cellSize);
+
+	//和 installModels 一样先全部 allocate 再录进同一批，一次提交
+	std::vector<std::shared_ptr<Model>> models;
+	std::vector<uint32_t> parts;
+	for (StaticBatcher::Batch& batch : batches)
+	{
+		models.push_back(std::make_shared<Model>(m_device, m_geometryPool));
+		parts.push_back(models.back()->allocate(*batch.data));
+	}
+	UploadBatch upload(m_device);
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		models[i]->upload(upload, *batches[i].data, parts[i]);
+	}
+	UploadToken token = upload.submit();
+
+	//被合并的实体换成每格一个实体，顶点已经在世界空间里，模型矩阵保持单位矩阵
+	std::erase_if(m_entities, [&](const std::unique_ptr<Entity>& entity) {
+		return std::find(sources.begin(), sources.end(), entity.get()) != sources.end();
+	});
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		models[i]->setReady(token);
+		m_models.push_back(models[i]);
+		m_entities.push_back(std::make_unique<Entity>(models[i], batches[i].material));
+	}
+	std::cout << "static batching: " << sources.size() << " entities -> " << batches.size() << " batches" << std::endl;
+	return static_cast<uint32_t>(batches.size());
+}
+
+void Scene::drawMain(VkCommandBuffer cmd, uint32_t currentFrame, uint32_t globalUboOffset, const DrawView& view)
+{
+	//切换管线不会影响顶点/索引绑定，顶点整个 pass 绑一次，索引只在 16/32 位切换时重新绑
+	m_geometryPool->bind(cmd);
+	VkIndexType boundType = VK_INDEX_TYPE_MAX_ENUM;
+	m_mainStats = DrawStats{};
 	for (auto& entity : m_entities)
 	{
-		entity->drawMain(cmd, currentFrame);
+		//模型还在后台加载的实体这一帧先不画，换上之后自然出现
+		if (!entity->getModel()->isReady())
+		{
+			continue;
+		}
+		bindIndices(cmd, entity->getModel()->getRange().indexType, boundType);
+		entity->drawMain(cmd, currentFrame, globalUboOffset, view, m_mainStats);
+	}
+
+	if (m_loadMetrics.firstPixelMs < 0.0 && m_mainStats.entities > 0)
+	{
+		m_loadMetrics.firstPixelMs = elapsedMs(m_startTime);
+		std::cout << "time to first pixel: " << m_loadMetrics.firstPixelMs << " ms" << std::endl;
+	}
+	if (m_loadMetrics.firstPixelMs >= 0.0 && m_loadMetrics.fullDetailMs < 0.0 && m_pendingModels.empty() && m_refinements.empty())
+	{
+		m_loadMetrics.fullDetailMs = elapsedMs(m_startTime);
+		std::cout << "time to full detail: " << m_loadMetrics.fullDetailMs << " ms" << std::endl;
 	}
 }
 
-void Scene::drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout)
+void Scene::drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout, const DrawView& view)
 {
+	//阴影管线只有位置流一个 binding
+	m_geometryPool->bindPositions(cmd);
+	VkIndexType boundType = VK_INDEX_TYPE_MAX_ENUM;
+	m_shadowStats = DrawStats{};
 	for (auto& entity : m_entities)
 	{
-		entity->drawforShadow(cmd, shadowPipelineLayout);
+		if (!entity->getModel()->isReady())
+		{
+			continue;
+		}
+		bindIndices(cmd, entity->getModel()->getRange().indexType, boundType);
+		entity->drawforShadow(cmd, shadowPipelineLayout, view, m_shadowStats);
+	}
+}
+
+void Scene::bindIndices(VkCommandBuffer cmd, VkIndexType indexType, VkIndexType& boundType)
+{
+	if (indexType != boundType)
+	{
+		m_geometryPool->bindIndices(cmd, indexType);
+		boundType = indexType;
 	}
 }
 
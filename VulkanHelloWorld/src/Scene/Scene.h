@@ -1,14 +1,26 @@
-#pragma once
+﻿#pragma once
 #include "../Core/Devices.h"
 #include "../Graphics/Model.h"
+#include "../Graphics/GeometryPool.h"
 #include "../Graphics/Texture.h"
 #include "../Graphics/Material.h"
 #include "../Graphics/Entity.h"
+#include "ModelLoader.h"
 #include<vector>
+#include<chrono>
+#include<functional>
 #include<memory>
 #include<string>
 #include<unordered_map>
 
+// 启动耗时，毫秒，从 Scene 创建开始算，还没发生时为负数
+// firstPixel：第一次有实体被录进主 pass；fullDetail：没有在加载的模型、所有 LOD 都已传完之后录制的第一帧
+struct LoadMetrics
+{
+	double firstPixelMs = -1.0;
+	double fullDetailMs = -1.0;
+};
+
 class Scene
 {
 public:
@@ -18,30 +30,87 @@ public:
 	Scene(const Scene&) = delete;
 	Scene& operator=(const Scene&) = delete;
 
+	//同步加载，返回时已经可以绘制；同一路径正在后台加载时等它完成
 	std::shared_ptr<Model> loadModel(const std::string& path);
+	//立刻返回一个还没准备好的模型，解析在后台线程进行，update 时换上；没准备好的模型绘制时直接跳过
+	std::shared_ptr<Model> loadModelAsync(const std::string& path);
+	//流式导入放不进内存的大网格，峰值内存不超过 memoryBudget；和 loadModelAsync 一样立刻返回，之后每帧换上已经完成的分块
+	std::shared_ptr<Model> loadModelStreaming(const std::string& path, size_t memoryBudget);
 	std::shared_ptr<Texture> loadTexture(const std::string& path);
 	std::shared_ptr<Texture> loadTexture(uint32_t color);
 
 	void addMaterial(const std::shared_ptr<Material> mat);
 	void addEntity(std::unique_ptr<Entity> entity);
 	void addEntity(std::shared_ptr<Model> model, std::shared_ptr<Material> material);
+	//模型自带的材质（GLB）各建一个 Material：基础色贴图在这里创建（没有贴图时用 baseColor 的纯色贴图），管线和其它绑定由 makeMaterial 决定
+	//每个子网格加一个实体，返回这些实体，调用方可以再摆位置；模型要已经准备好（用 loadModel 同步加载）
+	std::vector<Entity*> addModelEntities(const std::shared_ptr<Model>& model,
+		const std::function<std::shared_ptr<Material>(std::shared_ptr<Texture>)>& makeMaterial);
+
+	//把标记为静态、模型已经准备好的实体按材质和 cellSize 大小的格子合并成新模型，原来的实体被替换掉；返回合并出的批次数
+	//合并后的实体不再是静态的，再调用一次只会合并之后新加的静态实体
+	uint32_t buildStaticBatches(float cellSize);
 
-	void drawMain(VkCommandBuffer cmd, uint32_t currentFrame);
-	void drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout);
+	//帧边界调用（录制这一帧之前）：把后台已经完成的模型和分块合成一批上传并标记为可绘制，
+	//再给渐进加载的模型各补传一级更细的 LOD
+	void update();
+	//开启时（默认）后台加载完的多级 LOD 模型先只传最粗的一级就开始画，之后每帧补一级，直到第 0 级
+	void setProgressiveLoading(bool enabled) { m_progressiveLoading = enabled; }
+
+	void drawMain(VkCommandBuffer cmd, uint32_t currentFrame, uint32_t globalUboOffset, const DrawView& view);
+	void drawforShadow(VkCommandBuffer cmd, VkPipelineLayout shadowPipelineLayout, const DrawView& view);
 
 	std::vector<std::shared_ptr<Model>>& getModels(){ return m_models; }
 	std::vector<std::shared_ptr<Texture>>& getTextures() { return m_textures; }
 	std::vector<std::shared_ptr<Material>>& getMaterials() { return m_materials; }
+	GeometryPool& getGeometryPool() { return *m_geometryPool; }
+	uint32_t getPendingModelCount() const { return static_cast<uint32_t>(m_pendingModels.size()); }
+	//已经能画、还在逐级补传细节的模型数
+	uint32_t getRefiningModelCount() const { return static_cast<uint32_t>(m_refinements.size()); }
+	const LoadMetrics& getLoadMetrics() const { return m_loadMetrics; }
+	//最近一帧各 pass 实际提交的三角形和簇，LOD 和簇剔除生效时会比原始网格少
+	const DrawStats& getMainStats() const { return m_mainStats; }
+	const DrawStats& getShadowStats() const { return m_shadowStats; }
 
 private:
 	Devices& m_device;
+	//所有模型共用的顶点/索引池；Model 也持有一份，保证延迟释放区间时池还活着
+	std::shared_ptr<GeometryPool> m_geometryPool;
 
 	std::vector<std::shared_ptr<Model>> m_models;
 	std::vector<std::shared_ptr<Texture>> m_textures;
 	std::vector<std::shared_ptr<Material>> m_materials;
 
+	//后台加载中的模型也已经在 m_modelCache 里，同一路径重复请求拿到的是同一个对象，只会入队一次
 	std::unordered_map<std::string, std::shared_ptr<Model>> m_modelCache;
+	std::unordered_map<std::string, std::shared_ptr<Model>> m_pendingModels;
+	std::unique_ptr<ModelLoader> m_loader;
 	std::unordered_map<std::string, std::shared_ptr<Texture>> m_textureCache;
 
+	//渐进加载：CPU 端的数据留到第 0 级传完，每帧补传模型已有的最细一级的下一级
+	struct Refinement
+	{
+		std::string path;
+		std::shared_ptr<Model> model;
+		std::unique_ptr<ModelData> data;
+		double firstLevelMs; // 从请求到最粗一级可以绘制
+	};
+	bool m_progressiveLoading = true;
+	std::vector<Refinement> m_refinements;
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point m_startTime;
+	std::unordered_map<std::string, Clock::time_point> m_requestTimes;
+	LoadMetrics m_loadMetrics;
+
 	std::vector<std::unique_ptr<Entity>> m_entities;
+	DrawStats m_mainStats;
+	DrawStats m_shadowStats;
+
+	void bindIndices(VkCommandBuffer cmd, VkIndexType indexType, VkIndexType& boundType);
+	//把加载结果上传进几何池，整批共用一次提交
+	void installModels(std::vector<ModelLoader::Result>& results);
+	//每个渐进加载的模型补传一级，整批一次提交
+	void refineModels();
+	static double elapsedMs(Clock::time_point since) { return std::chrono::duration<double, std::milli>(Clock::now() - since).count(); }
 };
@@ -0,0 +1,169 @@
+﻿#include "StaticBatcher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	//一个实体要合并进来的一段几何：源模型的顶点和第 0 级（或者一个子网格）的索引
+	struct Piece
+	{
+		const PackedVertex* vertices;
+		uint32_t vertexCount;
+		const void* indices;
+		uint32_t indexCount;
+		bool index16;
+	};
+
+	void collectPieces(const ModelData& data, uint32_t submesh, std::vector<Piece>& pieces)
+	{
+		if (data.submeshes.empty())
+		{
+			const MeshLod& lod = data.lods[0];
+			pieces.push_back({ static_cast<const PackedVertex*>(data.getVertices()), data.getVertexCount(), data.getIndices() + lod.indexOffset, lod.indexCount, false });
+			return;
+		}
+		bool index16 = data.indexType == VK_INDEX_TYPE_UINT16;
+		for (uint32_t i = 0; i < data.submeshes.size(); i++)
+		{
+			if (submesh == Entity::kWholeModel || submesh == i)
+			{
+				const Submesh& part = data.submeshes[i];
+				pieces.push_back({ static_cast<const PackedVertex*>(data.sources[i].vertices), part.vertexCount, data.sources[i].indices, part.indexCount, index16 });
+			}
+		}
+	}
+
+	//压缩顶点还原成 Vertex，位置和法线一起变换到世界空间
+	//镜像变换（行列式为负）会把三角形的绕序翻过来，预变换之后要把每个三角形的两个索引对调，背面剔除才仍然正确
+	void appendPiece(const Piece& piece, const glm::mat4& world, const glm::mat3& normalMatrix, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		uint32_t base = static_cast<uint32_t>(vertices.size());
+		size_t firstIndex = indices.size();
+		for (uint32_t i = 0; i < piece.vertexCount; i++)
+		{
+			const PackedVertex& packed = piece.vertices[i];
+			Vertex vertex{};
+			glm::vec3 pos = glm::max(glm::vec3(packed.pos.x, packed.pos.y, packed.pos.z) / 32767.0f, glm::vec3(-1.0f));
+			vertex.pos = glm::vec3(world * glm::vec4(pos, 1.0f));
+			vertex.color = glm::vec3(packed.color.r, packed.color.g, packed.color.b) / 255.0f;
+			vertex.texCoord = { glm::unpackHalf1x16(packed.texCoord.u), glm::unpackHalf1x16(packed.texCoord.v) };
+			vertex.normal = normalMatrix * (glm::vec3(packed.normal.x, packed.normal.y, packed.normal.z) / 127.0f);
+			vertices.push_back(vertex);
+		}
+		const char* source = static_cast<const char*>(piece.indices);
+		for (uint32_t i = 0; i < piece.indexCount; i++)
+		{
+			uint32_t index = 0;
+			if (piece.index16)
+			{
+				uint16_t narrow;
+				memcpy(&narrow, source + i * sizeof(uint16_t), sizeof(uint16_t));
+				index = narrow;
+			}
+			else
+			{
+				memcpy(&index, source + i * sizeof(uint32_t), sizeof(uint32_t));
+			}
+			indices.push_back(base + index);
+		}
+		if (glm::determinant(world) < 0.0f)
+		{
+			for (size_t i = firstIndex; i + 2 < indices.size(); i += 3)
+			{
+				std::swap(indices[i + 1], indices[i + 2]);
+			}
+		}
+	}
+}
+
+bool StaticBatcher::canBatch(const Entity& entity)
+{
+	const std::shared_ptr<Model>& model = entity.getModel();
+	return entity.isStatic() && model->isReady() && model->getPartCount() == 1 && !model->getPath().empty();
+}
+
+std::vector<StaticBatcher::Batch> StaticBatcher::build(const std::vector<Entity*>& entities, float cellSize)
+{
+	//材质按第一次出现的顺序编号，std::map 让同一材质的格子按坐标排好，每次合批的结果都一样
+	std::vector<std::shared_ptr<Material>> materials;
+	std::map<std::tuple<size_t, int, int, int>, std::vector<Entity*>> groups;
+	for (Entity* entity : entities)
+	{
+		size_t material = std::find(materials.begin(), materials.end(), entity->getMaterial()) - materials.begin();
+		if (material == materials.size())
+		{
+			materials.push_back(entity->getMaterial());
+		}
+		glm::vec3 center;
+		float radius;
+		entity->getBoundingSphere(center, radius);
+		glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+		groups[{ material, cell.x, cell.y, cell.z }].push_back(entity);
+	}
+
+	//每个源模型只读一次，几个格子里的同一个模型共用
+	std::unordered_map<std::string, std::unique_ptr<ModelData>> sources;
+	std::vector<Batch> batches;
+	for (auto& [key, members] : groups)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		for (Entity* entity : members)
+		{
+			const std::string& path = entity->getModel()->getPath();
+			std::unique_ptr<ModelData>& source = sources[path];
+			if (!source)
+			{
+				source = Model::load(path);
+			}
+
+			glm::mat4 modelMatrix = entity->getModelMatrix();
+			glm::mat4 world = modelMatrix * source->quantization.getDequantMatrix();
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+			std::vector<Piece> pieces;
+			collectPieces(*source, entity->getSubmesh(), pieces);
+			for (const Piece& piece : pieces)
+			{
+				appendPiece(piece, world, normalMatrix, vertices, indices);
+			}
+		}
+		if (indices.empty())
+		{
+			continue;
+		}
+
+		Batch batch;
+		batch.material = materials[std::get<0>(key)];
+		batch.sourceCount = static_cast<uint32_t>(members.size());
+		batch.data = std::make_unique<ModelData>();
+		ModelData& data = *batch.data;
+		data.path = "static batch " + std::to_string(batches.size());
+		data.bounds.min = data.bounds.max = vertices[0].pos;
+		for (const Vertex& vertex : vertices)
+		{
+			data.bounds.min = glm::min(data.bounds.min, vertex.pos);
+			data.bounds.max = glm::max(data.bounds.max, vertex.pos);
+		}
+		data.quantization = VertexQuantization::fromBounds(data.bounds.min, data.bounds.max);
+		data.vertices.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			data.vertices[i] = PackedVertex::pack(vertices[i], data.quantization);
+		}
+		//格子里三角形够多时照样切成簇，格子内部还能按簇剔除；顶点就在世界空间，簇也是
+		constexpr size_t kMinMeshletTriangles = 1024;
+		if (indices.size() / 3 >= kMinMeshletTriangles)
+		{
+			data.meshlets = MeshletBuilder::build(indices.data(), indices.size(), &vertices[0].pos.x, sizeof(Vertex), vertices.size());
+		}
+		data.indices = std::move(indices);
+		data.lods.push_back({ 0, static_cast<uint32_t>(data.indices.size()), 0.0f });
+		batches.push_back(std::move(batch));
+	}
+	return batches;
+}
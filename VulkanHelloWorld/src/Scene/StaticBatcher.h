@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "../Graphics/Entity.h"
+#include "../Graphics/Model.h"
+#include <memory>
+#include <vector>
+
+// 静态合批：不会再移动的实体按（材质, 空间格子）分组，每组的顶点乘上各自的模型矩阵后合成一个模型，
+// 原来每个实体一次推送常量 + 一次 draw，合并后每组只有一次；合并出来的模型包围盒就是这一格的，视锥剔除按格子进行
+// 实体按世界空间包围球的球心落在哪个格子分组，格子越大合并得越多、剔除越粗
+// 三角形够多的格子还会切成 meshlet，格子内部仍然可以按簇剔除，但合并后没有 LOD
+// 源几何用 Model::load 按路径重新读出（有网格缓存时只是一次映射），只取第 0 级；流式导入的分块模型不参与
+// 合并后按整格的包围盒重新量化，格子大时位置精度会比原来低（16 位，格子 16 米约 0.25 毫米）
+class StaticBatcher
+{
+public:
+	struct Batch
+	{
+		std::shared_ptr<Material> material;
+		std::unique_ptr<ModelData> data; // 已经是世界空间、压缩好的顶点，实体用单位矩阵画
+		uint32_t sourceCount = 0;        // 合并了多少个实体
+	};
+
+	static bool canBatch(const Entity& entity);
+	//entities 都要满足 canBatch；返回的批次顺序是确定的（按材质出现的顺序，再按格子坐标）
+	static std::vector<Batch> build(const std::vector<Entity*>& entities, float cellSize);
+};
@@ -0,0 +1,167 @@
+﻿#include "AllocatorTests.h"
+#include "TestContext.h"
+#include "../Core/MemoryAllocator.h"
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	void testAlignmentPadding(TestContext& test)
+	{
+		BlockMetadata block(1024);
+		VkDeviceSize first = 0;
+		VkDeviceSize second = 0;
+		test.check(block.allocate(10, 1, first) && first == 0, "unaligned allocation starts at 0");
+		test.check(block.allocate(16, 256, second) && second == 256, "aligned allocation is rounded up to 256");
+		//[10, 256) 的空隙算在第二次分配里，不会留下一个小空闲区间
+		test.check(block.getUsedSize() == 10 + 246 + 16, "padding is counted as used");
+		test.check(block.getFreeRangeCount() == 1, "padding does not leave a free range behind");
+
+		block.free(second);
+		test.check(block.getUsedSize() == 10, "freeing returns the padding too");
+		test.check(block.getFreeRangeCount() == 1 && block.getLargestFreeRange() == 1014, "padding merges back into the tail");
+
+		VkDeviceSize offset = 0;
+		test.check(block.allocate(1, 64, offset) && offset % 64 == 0, "offset honours alignment 64");
+	}
+
+	void testCoalescing(TestContext& test)
+	{
+		BlockMetadata block(300);
+		VkDeviceSize a = 0, b = 0, c = 0;
+		block.allocate(100, 1, a);
+		block.allocate(100, 1, b);
+		block.allocate(100, 1, c);
+		test.check(a == 0 && b == 100 && c == 200, "sequential allocations are packed");
+		test.check(block.getFreeRangeCount() == 0, "block is full");
+
+		block.free(a);
+		block.free(c);
+		test.check(block.getFreeRangeCount() == 2, "non-adjacent frees stay separate");
+		block.free(b);
+		test.check(block.getFreeRangeCount() == 1 && block.getLargestFreeRange() == 300, "middle free merges both neighbours");
+		test.check(block.isEmpty() && block.getUsedSize() == 0, "block is empty again");
+	}
+
+	void testBestFit(TestContext& test)
+	{
+		BlockMetadata block(1000);
+		VkDeviceSize a = 0, b = 0, c = 0, d = 0;
+		block.allocate(100, 1, a); // [0, 100)
+		block.allocate(50, 1, b);  // [100, 150)
+		block.allocate(200, 1, c); // [150, 350)
+		block.allocate(30, 1, d);  // [350, 380)，隔开 c 和末尾的空闲区间
+		block.free(a);
+		block.free(c);
+
+		//空闲：100@0、200@150、620@380
+		VkDeviceSize offset = 0;
+		test.check(block.allocate(150, 1, offset) && offset == 150, "150 goes into the 200 hole, not the tail");
+		test.check(block.allocate(80, 1, offset) && offset == 0, "80 goes into the 100 hole");
+		//剩下 20@80、50@300、620@380：对齐到 64 后只有末尾放得下
+		test.check(block.allocate(40, 64, offset) && offset == 384, "alignment skips holes that are too small after padding");
+		test.check(block.allocate(20, 1, offset) && offset == 80, "exact fit is preferred");
+	}
+
+	void testFailureAndGrow(TestContext& test)
+	{
+		BlockMetadata block(256);
+		VkDeviceSize offset = 0;
+		test.check(!block.allocate(0, 1, offset), "zero-sized allocation fails");
+		test.check(!block.allocate(257, 1, offset), "oversized allocation fails");
+		test.check(block.allocate(200, 1, offset) && offset == 0, "allocation fits");
+		test.check(!block.allocate(100, 1, offset), "allocation larger than the remaining space fails");
+
+		bool threw = false;
+		try
+		{
+			block.free(12345);
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		test.check(threw, "freeing an unknown offset throws");
+
+		block.grow(512);
+		test.check(block.getSize() == 512 && block.getFreeRangeCount() == 1 && block.getLargestFreeRange() == 312, "grow merges with the free tail");
+		test.check(block.allocate(300, 1, offset) && offset == 200, "grown space is usable");
+	}
+
+	//固定种子，每次运行的操作序列一样
+	void testRandomized(TestContext& test)
+	{
+		constexpr VkDeviceSize kBlockSize = 1024 * 1024;
+		BlockMetadata block(kBlockSize);
+		std::mt19937 random(12345);
+		std::map<VkDeviceSize, VkDeviceSize> live; // 对齐后的偏移 -> 请求的大小
+		bool overlapFound = false;
+		bool alignmentWrong = false;
+		bool spuriousFailure = false;
+		bool totalsWrong = false;
+
+		for (int step = 0; step < 20000; step++)
+		{
+			bool doFree = !live.empty() && (random() % 100 < 45);
+			if (doFree)
+			{
+				auto it = live.begin();
+				std::advance(it, random() % live.size());
+				block.free(it->first);
+				live.erase(it);
+			}
+			else
+			{
+				VkDeviceSize size = 1 + random() % 8192;
+				VkDeviceSize alignment = VkDeviceSize(1) << (random() % 9);
+				VkDeviceSize offset = 0;
+				if (block.allocate(size, alignment, offset))
+				{
+					alignmentWrong = alignmentWrong || offset % alignment != 0;
+					//只要和前后两个已有分配不重叠，就和所有分配都不重叠
+					auto next = live.lower_bound(offset);
+					if (next != live.end() && offset + size > next->first)
+					{
+						overlapFound = true;
+					}
+					if (next != live.begin() && std::prev(next)->first + std::prev(next)->second > offset)
+					{
+						overlapFound = true;
+					}
+					overlapFound = overlapFound || offset + size > kBlockSize;
+					live[offset] = size;
+				}
+				else
+				{
+					//有空闲区间能放下 size + alignment - 1 时，不管起点在哪对齐后都放得下，不该失败
+					spuriousFailure = spuriousFailure || block.getLargestFreeRange() >= size + alignment - 1;
+				}
+			}
+			totalsWrong = totalsWrong || block.getUsedSize() + block.getFreeSize() != kBlockSize || block.getAllocationCount() != live.size();
+		}
+		test.check(!overlapFound, "randomized: live allocations never overlap");
+		test.check(!alignmentWrong, "randomized: offsets are aligned");
+		test.check(!spuriousFailure, "randomized: allocation only fails when no free range can hold it");
+		test.check(!totalsWrong, "randomized: used + free equals block size");
+
+		for (const auto& [offset, size] : live)
+		{
+			block.free(offset);
+		}
+		test.check(block.isEmpty() && block.getUsedSize() == 0, "randomized: everything freed");
+		test.check(block.getFreeRangeCount() == 1 && block.getLargestFreeRange() == kBlockSize, "randomized: free ranges coalesce back into one");
+	}
+}
+
+int AllocatorTests::run()
+{
+	TestContext test("allocator");
+	testAlignmentPadding(test);
+	testCoalescing(test);
+	testBestFit(test);
+	testFailureAndGrow(test);
+	testRandomized(test);
+	return test.finish();
+}
@@ -0,0 +1,9 @@
+﻿#pragma once
+
+// BlockMetadata 的单元测试，纯 CPU，不创建 Vulkan 设备：
+// 对齐产生的前置空隙、相邻空闲区间合并、best-fit 选区间、grow，以及固定种子的随机分配/释放（不重叠、空闲总量对得上）
+// 运行方式：VulkanHelloWorld.exe --test-allocator，全部通过时返回 0
+namespace AllocatorTests
+{
+	int run();
+}
@@ -0,0 +1,143 @@
+﻿#include "DirtyRangeTests.h"
+#include "TestContext.h"
+#include "../Core/DirtyRanges.h"
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr VkDeviceSize kGap = DirtyRanges::kDefaultMergeGap;
+
+	std::vector<VkBufferCopy> coalesce(DirtyRanges& ranges, VkDeviceSize srcBase = 0)
+	{
+		std::vector<VkBufferCopy> regions(ranges.size());
+		regions.resize(ranges.coalesce(srcBase, regions.data()));
+		return regions;
+	}
+
+	bool isRegion(const VkBufferCopy& region, VkDeviceSize begin, VkDeviceSize end)
+	{
+		return region.dstOffset == begin && region.size == end - begin;
+	}
+
+	void testExtendLast(TestContext& test)
+	{
+		DirtyRanges ranges;
+		ranges.add(0, 64);
+		ranges.add(64, 64);
+		ranges.add(32, 200);
+		test.check(ranges.size() == 1, "writes starting inside or at the end of the last range extend it");
+		ranges.add(0, 0);
+		test.check(ranges.size() == 1, "zero-sized writes are ignored");
+
+		std::vector<VkBufferCopy> regions = coalesce(ranges);
+		test.check(regions.size() == 1 && isRegion(regions[0], 0, 232), "extended range becomes one region");
+		test.check(ranges.empty(), "coalesce clears the recorded ranges");
+		test.check(coalesce(ranges).empty(), "nothing dirty gives no regions");
+	}
+
+	void testMerging(TestContext& test)
+	{
+		DirtyRanges ranges;
+		ranges.add(1000, 100);  // [1000, 1100)
+		ranges.add(0, 16);      // [0, 16)，在前面，需要排序
+		ranges.add(1050, 100);  // [1050, 1150)，和第一段重叠
+		ranges.add(1150 + kGap, 8); // 空隙正好等于阈值，合并
+		ranges.add(5000, 4);
+		ranges.add(5004 + kGap + 1, 4); // 空隙比阈值大 1，分开
+		test.check(ranges.size() == 6, "non-adjacent out-of-order writes are recorded separately");
+
+		std::vector<VkBufferCopy> regions = coalesce(ranges);
+		test.check(regions.size() == 4, "overlapping and close ranges merge");
+		test.check(regions.size() == 4 && isRegion(regions[0], 0, 16), "ranges are sorted by offset");
+		test.check(regions.size() == 4 && isRegion(regions[1], 1000, 1158 + kGap), "overlap and a gap equal to the threshold merge");
+		test.check(regions.size() == 4 && isRegion(regions[2], 5000, 5004), "gap above the threshold stays separate");
+		test.check(regions.size() == 4 && isRegion(regions[3], 5005 + kGap, 5009 + kGap), "last range is emitted");
+	}
+
+	void testContainedAndSourceBase(TestContext& test)
+	{
+		DirtyRanges ranges;
+		ranges.add(0, 1024);
+		ranges.add(2048, 16);
+		ranges.add(100, 10); // 落在第一段里面
+		std::vector<VkBufferCopy> regions = coalesce(ranges, 4096);
+		test.check(regions.size() == 2 && isRegion(regions[0], 0, 1024), "a contained range does not grow its container");
+		test.check(regions.size() == 2 && regions[0].srcOffset == 4096 && regions[1].srcOffset == 4096 + 2048, "source offset adds the frame base");
+	}
+
+	void testMergeGapZero(TestContext& test)
+	{
+		DirtyRanges ranges(0);
+		ranges.add(0, 10);
+		ranges.add(20, 10);
+		ranges.add(10, 10); // 正好填上空隙，和两边都相邻
+		ranges.add(31, 1);
+		std::vector<VkBufferCopy> regions = coalesce(ranges);
+		test.check(regions.size() == 2 && isRegion(regions[0], 0, 30) && isRegion(regions[1], 31, 32), "with gap 0 only touching ranges merge");
+	}
+
+	//固定种子，每次运行的写入序列一样
+	void testRandomized(TestContext& test)
+	{
+		constexpr VkDeviceSize kBufferSize = 64 * 1024;
+		std::mt19937 random(4242);
+		bool sorted = true;
+		bool covered = true;
+		bool tooClose = false;
+		bool countWrong = false;
+		bool outOfBounds = false;
+
+		for (int round = 0; round < 200; round++)
+		{
+			DirtyRanges ranges;
+			std::vector<bool> written(kBufferSize, false);
+			int writes = 1 + random() % 64;
+			for (int w = 0; w < writes; w++)
+			{
+				VkDeviceSize size = 1 + random() % 512;
+				VkDeviceSize offset = random() % (kBufferSize - size + 1);
+				ranges.add(offset, size);
+				std::fill(written.begin() + offset, written.begin() + offset + size, true);
+			}
+
+			size_t recorded = ranges.size();
+			std::vector<VkBufferCopy> regions = coalesce(ranges, kBufferSize * 2);
+			countWrong = countWrong || regions.empty() || regions.size() > recorded;
+			std::vector<bool> copied(kBufferSize, false);
+			for (size_t i = 0; i < regions.size(); i++)
+			{
+				const VkBufferCopy& region = regions[i];
+				outOfBounds = outOfBounds || region.dstOffset + region.size > kBufferSize || region.srcOffset != region.dstOffset + kBufferSize * 2;
+				if (i > 0)
+				{
+					VkDeviceSize previousEnd = regions[i - 1].dstOffset + regions[i - 1].size;
+					sorted = sorted && previousEnd <= region.dstOffset;
+					//空隙不超过阈值的话本该并在一起
+					tooClose = tooClose || region.dstOffset - previousEnd <= kGap;
+				}
+				std::fill(copied.begin() + region.dstOffset, copied.begin() + region.dstOffset + region.size, true);
+			}
+			for (VkDeviceSize i = 0; i < kBufferSize; i++)
+			{
+				covered = covered && (!written[i] || copied[i]);
+			}
+		}
+		test.check(sorted, "randomized: regions are sorted and do not overlap");
+		test.check(covered, "randomized: every written byte is copied");
+		test.check(!tooClose, "randomized: regions closer than the merge gap are merged");
+		test.check(!countWrong, "randomized: region count is between 1 and the recorded range count");
+		test.check(!outOfBounds, "randomized: regions stay inside the written extent and offset by the frame base");
+	}
+}
+
+int DirtyRangeTests::run()
+{
+	TestContext test("dirty ranges");
+	testExtendLast(test);
+	testMerging(test);
+	testContainedAndSourceBase(test);
+	testMergeGapZero(test);
+	testRandomized(test);
+	return test.finish();
+}
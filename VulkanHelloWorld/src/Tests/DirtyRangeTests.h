@@ -0,0 +1,10 @@
+﻿#pragma once
+
+// DirtyRanges（TrackedBuffer 的脏区间合并）的单元测试，纯 CPU：
+// 延长上一段、重叠/相邻/小空隙合并、大空隙分开、乱序写入排序、偏移换算，
+// 以及固定种子的随机写入（合并后的区域有序不重叠、覆盖所有写过的字节、相邻区域的空隙大于合并阈值）
+// 运行方式：VulkanHelloWorld.exe --test-dirty-ranges，全部通过时返回 0
+namespace DirtyRangeTests
+{
+	int run();
+}
@@ -0,0 +1,254 @@
+﻿#include "MeshletTests.h"
+#include "TestContext.h"
+#include "../Graphics/Meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_set>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	struct TestMesh
+	{
+		const char* name;
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	//单位球，三角形逆时针朝外；inward 时朝里，每个簇都是凹的，簇中心在三角形平面前面，锥顶必须往后退才保守
+	TestMesh makeSphere(uint32_t rings, uint32_t segments, bool inward)
+	{
+		TestMesh mesh{ inward ? "inner sphere" : "sphere", {}, {} };
+		for (uint32_t r = 0; r <= rings; r++)
+		{
+			float theta = glm::pi<float>() * r / rings;
+			for (uint32_t s = 0; s <= segments; s++)
+			{
+				float phi = glm::two_pi<float>() * s / segments;
+				mesh.positions.push_back({ std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) });
+			}
+		}
+		for (uint32_t r = 0; r < rings; r++)
+		{
+			for (uint32_t s = 0; s < segments; s++)
+			{
+				uint32_t a = r * (segments + 1) + s;
+				uint32_t b = a + segments + 1;
+				if (inward)
+				{
+					mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+				}
+				else
+				{
+					mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+				}
+			}
+		}
+		return mesh;
+	}
+
+	//z = 0 平面上的网格，法线朝 +z，法线锥最窄，背面剔除最激进
+	TestMesh makeGrid(uint32_t size)
+	{
+		TestMesh mesh{ "grid", {}, {} };
+		for (uint32_t y = 0; y <= size; y++)
+		{
+			for (uint32_t x = 0; x <= size; x++)
+			{
+				mesh.positions.push_back({ float(x) / size * 4.0f - 2.0f, float(y) / size * 4.0f - 2.0f, 0.0f });
+			}
+		}
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				uint32_t a = y * (size + 1) + x;
+				uint32_t b = a + size + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+			}
+		}
+		return mesh;
+	}
+
+	//互不共享顶点、朝向随机的小三角形，夹杂退化三角形：顶点上限先于三角形上限触发
+	//三角形沿 x 轴排开，相邻的三角形在空间上也相邻，簇才有机会被视锥剔除
+	TestMesh makeSoup(uint32_t triangleCount, std::mt19937& random)
+	{
+		TestMesh mesh{ "soup", {}, {} };
+		std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+			glm::vec3 center(float(t) / triangleCount * 20.0f - 10.0f, 0.0f, 0.0f);
+			for (int k = 0; k < 3; k++)
+			{
+				mesh.positions.push_back(center + glm::vec3(offset(random), offset(random), offset(random)));
+			}
+			if (t % 7 == 0)
+			{
+				mesh.indices.insert(mesh.indices.end(), { base, base, base + 1 });
+			}
+			else
+			{
+				mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2 });
+			}
+		}
+		return mesh;
+	}
+
+	std::vector<Meshlet> build(const TestMesh& mesh)
+	{
+		return MeshletBuilder::build(mesh.indices.data(), mesh.indices.size(), &mesh.positions[0].x, sizeof(glm::vec3), mesh.positions.size());
+	}
+
+	void testLimitsAndCoverage(TestContext& test, const TestMesh& mesh, const std::vector<Meshlet>& meshlets)
+	{
+		bool withinLimits = true;
+		bool contiguous = true;
+		uint32_t expectedOffset = 0;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			std::unordered_set<uint32_t> vertices(mesh.indices.begin() + meshlet.indexOffset, mesh.indices.begin() + meshlet.indexOffset + meshlet.indexCount);
+			withinLimits = withinLimits && vertices.size() <= MeshletBuilder::kMaxVertices && meshlet.indexCount / 3 <= MeshletBuilder::kMaxTriangles;
+			contiguous = contiguous && meshlet.indexOffset == expectedOffset && meshlet.indexCount > 0 && meshlet.indexCount % 3 == 0;
+			expectedOffset += meshlet.indexCount;
+		}
+		std::printf("  %s: %zu triangles -> %zu meshlets\n", mesh.name, mesh.indices.size() / 3, meshlets.size());
+		test.check(withinLimits, "meshlets respect the vertex and triangle limits");
+		test.check(contiguous && expectedOffset == mesh.indices.size(), "meshlets cover the index buffer in order without gaps");
+
+		std::vector<Meshlet> again = build(mesh);
+		bool same = again.size() == meshlets.size();
+		for (size_t i = 0; same && i < again.size(); i++)
+		{
+			same = again[i].indexOffset == meshlets[i].indexOffset && again[i].indexCount == meshlets[i].indexCount
+				&& again[i].center == meshlets[i].center && again[i].radius == meshlets[i].radius
+				&& again[i].coneAxis == meshlets[i].coneAxis && again[i].coneCutoff == meshlets[i].coneCutoff;
+		}
+		test.check(same, "build is deterministic");
+	}
+
+	void testBoundingSpheres(TestContext& test, const TestMesh& mesh, const std::vector<Meshlet>& meshlets)
+	{
+		bool contained = true;
+		for (const Meshlet& meshlet : meshlets)
+		{
+			for (uint32_t i = 0; i < meshlet.indexCount; i++)
+			{
+				const glm::vec3& position = mesh.positions[mesh.indices[meshlet.indexOffset + i]];
+				contained = contained && glm::length(position - meshlet.center) <= meshlet.radius * (1.0f + 1e-5f) + 1e-6f;
+			}
+		}
+		test.check(contained, "bounding spheres contain every vertex of their meshlet");
+	}
+
+	//三角形在视锥内：没有哪个平面把三个顶点都挡在外面（和球的测试一样是保守的判断）
+	bool triangleInFrustum(const Frustum& frustum, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+	{
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			auto outside = [&](const glm::vec3& p) { return glm::dot(glm::vec3(plane), p) + plane.w < 0.0f; };
+			if (outside(p0) && outside(p1) && outside(p2))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool triangleFrontFacing(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& camera)
+	{
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		//退化三角形光栅化不出像素；贴着平面看的三角形留一点余量，避免浮点误差算成正面
+		return length > 0.0f && glm::dot(normal / length, camera - p0) > 1e-4f;
+	}
+
+	void testConservativeCulling(TestContext& test, const TestMesh& mesh, const std::vector<Meshlet>& meshlets, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		bool conservative = true;
+		uint32_t culled = 0;
+		uint32_t tested = 0;
+		std::vector<uint32_t> visible;
+		for (int view = 0; view < 200; view++)
+		{
+			//一半的视角从远处看，一半贴着网格表面，近处看时锥顶的位置才要紧
+			glm::vec3 camera = glm::vec3(unit(random), unit(random), unit(random)) * 5.0f;
+			glm::vec3 target = glm::vec3(unit(random), unit(random), unit(random)) * 1.5f;
+			if (view % 2 == 1)
+			{
+				glm::vec3 surface = mesh.positions[random() % mesh.positions.size()];
+				camera = surface + glm::vec3(unit(random), unit(random), unit(random)) * 0.1f;
+				target = surface + glm::vec3(unit(random), unit(random), unit(random));
+			}
+			if (glm::length(target - camera) < 1e-3f)
+			{
+				continue;
+			}
+			glm::vec3 up = std::abs(glm::normalize(target - camera).y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			glm::mat4 viewProj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) * glm::lookAt(camera, target, up);
+			Frustum frustum = Frustum::fromMatrix(viewProj);
+
+			for (bool cullBackfaces : { false, true })
+			{
+				MeshletBuilder::cull(meshlets, frustum, camera, cullBackfaces, visible);
+				std::vector<bool> isVisible(meshlets.size(), false);
+				for (uint32_t index : visible)
+				{
+					isVisible[index] = true;
+				}
+				for (size_t m = 0; m < meshlets.size(); m++)
+				{
+					tested++;
+					if (isVisible[m])
+					{
+						continue;
+					}
+					culled++;
+					const Meshlet& meshlet = meshlets[m];
+					for (uint32_t i = 0; i < meshlet.indexCount; i += 3)
+					{
+						const uint32_t* triangle = &mesh.indices[meshlet.indexOffset + i];
+						const glm::vec3& p0 = mesh.positions[triangle[0]];
+						const glm::vec3& p1 = mesh.positions[triangle[1]];
+						const glm::vec3& p2 = mesh.positions[triangle[2]];
+						bool facing = !cullBackfaces || triangleFrontFacing(p0, p1, p2, camera);
+						if (facing && triangleInFrustum(frustum, p0, p1, p2))
+						{
+							conservative = false;
+						}
+					}
+				}
+			}
+		}
+		std::printf("  %s: culled %u of %u meshlet tests\n", mesh.name, culled, tested);
+		test.check(conservative, "culling never rejects a meshlet with a visible front-facing triangle");
+		test.check(culled > 0, "culling rejects something, so the check above is not vacuous");
+	}
+}
+
+int MeshletTests::run()
+{
+	TestContext test("meshlet");
+	std::mt19937 random(2024);
+	std::vector<TestMesh> meshes;
+	meshes.push_back(makeSphere(48, 96, false));
+	meshes.push_back(makeSphere(48, 96, true));
+	meshes.push_back(makeGrid(40));
+	meshes.push_back(makeSoup(2000, random));
+	for (const TestMesh& mesh : meshes)
+	{
+		std::vector<Meshlet> meshlets = build(mesh);
+		testLimitsAndCoverage(test, mesh, meshlets);
+		testBoundingSpheres(test, mesh, meshlets);
+		testConservativeCulling(test, mesh, meshlets, random);
+	}
+
+	std::vector<uint32_t> noIndices;
+	std::vector<glm::vec3> noPositions(1);
+	test.check(MeshletBuilder::build(noIndices.data(), 0, &noPositions[0].x, sizeof(glm::vec3), 1).empty(), "empty index buffer gives no meshlets");
+	return test.finish();
+}
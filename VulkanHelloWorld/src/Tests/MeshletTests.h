@@ -0,0 +1,10 @@
+﻿#pragma once
+
+// MeshletBuilder 的单元测试，纯 CPU：
+// 每个簇的顶点数和三角形数不超过上限、簇按顺序不重叠地覆盖全部索引、构建结果确定，
+// 包围球包住簇里所有顶点，以及随机相机下的视锥 + 法线锥剔除是保守的（被剔除的簇里没有在视锥内的正面三角形）
+// 运行方式：VulkanHelloWorld.exe --test-meshlet，全部通过时返回 0
+namespace MeshletTests
+{
+	int run();
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <cstdio>
+#include <source_location>
+
+// 单元测试用的断言：失败时打印位置和描述，不中断，跑完后按失败个数决定进程返回值
+class TestContext
+{
+public:
+	explicit TestContext(const char* suite) : m_suite(suite) {}
+
+	bool check(bool condition, const char* what, std::source_location where = std::source_location::current())
+	{
+		m_checks++;
+		if (!condition)
+		{
+			m_failures++;
+			std::printf("FAILED %s:%u: %s\n", where.file_name(), static_cast<unsigned>(where.line()), what);
+		}
+		return condition;
+	}
+
+	int finish() const
+	{
+		std::printf("%s: %u checks, %u failed\n", m_suite, m_checks, m_failures);
+		return m_failures == 0 ? 0 : 1;
+	}
+
+private:
+	const char* m_suite;
+	unsigned m_checks = 0;
+	unsigned m_failures = 0;
+};
@@ -1,23 +1,111 @@
 #include "Vertex.h"
 #include "Buffer.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 
 
-VkVertexInputBindingDescription VertexLayout::getBindingDescription()
+std::vector<VkVertexInputBindingDescription> VertexLayout::getBindingDescriptions() const
 {
-	VkVertexInputBindingDescription bindingDescription{};
-	//󶨼ŵĶ㻺壿
-	bindingDescription.binding = 0;
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	for (uint32_t binding = 0; binding < m_strides.size(); binding++)
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		//绑定几号的顶点缓冲？
+		bindingDescription.binding = binding;
 
-	//һж
-	bindingDescription.stride = m_stride;
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-	return bindingDescription;
+		//这条流里一个顶点有多大？
+		bindingDescription.stride = m_strides[binding];
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescriptions.push_back(bindingDescription);
+	}
+	return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions()
+std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions() const
 {
 	return m_AttributeDescriptions;
 }
 
+namespace
+{
+	//四舍五入到 [-limit, limit]，超出的夹住
+	template<typename T>
+	T quantizeSigned(float value, float limit)
+	{
+		return static_cast<T>(std::clamp(std::round(value * limit), -limit, limit));
+	}
+
+	uint8_t quantizeUnsigned8(float value)
+	{
+		return static_cast<uint8_t>(std::clamp(std::round(value * 255.0f), 0.0f, 255.0f));
+	}
+}
+
+VertexQuantization VertexQuantization::fromBounds(const glm::vec3& min, const glm::vec3& max)
+{
+	VertexQuantization quantization;
+	quantization.center = (min + max) * 0.5f;
+	glm::vec3 half = (max - min) * 0.5f;
+	quantization.extent = std::max(std::max(half.x, half.y), half.z);
+	//退化成一个点的网格（或者空网格）也要能还原
+	if (quantization.extent <= 0.0f)
+	{
+		quantization.extent = 1.0f;
+	}
+	return quantization;
+}
+
+glm::mat4 VertexQuantization::getDequantMatrix() const
+{
+	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), center);
+	return glm::scale(matrix, glm::vec3(extent));
+}
+
+PackedVertex PackedVertex::pack(const Vertex& vertex, const VertexQuantization& quantization)
+{
+	PackedVertex packed{};
+
+	glm::vec3 pos = (vertex.pos - quantization.center) / quantization.extent;
+	packed.pos.x = quantizeSigned<int16_t>(pos.x, 32767.0f);
+	packed.pos.y = quantizeSigned<int16_t>(pos.y, 32767.0f);
+	packed.pos.z = quantizeSigned<int16_t>(pos.z, 32767.0f);
+	packed.pos.w = 32767;
+
+	packed.color.r = quantizeUnsigned8(vertex.color.r);
+	packed.color.g = quantizeUnsigned8(vertex.color.g);
+	packed.color.b = quantizeUnsigned8(vertex.color.b);
+	packed.color.a = 255;
+
+	packed.texCoord.u = static_cast<uint16_t>(glm::packHalf1x16(vertex.texCoord.x));
+	packed.texCoord.v = static_cast<uint16_t>(glm::packHalf1x16(vertex.texCoord.y));
+
+	//没有法线的 OBJ 法线是 0，保持 0
+	float length = glm::length(vertex.normal);
+	glm::vec3 normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f);
+	packed.normal.x = quantizeSigned<int8_t>(normal.x, 127.0f);
+	packed.normal.y = quantizeSigned<int8_t>(normal.y, 127.0f);
+	packed.normal.z = quantizeSigned<int8_t>(normal.z, 127.0f);
+	packed.normal.w = 0;
+	return packed;
+}
+
+VertexLayout PackedVertex::getLayout()
+{
+	VertexLayout layout;
+	layout.push<PackedPosition>(0);//位置
+	layout.push<PackedColor>(1);//颜色
+	layout.push<HalfTexCoord>(1);//UV
+	layout.push<PackedNormal>(1);//法线
+	return layout;
+}
+
+VertexLayout PackedVertex::getPositionLayout()
+{
+	VertexLayout layout;
+	layout.push<PackedPosition>(0);//位置
+	return layout;
+}
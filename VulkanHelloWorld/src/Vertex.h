@@ -1,9 +1,10 @@
 #pragma once
 #include<glm/glm.hpp>
 #include<vector>
+#include<cstddef>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define GLM_ENABLE_EXPERIMENTAL //  glm  hash 
+#define GLM_ENABLE_EXPERIMENTAL // 必须加这个宏才能用 glm 的 hash 功能
 #include <glm/gtx/hash.hpp>
 
 
@@ -12,74 +13,123 @@ struct VertexAttributeTraits {
 	static const bool is_valid = false;
 };
 
-// 2. ػ߱ float Ӧʲô
+// 2. 特化：告诉编译器 float 对应什么
 template<> struct VertexAttributeTraits<float> {
 	static const bool is_valid = true;
 	static const VkFormat format = VK_FORMAT_R32_SFLOAT;
 	static const uint32_t size = sizeof(float);
 };
 
-// 3. ػglm::vec2
+// 3. 特化：glm::vec2
 template<> struct VertexAttributeTraits<glm::vec2> {
 	static const bool is_valid = true;
 	static const VkFormat format = VK_FORMAT_R32G32_SFLOAT;
 	static const uint32_t size = sizeof(glm::vec2);
 };
 
-// 4. ػglm::vec3
+// 4. 特化：glm::vec3
 template<> struct VertexAttributeTraits<glm::vec3> {
 	static const bool is_valid = true;
 	static const VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
 	static const uint32_t size = sizeof(glm::vec3);
 };
 
-// 5. ػglm::vec4
+// 5. 特化：glm::vec4
 template<> struct VertexAttributeTraits<glm::vec4> {
 	static const bool is_valid = true;
 	static const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
 	static const uint32_t size = sizeof(glm::vec4);
 };
 
+// 压缩后的顶点属性：都是归一化或半精度格式，着色器里读到的仍然是 float，现有的 vert.vert 不用改
+struct PackedPosition { int16_t x, y, z, w; };   // snorm16，配合每个网格的反量化矩阵还原（w 不用）
+struct PackedNormal { int8_t x, y, z, w; };      // snorm8，片元着色器里会重新 normalize
+struct PackedTexCoord { uint16_t u, v; };        // unorm16，只能表示 [0,1]
+struct HalfTexCoord { uint16_t u, v; };          // 半精度浮点，平铺的 UV（比如地面的 0~10）也能放下
+struct PackedColor { uint8_t r, g, b, a; };      // unorm8
+
+template<> struct VertexAttributeTraits<PackedPosition> {
+	static const bool is_valid = true;
+	static const VkFormat format = VK_FORMAT_R16G16B16A16_SNORM;
+	static const uint32_t size = sizeof(PackedPosition);
+};
+
+template<> struct VertexAttributeTraits<PackedNormal> {
+	static const bool is_valid = true;
+	static const VkFormat format = VK_FORMAT_R8G8B8A8_SNORM;
+	static const uint32_t size = sizeof(PackedNormal);
+};
+
+template<> struct VertexAttributeTraits<PackedTexCoord> {
+	static const bool is_valid = true;
+	static const VkFormat format = VK_FORMAT_R16G16_UNORM;
+	static const uint32_t size = sizeof(PackedTexCoord);
+};
+
+template<> struct VertexAttributeTraits<HalfTexCoord> {
+	static const bool is_valid = true;
+	static const VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+	static const uint32_t size = sizeof(HalfTexCoord);
+};
+
+template<> struct VertexAttributeTraits<PackedColor> {
+	static const bool is_valid = true;
+	static const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	static const uint32_t size = sizeof(PackedColor);
+};
+
+// 顶点布局可以有多个 binding，每个 binding 是一条单独的（非交错的）顶点流；location 按 push 的顺序递增，和 binding 无关
 class VertexLayout
 {
 public:
-	VkVertexInputBindingDescription getBindingDescription();
-	std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+	std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+	uint32_t getBindingCount() const { return static_cast<uint32_t>(m_strides.size()); }
+	uint32_t getStride(uint32_t binding) const { return m_strides[binding]; }
+
 	template<typename T>
-	void push()
+	void push(uint32_t binding = 0)
 	{
 		static_assert(VertexAttributeTraits<T>::is_valid, "Unsupported vertex attribute type");
-		VkVertexInputAttributeDescription attributeDescription{};
-		//󶨵Ŷ㻺
-		attributeDescription.binding = 0;
-
-		//һеĵڼԣ
-		attributeDescription.location = m_Locationindex++;
-		attributeDescription.format = VertexAttributeTraits<T>::format;
-
-		//һеƫ
-		attributeDescription.offset = m_stride;
-		m_stride += VertexAttributeTraits<T>::size;
-		m_AttributeDescriptions.push_back(attributeDescription);
+		if (binding >= m_strides.size())
+		{
+			m_strides.resize(binding + 1, 0);
+		}
+		//它在这条流的一个顶点里的偏移量
+		pushAttribute(binding, VertexAttributeTraits<T>::format, m_strides[binding]);
+		m_strides[binding] += VertexAttributeTraits<T>::size;
 	}
 
 private:
-	uint32_t m_stride = 0;
+	std::vector<uint32_t> m_strides; // 每个 binding 的步长
 	uint32_t m_Locationindex = 0;
 	std::vector<VkVertexInputAttributeDescription> m_AttributeDescriptions;
+
+	void pushAttribute(uint32_t binding, VkFormat format, uint32_t offset)
+	{
+		VkVertexInputAttributeDescription attributeDescription{};
+		//绑定到几号顶点缓冲区
+		attributeDescription.binding = binding;
+
+		//它是一个顶点中的第几个属性？
+		attributeDescription.location = m_Locationindex++;
+		attributeDescription.format = format;
+		attributeDescription.offset = offset;
+		m_AttributeDescriptions.push_back(attributeDescription);
+	}
 };
 
 
 
 
-//  3D ṹ
+// 真正的 3D 顶点结构体
 struct Vertex {
-	glm::vec3 pos;      // λ (X, Y, Z)
-	glm::vec3 color;    // ɫ (R, G, B)
-	glm::vec2 texCoord; // UV ͼ (U, V)
-	glm::vec3 normal;   //  (X, Y, Z) - ȫ
+	glm::vec3 pos;      // 位置 (X, Y, Z)
+	glm::vec3 color;    // 颜色 (R, G, B)
+	glm::vec2 texCoord; // UV 贴图坐标 (U, V)
+	glm::vec3 normal;   // 法线 (X, Y, Z) - 光照全靠它！
 
-	//  ==  C++ ʲôͬһ
+	// 重载 == 运算符：告诉 C++ 什么样的两个顶点算作“同一个”
 	bool operator==(const Vertex& other) const {
 		return pos == other.pos &&
 			color == other.color &&
@@ -88,9 +138,38 @@ struct Vertex {
 	}
 };
 
-// ע std::hash߹ϣΪ Vertex Ψһ ID (ڼȥ)
-//׼hashûԶVertexģػķαһVertex
-//Щλ㲻ùܣþ
+// 每个网格自己的位置量化参数：以包围盒中心为原点、最长的半边长为 1
+// 用统一缩放，模型矩阵乘上它之后法线矩阵只差一个系数，片元着色器 normalize 后没有影响
+struct VertexQuantization {
+	glm::vec3 center = glm::vec3(0.0f);
+	float extent = 1.0f;
+
+	static VertexQuantization fromBounds(const glm::vec3& min, const glm::vec3& max);
+	//把 [-1,1] 的量化坐标还原回模型空间，乘在模型矩阵右边
+	glm::mat4 getDequantMatrix() const;
+};
+
+// 实际上传到 GPU 的顶点，20 字节（Vertex 是 44 字节），属性顺序和 Vertex 一致，location 不变
+// CPU 端（网格缓存、GLB、ModelData）是交错存的；几何池按 getLayout 的两个 binding 拆成两条流：
+// binding 0 只有位置（8 字节），binding 1 是颜色、UV、法线（12 字节），位置必须是第一个成员
+struct PackedVertex {
+	PackedPosition pos;
+	PackedColor color;
+	HalfTexCoord texCoord;
+	PackedNormal normal;
+
+	static PackedVertex pack(const Vertex& vertex, const VertexQuantization& quantization);
+	//标准管线的顶点布局，也决定几何池怎么拆流
+	static VertexLayout getLayout();
+	//阴影/深度管线只绑位置流：只有 location 0 一个属性，不会去读 binding 1
+	static VertexLayout getPositionLayout();
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay tightly packed");
+static_assert(offsetof(PackedVertex, pos) == 0 && sizeof(PackedPosition) == 8, "the position stream is the first 8 bytes of PackedVertex");
+
+// 注入 std::hash：告诉哈希表如何为这个 Vertex 生成唯一的 ID (用于极速去重)
+//标准库的hash没见过自定义的Vertex，所以用模板特化的方法告诉它如何辨别两个不一样的Vertex
+//下面那些位运算不用管，会用就行
 namespace std {
 	template<> struct hash<Vertex> {
 		size_t operator()(Vertex const& vertex) const {
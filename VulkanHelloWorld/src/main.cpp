@@ -10,9 +10,11 @@
 #include <vector>
 #include <array>
 #include <set>
+#include <fstream>
 #include <stb_image.h>
 #include "Core/ValidationLayerAssist.h"
 #include <chrono>
+#include <cmath>
 #include "Buffer.h"
 #include "Vertex.h"
 #include "Description.h"
@@ -27,6 +29,13 @@
 #include "Graphics/Texture.h"
 #include "Graphics/Camera.h"
 #include "Graphics/Model.h"
+#include "Benchmark/ObjBenchmark.h"
+#include "Benchmark/WeldBenchmark.h"
+#include "Benchmark/GlbBenchmark.h"
+#include "Benchmark/ShadowBenchmark.h"
+#include "Tests/AllocatorTests.h"
+#include "Tests/DirtyRangeTests.h"
+#include "Tests/MeshletTests.h"
 #include "Graphics/Material.h"
 #include "Graphics/Entity.h"
 #include "Graphics/PipelineFactory.h"
@@ -82,6 +91,13 @@ private:
 
 	bool qKeyPressedLastFrame = false;
 
+	std::vector<HeapStats> m_heapStats; // 显存面板每帧复用
+
+	//LOD：允许的屏幕空间误差（像素），阴影 pass 的误差再乘上偏置，选更粗的 LOD
+	float m_lodPixelError = 1.0f;
+	float m_shadowLodBias = 2.0f;
+	bool m_cullMeshlets = true;
+
 	void initWindow() {
 		glfwInit();
 
@@ -101,8 +117,9 @@ private:
 		m_scene = std::make_unique<Scene>(*m_device);
 		m_scene->loadTexture("images/viking_room.png");//0号贴图
 		m_scene->loadTexture(0xFFFFFFFF);//1号贴图
-		m_scene->loadModel("models/VikingRoom/viking_room.obj");//0号模型
-		m_scene->loadModel("models/plane/plane.obj");//1号模型
+		//模型在后台线程加载，窗口先出来，加载完的模型在之后某一帧出现
+		m_scene->loadModelAsync("models/VikingRoom/viking_room.obj");//0号模型
+		m_scene->loadModelAsync("models/plane/plane.obj");//1号模型
 
 		//创建材质（虚拟资源）
 		std::shared_ptr<Material> m_vikingRoomMat = std::make_shared<Material>(*m_device, m_swapChain->getSwapChainImages().size(), PipelineFactory::createStandardPipeline(
@@ -133,6 +150,7 @@ private:
 			std::unique_ptr<Entity> m_vikingEntity2 = std::make_unique<Entity>(m_scene->getModels()[0], m_scene->getMaterials()[0]);
 			m_vikingEntity2->setScale(glm::vec3{ sscale });
 			m_vikingEntity2->setPosition(glm::vec3{ offset,0.0f,0.0f });
+			m_vikingEntity2->setStatic(true);
 			m_scene->addEntity(std::move(m_vikingEntity2));
 			offset += 2.0f;
 			sscale -= 0.14f;
@@ -200,6 +218,8 @@ private:
 			lastFrame = currentFrame;
 			glfwPollEvents();
 			processInput(window);
+			//帧边界：后台加载完的模型在录制这一帧之前换上
+			m_scene->update();
 			// 1. ImGui 开启新帧
 			ImGui_ImplVulkan_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
@@ -217,6 +237,33 @@ private:
 			}
 			ImGui::End();
 
+			drawMemoryPanel();
+
+			ImGui::Begin("LOD");
+			ImGui::SliderFloat("Pixel error", &m_lodPixelError, 0.25f, 16.0f);
+			ImGui::SliderFloat("Shadow bias", &m_shadowLodBias, 1.0f, 8.0f);
+			ImGui::Checkbox("Meshlet culling", &m_cullMeshlets);
+			const DrawStats& mainStats = m_scene->getMainStats();
+			ImGui::Text("Triangles: main %u  shadow %u", mainStats.triangles, m_scene->getShadowStats().triangles);
+			ImGui::Text("Meshlets: %u / %u visible", mainStats.visibleMeshlets, mainStats.totalMeshlets);
+			ImGui::Text("Entities: %u drawn  %u culled", mainStats.entities, mainStats.culledEntities);
+			//静态实体按材质和 16 米的格子合并，合并后没有 LOD
+			if (m_scene->getPendingModelCount() == 0 && ImGui::Button("Merge static entities"))
+			{
+				m_scene->buildStaticBatches(16.0f);
+			}
+			if (m_scene->getPendingModelCount() > 0)
+			{
+				ImGui::Text("Loading %u models...", m_scene->getPendingModelCount());
+			}
+			if (m_scene->getRefiningModelCount() > 0)
+			{
+				ImGui::Text("Refining %u models...", m_scene->getRefiningModelCount());
+			}
+			const LoadMetrics& loadMetrics = m_scene->getLoadMetrics();
+			ImGui::Text("First pixel: %.1f ms  full detail: %.1f ms", loadMetrics.firstPixelMs, loadMetrics.fullDetailMs);
+			ImGui::End();
+
 			//3. 生成渲染数据
 			ImGui::Render();
 			drawFrame();
@@ -242,6 +289,90 @@ private:
 		vkDeviceWaitIdle(m_device->getLogicalDevice());
 	}
 
+	//显存面板：按堆、按用途显示分配器的统计，支持时显示驱动给的预算
+	void drawMemoryPanel()
+	{
+		const float MB = 1024.0f * 1024.0f;
+		MemoryAllocator& allocator = m_device->getAllocator();
+		std::vector<HeapStats>& heaps = m_heapStats;
+		allocator.getHeapStats(heaps);
+		AllocatorStats stats = allocator.getStats();
+
+		ImGui::Begin("Memory");
+		ImGui::Text("Blocks: %zu  Allocations: %zu", stats.blockCount, stats.allocationCount);
+		ImGui::Text("Used %.1f MB / Reserved %.1f MB  Fragmentation %.2f", stats.usedBytes / MB, stats.reservedBytes / MB, stats.fragmentation);
+		if (!allocator.isMemoryBudgetSupported())
+		{
+			ImGui::TextDisabled("VK_EXT_memory_budget not available");
+		}
+
+		for (size_t i = 0; i < heaps.size(); i++)
+		{
+			const HeapStats& heap = heaps[i];
+			bool deviceLocal = heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			ImGui::Separator();
+			ImGui::Text("Heap %zu (%s)  %.0f MB", i, deviceLocal ? "device local" : "host", heap.size / MB);
+			ImGui::Text("Reserved %.1f MB", heap.reservedBytes / MB);
+			for (size_t usage = 0; usage < static_cast<size_t>(MemoryUsage::Count); usage++)
+			{
+				if (heap.usedBytes[usage] > 0)
+				{
+					ImGui::BulletText("%s: %.2f MB", getMemoryUsageName(static_cast<MemoryUsage>(usage)), heap.usedBytes[usage] / MB);
+				}
+			}
+
+			if (heap.budget > 0)
+			{
+				float ratio = static_cast<float>(heap.driverUsage) / static_cast<float>(heap.budget);
+				ImGui::ProgressBar(ratio, ImVec2(-1.0f, 0.0f));
+				ImGui::Text("Process usage %.1f MB / Budget %.1f MB", heap.driverUsage / MB, heap.budget / MB);
+				if (heap.driverUsage > heap.budget)
+				{
+					ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "OVER BUDGET");
+				}
+			}
+		}
+
+		ImGui::Separator();
+		Defragmenter& defragmenter = m_device->getDefragmenter();
+		DefragStats defrag = defragmenter.getStats();
+		bool defragEnabled = defragmenter.isEnabled();
+		if (ImGui::Checkbox("Defragment", &defragEnabled))
+		{
+			defragmenter.setEnabled(defragEnabled);
+		}
+		int budgetMB = static_cast<int>(defragmenter.getFrameBudget() / (1024 * 1024));
+		if (ImGui::SliderInt("Budget MB/frame", &budgetMB, 1, 64))
+		{
+			defragmenter.setFrameBudget(static_cast<VkDeviceSize>(budgetMB) * 1024 * 1024);
+		}
+		ImGui::Text("Passes %llu  Moved %llu (%.1f MB)", static_cast<unsigned long long>(defrag.passCount),
+			static_cast<unsigned long long>(defrag.movedAllocations), defrag.movedBytes / MB);
+		ImGui::Text("%s  Source blocks %zu  Pending %zu  Retiring %zu  Last %.2f MB", defrag.passActive ? "Active" : "Idle",
+			defrag.sourceBlocks, defrag.pendingMoves, defrag.retiredResources, defrag.lastFrameBytes / MB);
+
+		ImGui::Separator();
+		const GeometryPool& pool = m_scene->getGeometryPool();
+		ImGui::Text("Geometry pool: vertices %u / %u  indices %u / %u  Grown %u", pool.getUsedVertices(), pool.getVertexCapacity(),
+			pool.getUsedIndices(), pool.getIndexCapacity(), pool.getGrowCount());
+
+		ImGui::Separator();
+		const TrackedUploadStats& tracked = m_renderer->getTrackedUploadStats();
+		ImGui::Text("Tracked buffers %u  Writes %u -> Regions %u", tracked.bufferCount, tracked.frameWrites, tracked.frameRegions);
+		ImGui::Text("Uploaded %.1f KB this frame  %.1f MB total", tracked.frameBytes / 1024.0f, tracked.totalBytes / MB);
+		FrameArena& arena = m_renderer->getFrameArena();
+		ImGui::Text("Frame arena %.1f / %.1f KB  Peak %.1f KB", arena.getUsedBytes() / 1024.0f, arena.getCapacity() / 1024.0f, arena.getPeakBytes() / 1024.0f);
+
+		ImGui::Separator();
+		if (ImGui::Button("Dump JSON"))
+		{
+			std::ofstream out("memory_report.json");
+			allocator.writeJsonReport(out);
+			std::cout << "memory report written to memory_report.json" << std::endl;
+		}
+		ImGui::End();
+	}
+
 	static void framebufferResizeCallback(GLFWwindow* window,int width, int height)
 	{
 		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
@@ -262,6 +393,8 @@ private:
 
 	void drawFrame()
 	{
+		//光源写进 TrackedBuffer 的影子数据，beginFrame 录制的拷贝会带上它
+		m_renderer->updateLightUBO();
 		VkCommandBuffer cmd = m_renderer->beginFrame();
 		if (cmd == VK_NULL_HANDLE) {
 			recreateSwapChain();
@@ -270,17 +403,30 @@ private:
 
 		m_renderer->updateGlbUBO();
 
+		//主 pass 和阴影 pass 都按相机的距离选 LOD，阴影 pass 多乘一个偏置；簇剔除只在主 pass 做
+		VkExtent2D extent = m_swapChain->getSwapChainExtent();
+		DrawView drawView;
+		drawView.position = m_camera.Position;
+		drawView.pixelScale = extent.height / (2.0f * std::tan(glm::radians(m_camera.Zoom) * 0.5f));
+		drawView.maxPixelError = m_lodPixelError;
+		drawView.frustum = Frustum::fromMatrix(m_camera.getProjectionMatrix(extent.width / (float)extent.height) * m_camera.getViewMatrix());
+		drawView.cullMeshlets = m_cullMeshlets;
+		DrawView shadowView = drawView;
+		shadowView.bias = m_shadowLodBias;
+		shadowView.cullMeshlets = false;
+
 		//开始阴影Renderpass
 		m_renderer->beginRenderPass(cmd, m_renderer->getShadowRenderPass(), m_renderer->getShadowPassFrameBuffer()->getHandle(), {2048,2048});
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_renderer->getShadowPipeline()->getPipeline());
 		VkDescriptorSet shadowSet = m_renderer->getShadowDescriptorSet(m_renderer->getFrameIndex());
+		uint32_t globalUboOffset = m_renderer->getGlobalUboOffset();
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_renderer->getShadowPipeline()->getPipelineLayout().getHandle(), 0, 1, &shadowSet, 0, nullptr);
-		m_scene->drawforShadow(cmd, m_renderer->getShadowPipeline()->getPipelineLayout().getHandle());
+		m_scene->drawforShadow(cmd, m_renderer->getShadowPipeline()->getPipelineLayout().getHandle(), shadowView);
 		m_renderer->endRenderPass(cmd);
 
 		//开始场景渲染的主pass
 		m_renderer->beginRenderPass(cmd, m_renderer->getRenderPass(), m_renderer->getFrameBuffers()[m_renderer->getImageIndex()]->getHandle(), m_swapChain->getSwapChainExtent());
-		m_scene->drawMain(cmd, m_renderer->getFrameIndex());
+		m_scene->drawMain(cmd, m_renderer->getFrameIndex(), globalUboOffset, drawView);
 		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
 		m_renderer->endRenderPass(cmd);
 		VkResult result = m_renderer->endFrame();
@@ -306,13 +452,11 @@ private:
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(m_device->getLogicalDevice());
-
-		m_swapChain.reset();
-		m_renderer->cleanupSwapChainAssets();
-
+		//不再 vkDeviceWaitIdle：旧的交换链、帧缓冲、深度图和 RenderPass 都进删除队列，等在途的帧结束后才销毁
 		VkExtent2D newExtent = {width, height};
-		m_swapChain = std::make_unique<SwapChain>(*m_device, newExtent);
+		std::unique_ptr<SwapChain> newSwapChain = std::make_unique<SwapChain>(*m_device, newExtent, m_swapChain->getSwapChain());
+		m_renderer->cleanupSwapChainAssets();
+		m_swapChain = std::move(newSwapChain);
 		
 		m_renderer->setSwapChain(&(*m_swapChain));
 		m_renderer->createRenderPass();
@@ -324,8 +468,50 @@ private:
 };
 
 
-int main()
+int main(int argc, char** argv)
 {
+	//--bench-obj / --bench-weld / --bench-glb / --bench-shadow [文件...]：只跑对应的基准测试，不创建窗口
+	std::string mode = argc > 1 ? argv[1] : "";
+	if (mode == "--bench-obj" || mode == "--bench-weld" || mode == "--bench-glb" || mode == "--bench-shadow")
+	{
+		try
+		{
+			std::vector<std::string> paths(argv + 2, argv + argc);
+			if (mode == "--bench-glb")
+			{
+				return GlbBenchmark::run(paths);
+			}
+			if (mode == "--bench-shadow")
+			{
+				return ShadowBenchmark::run(paths);
+			}
+			return mode == "--bench-obj" ? ObjBenchmark::run(paths) : WeldBenchmark::run(paths);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	//--test-allocator / --test-meshlet / --test-dirty-ranges：不需要 GPU 的单元测试，全部通过时返回 0
+	if (mode == "--test-allocator" || mode == "--test-meshlet" || mode == "--test-dirty-ranges")
+	{
+		try
+		{
+			if (mode == "--test-dirty-ranges")
+			{
+				return DirtyRangeTests::run();
+			}
+			return mode == "--test-allocator" ? AllocatorTests::run() : MeshletTests::run();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
 	HelloTriangleApplication app;
 	try
 	{